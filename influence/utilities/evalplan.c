@@ -0,0 +1,180 @@
+#include "mex.h"
+#include <string.h>
+/*
+% evalplan Evaluates a compiled sum-product plan
+% USAGE
+%   z=evalplan(x,plan);
+% INPUTS
+%   x    : full double vector with plan(1).nA elements
+%   plan : structure array with one element for each processing step
+% OUTPUT
+%   z    : plan(end).nZ x 1 vector
+%
+% Each step combines the current intermediate result A (x for the first
+% step) with a constant factor B (full or sparse) to produce Z:
+%   Z(zb+zoff(t)) += B(i,j)*A(ab+aoff(t))
+% for every element B(i,j) (every non-zero element if B is sparse) and
+% every t, where ab=rowA(i)+colA(j) and zb=rowZ(i)+colZ(j). The fields
+% of each step are
+%   B          : the constant factor (a 2-D matrix)
+%   rowA, rowZ : offsets into A and Z associated with the rows of B
+%   colA, colZ : offsets into A and Z associated with the columns of B
+%   aoff, zoff : offsets into A and Z of the dimensions of A that are
+%                  not dimensions of B
+%   nA, nZ     : number of elements in A and Z
+% The offsets are uint32 and 0-based. Plans are created by sumproduct
+% when it returns an EV function; the permutations and strides are
+% worked out once when the plan is created rather than on every call.
+%
+% The intermediate results are held in a workspace that is kept between
+% calls so repeated evaluation (e.g., in value function iteration) does
+% not allocate memory except for the output.
+%
+% Coded as a MEX file
+*/
+
+/* workspace kept between calls */
+static double *work=NULL;
+static mwSize worksize=0;
+
+static void freework(void)
+{
+  if (work!=NULL) mxFree(work);
+  work=NULL;
+  worksize=0;
+}
+
+static double *getwork(mwSize n)
+{
+  if (n>worksize){
+    freework();
+    work=mxMalloc(n*sizeof(double));
+    mexMakeMemoryPersistent(work);
+    worksize=n;
+  }
+  return work;
+}
+
+static const mxArray *getfield(const mxArray *plan, mwIndex k,
+                               const char *name, int isuint)
+{
+  const mxArray *f=mxGetField(plan,k,name);
+  if (f==NULL) mexErrMsgTxt("plan is missing a field");
+  if (isuint && !mxIsUint32(f)) mexErrMsgTxt("plan offsets must be uint32");
+  return f;
+}
+
+/* largest element of a uint32 field */
+static mwSize maxoffset(const mxArray *f)
+{
+  const unsigned int *x=(const unsigned int *)mxGetData(f);
+  mwSize n=mxGetNumberOfElements(f), i, m=0;
+  for (i=0; i<n; i++) if (x[i]>m) m=x[i];
+  return m;
+}
+
+/* one step: z=0 then z(zb+zoff)+=b*a(ab+aoff) for each element of B */
+void planstep(const double *a, double *z, const mxArray *B,
+              const unsigned int *rowA, const unsigned int *rowZ,
+              const unsigned int *colA, const unsigned int *colZ,
+              const unsigned int *aoff, const unsigned int *zoff,
+              mwSize nt, mwSize nZ)
+{
+  mwSize r=mxGetM(B), c=mxGetN(B), i, j, t;
+  mwIndex e, *ir, *jc;
+  const double *b=mxGetPr(B), *ab;
+  double *zb, bij;
+  memset(z,0,nZ*sizeof(double));
+  if (mxIsSparse(B)){
+    ir=mxGetIr(B);
+    jc=mxGetJc(B);
+    for (j=0; j<c; j++){
+      for (e=jc[j]; e<jc[j+1]; e++){
+        bij=b[e];
+        ab=a+colA[j]+rowA[ir[e]];
+        zb=z+colZ[j]+rowZ[ir[e]];
+        for (t=0; t<nt; t++) zb[zoff[t]]+=bij*ab[aoff[t]];
+      }
+    }
+  }
+  else{
+    for (j=0; j<c; j++){
+      for (i=0; i<r; i++){
+        bij=b[i+j*r];
+        ab=a+colA[j]+rowA[i];
+        zb=z+colZ[j]+rowZ[i];
+        for (t=0; t<nt; t++) zb[zoff[t]]+=bij*ab[aoff[t]];
+      }
+    }
+  }
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  static int registered=0;
+  const mxArray *plan, *B;
+  mwSize ns, k, nA, nZ, maxn;
+  const double *a;
+  double *z;
+
+  if (!registered){
+    mexAtExit(freework);
+    registered=1;
+  }
+  if (nrhs<2) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>2) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  if (!mxIsDouble(prhs[0]) || mxIsSparse(prhs[0]) || mxIsComplex(prhs[0]))
+    mexErrMsgTxt("x must be a real full double array");
+  plan=prhs[1];
+  if (!mxIsStruct(plan)) mexErrMsgTxt("plan must be a structure array");
+  ns=mxGetNumberOfElements(plan);
+  if (ns==0) mexErrMsgTxt("plan must have at least one step");
+
+  // check the plan and get the size of the largest intermediate result
+  maxn=0;
+  nZ=mxGetNumberOfElements(prhs[0]);
+  for (k=0; k<ns; k++){
+    nA=(mwSize)mxGetScalar(getfield(plan,k,"nA",0));
+    if (nA!=nZ) mexErrMsgTxt("The sizes of the plan steps are not compatible with x");
+    nZ=(mwSize)mxGetScalar(getfield(plan,k,"nZ",0));
+    B=getfield(plan,k,"B",0);
+    if (!mxIsDouble(B) || mxIsComplex(B)) mexErrMsgTxt("B must be real double");
+    if (mxGetNumberOfElements(getfield(plan,k,"rowA",1))<mxGetM(B) ||
+        mxGetNumberOfElements(getfield(plan,k,"rowZ",1))<mxGetM(B) ||
+        mxGetNumberOfElements(getfield(plan,k,"colA",1))<mxGetN(B) ||
+        mxGetNumberOfElements(getfield(plan,k,"colZ",1))<mxGetN(B) ||
+        mxGetNumberOfElements(getfield(plan,k,"aoff",1))!=
+        mxGetNumberOfElements(getfield(plan,k,"zoff",1)))
+      mexErrMsgTxt("plan offsets are not compatible with B");
+    // the offsets are checked so a bad plan cannot access memory outside A or Z
+    if (mxGetNumberOfElements(getfield(plan,k,"aoff",1))>0 && mxGetNumberOfElements(B)>0){
+      if (maxoffset(getfield(plan,k,"rowA",1))+maxoffset(getfield(plan,k,"colA",1))
+         +maxoffset(getfield(plan,k,"aoff",1))>=nA ||
+          maxoffset(getfield(plan,k,"rowZ",1))+maxoffset(getfield(plan,k,"colZ",1))
+         +maxoffset(getfield(plan,k,"zoff",1))>=nZ)
+        mexErrMsgTxt("plan offsets are out of range");
+    }
+    if (k<ns-1 && nZ>maxn) maxn=nZ;
+  }
+
+  // intermediate results alternate between the two halves of the workspace
+  if (maxn>0) getwork(2*maxn);
+  plhs[0]=mxCreateDoubleMatrix(nZ,1,mxREAL);
+  a=mxGetPr(prhs[0]);
+  for (k=0; k<ns; k++){
+    z = k==ns-1 ? mxGetPr(plhs[0]) : work+(k%2)*maxn;
+    planstep(a,z,getfield(plan,k,"B",0),
+      (unsigned int *)mxGetData(getfield(plan,k,"rowA",1)),
+      (unsigned int *)mxGetData(getfield(plan,k,"rowZ",1)),
+      (unsigned int *)mxGetData(getfield(plan,k,"colA",1)),
+      (unsigned int *)mxGetData(getfield(plan,k,"colZ",1)),
+      (unsigned int *)mxGetData(getfield(plan,k,"aoff",1)),
+      (unsigned int *)mxGetData(getfield(plan,k,"zoff",1)),
+      mxGetNumberOfElements(getfield(plan,k,"aoff",1)),
+      (mwSize)mxGetScalar(getfield(plan,k,"nZ",0)));
+    a=z;
+  }
+}
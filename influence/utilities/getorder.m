@@ -1,5 +1,5 @@
 % getorder Obtains an ordering for the sum-product algorithm
-%   order=getorder(V,n,sumvar,penalty,orderalg);
+%   [order,cost]=getorder(V,n,sumvar,penalty,orderalg,density);
 % INPUTS
 %   V        : mxn logical matrix with V(i,j)=true if factor j is a function of
 %                variable i
@@ -8,13 +8,26 @@
 %                summed out
 %   penalty  : logical m-vector with jth element true if factor should be
 %                down in the order
-%   orderalg :  1 - hybrid algorithm that eliminates subset factors
+%   orderalg :  0 - default (optimal for small problems, otherwise 
+%                     the best of 4-6 if getorderc is available)
+%               1 - hybrid algorithm that eliminates subset factors
 %               2 - optimal order
 %               3 - greedy algorithm 
+%               4 - min-fill
+%               5 - weighted min-fill
+%               6 - randomized greedy with restarts
+%   density  : m-vector with the fraction of non-zero elements of each 
+%                factor (1 for full factors) [default: ones(m,1)]
 % OUTPUT
 %   order    : (m-1)x2 matrix with the order that pairs of factors are
 %                 combined. The combined factor is placed back in the
 %                 position of the first of the pair of factors
+%   cost     : processing cost
+%
+% Methods 4-6 use the MEX file getorderc (see its help for details); 
+% they use a cost model that accounts for the density of the factors
+% and run quickly on problems with many factors. If getorderc is not 
+% available method 1 is used in their place.
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2014, Paul L. Fackler (paul_fackler@ncsu.edu)
@@ -46,13 +59,20 @@
 % For more information, see the Open Source Initiative OSI site:
 %   http://www.opensource.org/licenses/bsd-license.php
 
-function [order,cost]=getorder(V,n,sumvar,penalty,orderalg)
+function [order,cost]=getorder(V,n,sumvar,penalty,orderalg,density)
   m=size(V,1);
+  if nargin<6, density=[]; end
+  usemex = exist('getorderc','file')==3;  % use mex file if it exists
   switch orderalg
     case 0
       if  m>7 
         if m>20
-          [order,cost]=minsize(V,n,sumvar,penalty);  
+          if usemex
+            [order,cost]=getorderc(double(V),double(n),double(sumvar), ...
+                                   double(penalty),0,double(density));
+          else
+            [order,cost]=minsize(V,n,sumvar,penalty);  
+          end
         else
           [o1,v1,remaining,cost1]=initialorder(V,n,sumvar,penalty);
           [order,cost]=optfactororder(v1,n,sumvar,penalty(remaining));
@@ -69,6 +89,13 @@ function [order,cost]=getorder(V,n,sumvar,penalty,orderalg)
       [order,cost]=optfactororder(V,n,sumvar,penalty); 
     case 3
       [order,cost]=greedy(V,n,sumvar,penalty); 
+    case {4,5,6}
+      if usemex
+        [order,cost]=getorderc(double(V),double(n),double(sumvar), ...
+                               double(penalty),orderalg-3,double(density));
+      else
+        [order,cost]=minsize(V,n,sumvar,penalty);
+      end
   end
   % move factor 1 down in the order to the last possible position
   % all subsequent joins will have factor 1 first
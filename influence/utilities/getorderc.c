@@ -0,0 +1,302 @@
+#include "mex.h"
+#include <math.h>
+#include <string.h>
+/*
+% getorderc Factor processing order for the sum-product algorithm
+% USAGE
+%   [order,cost]=getorderc(V,n,sumvar,penalty,alg,density,reps,seed);
+% INPUTS
+%   V        : mxd matrix with V(i,j)=true if factor i is a function
+%                of variable j
+%   n        : d-vector of variable sizes
+%   sumvar   : d-vector with jth element true if variable j can be
+%                summed out
+%   penalty  : m-vector with ith element true if factor i should be
+%                down in the order
+%   alg      : 0 - best of the three methods below [default]
+%              1 - min-fill
+%              2 - weighted min-fill
+%              3 - randomized greedy with restarts
+%   density  : m-vector with the fraction of non-zero elements of each
+%                factor (1 for full factors) [default: ones(m,1)]
+%   reps     : number of restarts for the randomized greedy method
+%                [default: 32]
+%   seed     : seed for the random number generator [default: 1]
+% OUTPUT
+%   order    : (m-1)x2 matrix with the order that pairs of factors are
+%                combined. The combined factor is placed back in the
+%                position of the first of the pair of factors
+%   cost     : expected number of multiplies (see below)
+%
+% Each method combines a pair of factors at each step; a variable is
+% summed out as soon as it is a summable variable that appears in only
+% one factor. The methods differ in how the pair is selected:
+%   min-fill: fewest new pairs of variables that do not already appear
+%     together in some factor (the fill edges of the interaction graph)
+%   weighted min-fill: smallest sum of n(u)*n(v) over the fill edges
+%   randomized greedy: smallest combination cost; each restart after the
+%     first perturbs the costs with Gumbel noise so that nearby choices
+%     are explored and the cheapest plan found is returned.
+% Ties are broken by the combination cost.
+%
+% The cost of combining factors i and j is prod(n(vi|vj))*di*dj, where
+% di and dj are the densities of the factors, and the combined factor
+% has density min(1,di*dj*prod(n(s))), where s are the variables summed
+% out. Combinations involving penalized factors have a cost increased by
+% the size of the largest factor when selecting pairs (as in the minsize
+% method of getorder) but the returned cost does not include this.
+%
+% Used by getorder, which converts the inputs to double.
+%
+% Coded as a MEX file
+*/
+
+// default number of restarts for the randomized greedy method
+#define REPS 32
+
+/* fixed information about the problem */
+typedef struct {
+  mwSize m, d;
+  const double *n;              // variable sizes
+  const unsigned char *sumvar;  // summable variables
+  double pencost;               // added to the cost of penalized joins
+} problem;
+
+/* current set of factors */
+typedef struct {
+  unsigned char *V;    // variables of each factor (V[i*d+k])
+  unsigned char *active, *pen;
+  double *dens;
+  mwSize *cnt;         // number of active factors containing each variable
+  mwSize *A;           // number of active factors containing each pair
+} state;
+
+/* costs associated with combining a pair of factors */
+typedef struct {
+  double cost;         // expected number of multiplies
+  double dens;         // density of the result
+  double fill;         // number of fill edges
+  double wfill;        // weighted number of fill edges
+} joininfo;
+
+static unsigned long long rngstate;
+
+/* uniform on (0,1) (splitmix64) */
+static double urand(void)
+{
+  unsigned long long z=(rngstate+=0x9E3779B97F4A7C15ULL);
+  z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+  z=(z^(z>>27))*0x94D049BB133111EBULL;
+  z^=z>>31;
+  return ((double)(z>>11)+0.5)/9007199254740992.0;
+}
+
+/* variable k is summed out when factors i and j are combined */
+#define SUMMED(k) (P->sumvar[k] && S->cnt[k]==(mwSize)(vi[k]+vj[k]))
+
+void evaljoin(const problem *P, const state *S, mwSize i, mwSize j,
+              joininfo *J)
+{
+  mwSize d=P->d, k, l;
+  const unsigned char *vi=S->V+i*d, *vj=S->V+j*d;
+  double nu=1, ns=1;
+  J->fill=0; J->wfill=0;
+  for (k=0; k<d; k++){
+    if (!(vi[k] | vj[k])) continue;
+    nu*=P->n[k];
+    if (SUMMED(k)) ns*=P->n[k];
+    // fill edges join a variable only in i to one only in j
+    else if (vi[k] && !vj[k]){
+      for (l=0; l<d; l++){
+        if (vj[l] && !vi[l] && !SUMMED(l) && S->A[k*d+l]==0){
+          J->fill++;
+          J->wfill+=P->n[k]*P->n[l];
+        }
+      }
+    }
+  }
+  J->cost=nu*S->dens[i]*S->dens[j];
+  J->dens=S->dens[i]*S->dens[j]*ns;
+  if (J->dens>1) J->dens=1;
+}
+
+/* adds (inc=1) or removes (inc=-1) factor i from the counts */
+void countfactor(const problem *P, state *S, mwSize i, int inc)
+{
+  mwSize d=P->d, k, l;
+  const unsigned char *vi=S->V+i*d;
+  for (k=0; k<d; k++){
+    if (!vi[k]) continue;
+    S->cnt[k]+=inc;
+    for (l=0; l<d; l++) if (vi[l] && l!=k) S->A[k*d+l]+=inc;
+  }
+}
+
+/* combines factors i and j (i<j) placing the result in i */
+void dojoin(const problem *P, state *S, mwSize i, mwSize j, const joininfo *J)
+{
+  mwSize d=P->d, k;
+  unsigned char *vi=S->V+i*d, *vj=S->V+j*d;
+  countfactor(P,S,i,-1);
+  countfactor(P,S,j,-1);
+  for (k=0; k<d; k++){
+    vi[k]|=vj[k];
+    // no other active factors contain a variable with a zero count
+    if (P->sumvar[k] && S->cnt[k]==0) vi[k]=0;
+    vj[k]=0;
+  }
+  countfactor(P,S,i,1);
+  S->active[j]=0;
+  S->pen[i]|=S->pen[j];
+  S->dens[i]=J->dens;
+}
+
+void initstate(const problem *P, state *S, const unsigned char *V0,
+               const unsigned char *pen0, const double *dens0)
+{
+  mwSize m=P->m, d=P->d, i;
+  memcpy(S->V,V0,m*d);
+  memcpy(S->pen,pen0,m);
+  memcpy(S->dens,dens0,m*sizeof(double));
+  memset(S->active,1,m);
+  memset(S->cnt,0,d*sizeof(mwSize));
+  memset(S->A,0,d*d*sizeof(mwSize));
+  for (i=0; i<m; i++) countfactor(P,S,i,1);
+}
+
+/* one pass of a method; returns the cost used to compare plans and
+   puts the plan in order (0-based) and the multiplies in *cost */
+double plan(const problem *P, state *S, int alg, double tau,
+            mwSize *order, double *cost)
+{
+  mwSize m=P->m, i, j, k, bi=0, bj=0;
+  joininfo J, bJ;
+  double key1, key2, b1, b2, total=0, pc, g;
+  *cost=0;
+  bJ.cost=0; bJ.dens=1;
+  for (k=0; k+1<m; k++){
+    b1=mxGetInf(); b2=mxGetInf();
+    for (i=0; i<m; i++){
+      if (!S->active[i]) continue;
+      for (j=i+1; j<m; j++){
+        if (!S->active[j]) continue;
+        evaljoin(P,S,i,j,&J);
+        pc=J.cost+((S->pen[i] | S->pen[j]) ? P->pencost : 0);
+        switch (alg){
+        case 1:  key1=J.fill;  key2=pc; break;
+        case 2:  key1=J.wfill; key2=pc; break;
+        default:
+          key1=log(pc+1);
+          if (tau>0){
+            g=-log(-log(urand()));
+            key1-=tau*g;
+          }
+          key2=0;
+        }
+        if (key1<b1 || (key1==b1 && key2<b2)){
+          b1=key1; b2=key2; bi=i; bj=j; bJ=J;
+          bJ.cost=pc;
+        }
+      }
+    }
+    total+=bJ.cost;
+    *cost+=bJ.cost-((S->pen[bi] | S->pen[bj]) ? P->pencost : 0);
+    order[k]=bi; order[k+m-1]=bj;
+    dojoin(P,S,bi,bj,&bJ);
+  }
+  return total;
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  problem P;
+  state S;
+  unsigned char *V0, *pen0, *sv;
+  const double *n;
+  double *dens0, *order, cost, bestcost, besttotal, total, f;
+  mwSize m, d, i, k, *ord, *bestord, reps, r;
+  int alg, a, amin, amax;
+
+  if (nrhs<4) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>8) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>2) mexErrMsgTxt("Too many output arguments.");
+  for (a=0; a<nrhs; a++){
+    if (!mxIsDouble(prhs[a]) || mxIsSparse(prhs[a]) || mxIsComplex(prhs[a]))
+      mexErrMsgTxt("Inputs must be real full double arrays");
+  }
+  m=mxGetM(prhs[0]);
+  d=mxGetN(prhs[0]);
+  if (m<2) mexErrMsgTxt("At least 2 factors are needed");
+  if (mxGetNumberOfElements(prhs[1])!=d || mxGetNumberOfElements(prhs[2])!=d)
+    mexErrMsgTxt("n and sumvar must have one element for each column of V");
+  if (mxGetNumberOfElements(prhs[3])!=m)
+    mexErrMsgTxt("penalty must have one element for each row of V");
+  alg = nrhs>4 && !mxIsEmpty(prhs[4]) ? (int)mxGetScalar(prhs[4]) : 0;
+  if (alg<0 || alg>3) mexErrMsgTxt("alg must be 0, 1, 2 or 3");
+  if (nrhs>5 && !mxIsEmpty(prhs[5]) && mxGetNumberOfElements(prhs[5])!=m)
+    mexErrMsgTxt("density must have one element for each row of V");
+  reps = nrhs>6 && !mxIsEmpty(prhs[6]) ? (mwSize)mxGetScalar(prhs[6]) : REPS;
+  if (reps<1) reps=1;
+  rngstate = nrhs>7 && !mxIsEmpty(prhs[7]) ?
+             (unsigned long long)mxGetScalar(prhs[7]) : 1;
+
+  // convert the inputs to bytes
+  V0=mxMalloc(m*d);
+  sv=mxMalloc(d);
+  pen0=mxMalloc(m);
+  dens0=mxMalloc(m*sizeof(double));
+  n=mxGetPr(prhs[1]);
+  for (i=0; i<m; i++){
+    for (k=0; k<d; k++) V0[i*d+k] = mxGetPr(prhs[0])[i+k*m]!=0;
+    pen0[i] = mxGetPr(prhs[3])[i]!=0;
+    dens0[i]=1;
+    if (nrhs>5 && !mxIsEmpty(prhs[5])){
+      f=mxGetPr(prhs[5])[i];
+      if (f>=0 && f<1) dens0[i]=f;
+    }
+  }
+  for (k=0; k<d; k++) sv[k] = mxGetPr(prhs[2])[k]!=0;
+
+  P.m=m; P.d=d; P.n=n; P.sumvar=sv;
+  // largest factor size (the penalty used by minsize)
+  P.pencost=0;
+  for (i=0; i<m; i++){
+    f=1;
+    for (k=0; k<d; k++) if (V0[i*d+k]) f*=n[k];
+    if (f>P.pencost) P.pencost=f;
+  }
+
+  S.V=mxMalloc(m*d);
+  S.active=mxMalloc(m);
+  S.pen=mxMalloc(m);
+  S.dens=mxMalloc(m*sizeof(double));
+  S.cnt=mxMalloc(d*sizeof(mwSize));
+  S.A=mxMalloc(d*d*sizeof(mwSize));
+  ord=mxMalloc(2*(m-1)*sizeof(mwSize));
+  bestord=mxMalloc(2*(m-1)*sizeof(mwSize));
+
+  besttotal=mxGetInf(); bestcost=mxGetInf();
+  amin = alg==0 ? 1 : alg;
+  amax = alg==0 ? 3 : alg;
+  for (a=amin; a<=amax; a++){
+    for (r=0; r<(a==3 ? reps : 1); r++){
+      initstate(&P,&S,V0,pen0,dens0);
+      total=plan(&P,&S,a,r==0 ? 0.0 : 1.0,ord,&cost);
+      if (total<besttotal || (total==besttotal && cost<bestcost)){
+        besttotal=total; bestcost=cost;
+        memcpy(bestord,ord,2*(m-1)*sizeof(mwSize));
+      }
+    }
+  }
+
+  plhs[0]=mxCreateDoubleMatrix(m-1,2,mxREAL);
+  order=mxGetPr(plhs[0]);
+  for (k=0; k<2*(m-1); k++) order[k]=(double)(bestord[k]+1);
+  if (nlhs>1) plhs[1]=mxCreateDoubleScalar(bestcost);
+
+  mxFree(V0); mxFree(sv); mxFree(pen0); mxFree(dens0);
+  mxFree(S.V); mxFree(S.active); mxFree(S.pen); mxFree(S.dens);
+  mxFree(S.cnt); mxFree(S.A); mxFree(ord); mxFree(bestord);
+}
@@ -25,6 +25,10 @@
 %                     0 for default
 %                     1 forces greedy
 %                     2 forces optimal
+%                     4 min-fill
+%                     5 weighted min-fill
+%                     6 randomized greedy with restarts
+%                   (see getorder)
 %   orderonly   : 1 to return order info and skip processing (f and Iexpand set to [])
 %   forcefull   : 0 use sparse factors
 %                 1 convert sparse factors to full
@@ -106,6 +110,11 @@ if m==1
   end
 else
   penalty=false(1,m); for i=1:m, if isempty(F{i}), penalty(i)=true; end; end
+  % fraction of non-zeros used by the planner's cost model
+  density=ones(1,m);
+  for i=1:m
+    if issparse(F{i}) && ~forcefull, density(i)=nnz(F{i})/numel(F{i}); end
+  end
   % may one day allow user supplied processing order
   if print>0
     disp('determining processing order')
@@ -114,9 +123,9 @@ else
   % get processing order
   if ~isempty(order)
     warning('user supplied orders are not yet implemented; getorder is used')
-    [order,cost]=getorder(V,n,sumvar,penalty,orderalg);
+    [order,cost]=getorder(V,n,sumvar,penalty,orderalg,density);
   else
-    [order,cost]=getorder(V,n,sumvar,penalty,orderalg);
+    [order,cost]=getorder(V,n,sumvar,penalty,orderalg,density);
   end
   if print>0
     fprintf('time taken: %8.3f\n',cputime-start)
@@ -349,9 +358,108 @@ function f=evalfunctranmat(x,F,Iexpand)
 
 
 % gets a function of F1 when F1 is passed as empty
+% if the MEX file evalplan is available the processing steps are compiled
+% into a plan that is evaluated in a single call
 function func=getfunc(F,control,reorder,Iexpand)
+  if isempty(reorder) && exist('evalplan','file')==3
+    [plan,nzout]=getplan(F,control);
+    if ~isempty(plan)
+      func=@(x) evalplanfunc(x,plan,nzout,Iexpand)';
+      return
+    end
+  end
   func=@(x)  evalfunc(x,F,control,reorder,Iexpand)';
 
+% the evaluation routine used with a compiled plan
+function f=evalplanfunc(x,plan,nzout,Iexpand)
+  if ~isa(x,'double') || issparse(x), x=full(double(x)); end
+  f=evalplan(x,plan);
+  if length(nzout)>1, f=reshape(f,nzout); end
+  % expand the output if needed
+  if ~isempty(Iexpand), f=f(Iexpand); end
+
+% compiles the processing steps into a plan for evalplan
+% Steps that do not involve the input are done here; each remaining step 
+% combines the result of the previous step with a constant factor.
+% The plan is empty if the steps cannot be compiled.
+function [plan,nzout]=getplan(F,control)
+  plan=[]; nzout=[];
+  live=control{1,1};   % the factor that depends on the input
+  steps=cell(1,size(control,1));
+  k=0;
+  for i=1:size(control,1)
+    i1=control{i,1};
+    i2=control{i,3};
+    if i1==live
+      step=planstep(control{i,2},F{i2},control{i,4},control{i,5});
+    elseif i2==live
+      step=planstep(control{i,4},F{i1},control{i,2},control{i,5});
+      live=i1;
+    else
+      F{i1}=tprodm(F{i1},control{i,2},F{i2},control{i,4},control{i,5},0);
+      continue
+    end
+    if isempty(step), return; end
+    k=k+1;
+    steps{k}=step;
+  end
+  if k==0 || live~=control{end,1}, return; end
+  plan=[steps{1:k}];
+  nzout=control{end,5};
+  
+% strides and offsets for a step combining A (which depends on the input)
+% with the constant factor B; a2z and b2z are in the form used by tprodm
+function step=planstep(a2z,B,b2z,nzout)
+  step=[];
+  la=a2z(1,:); na=a2z(2,:);
+  lb=b2z(1,:); nb=b2z(2,:);
+  if ~(isnumeric(B) || islogical(B)) || ~isreal(B) || numel(B)~=prod(nb)
+    return
+  end
+  dz=max([0 la(la>0) lb(lb>0)]);
+  nz=ones(1,dz);
+  nz(la(la>0))=na(la>0);
+  nz(lb(lb>0))=nb(lb>0);
+  nA=prod(na); nZ=prod(nz);
+  if nA>=2^32 || nZ>=2^32 || (~isempty(nzout) && prod(nzout)~=nZ)
+    return
+  end
+  sa=cumprod([1 na(1:end-1)]);
+  sz=cumprod([1 nz(1:end-1)]);
+  % strides of the dimensions of B in A and Z
+  [ib,ia]=ismember(abs(lb),abs(la));
+  bA=zeros(1,length(lb)); bA(ib)=sa(ia(ib));
+  bZ=zeros(1,length(lb)); bZ(lb>0)=sz(lb(lb>0));
+  % dimensions of A that are not in B 
+  xa=~ismember(abs(la),abs(lb));
+  xZ=zeros(1,length(la)); xZ(la>0)=sz(la(la>0));
+  % the rows of B are its first q dimensions
+  B=double(B);
+  q=find(cumprod([1 nb])==size(B,1),1,'last')-1;
+  if isempty(q)
+    if issparse(B), return; end
+    q=min(1,length(nb));
+  end
+  if ~issparse(B), B=reshape(B,prod(nb(1:q)),[]); end
+  step.B=B;
+  step.rowA=uint32(gridoffsets(nb(1:q),bA(1:q)));
+  step.rowZ=uint32(gridoffsets(nb(1:q),bZ(1:q)));
+  step.colA=uint32(gridoffsets(nb(q+1:end),bA(q+1:end)));
+  step.colZ=uint32(gridoffsets(nb(q+1:end),bZ(q+1:end)));
+  step.aoff=uint32(gridoffsets(na(xa),sa(xa)));
+  step.zoff=uint32(gridoffsets(na(xa),xZ(xa)));
+  step.nA=nA;
+  step.nZ=nZ;
+  
+% offsets of the points of a grid with sizes n and strides s
+% (the first dimension changes fastest)
+function off=gridoffsets(n,s)
+  off=0;
+  for k=1:length(n)
+    off=bsxfun(@plus,off(:),s(k)*(0:n(k)-1));
+  end
+  off=off(:);
+
 % the evaluation routine called to evaluate the function
 function f=evalfunc(x,F,control,reorder,Iexpand)
   F{control{1,1}}=x;   % set the input factor as the first factor
@@ -1,9 +1,24 @@
 #include "mxInfo_mex.h"
 
 /* memory management functions */
+/* N.B. the mx memory functions are not thread safe so inside an OpenMP
+	parallel region (see tprod.c) the C library versions are used. Memory
+	must be freed in the same context it was allocated in. */
+#ifdef _OPENMP
+#include <stdlib.h>
+#include <omp.h>
+void *CALLOC(size_t nmemb, size_t size){  
+  return omp_in_parallel() ? calloc(nmemb,size) : mxCalloc(nmemb,size); 
+}
+void *MALLOC(size_t size) { 
+  return omp_in_parallel() ? malloc(size) : mxMalloc(size); 
+}
+void FREE(void *ptr) {  if ( omp_in_parallel() ) free(ptr); else mxFree(ptr); }
+#else
 void *CALLOC(size_t nmemb, size_t size){  return mxCalloc(nmemb,size); }
 void *MALLOC(size_t size) { return mxMalloc(size); }
 void FREE(void *ptr) {  mxFree(ptr); }
+#endif
 void ERROR(const char *msg) { mexErrMsgTxt(msg); }
 void WARNING(const char *msg) { mexWarnMsgTxt(msg); }
 
@@ -25,9 +25,13 @@ Examples:
 
 result has size: [size(X) size(Y)] where the accumulated dims are now size==1
 
-TODO:
-  1) Would be nice to fall back on BLAS calls for the innermost cases when we
-  have a standard 2d x 2d matrix multiply.
+Multi-threading and BLAS:
+  When compiled with OpenMP large problems are split across threads along
+  one of the non-accumulated (outer product) dimensions of the result, so
+  each thread writes to a different part of Z. When compiled with USEBLAS
+  defined (and linked with a BLAS library, e.g. -lmwblas) real double
+  problems that reduce to a single 2d x 2d matrix multiply are passed to
+  dgemm; the remaining cases use the (cache blocked) code below.
 
 N.B. compile with TPRODLIB defined to get an version without mexFunction
 defined to use in other mex-files
@@ -51,6 +55,26 @@ $Id: tprod.c,v 1.53 2007-09-07 13:56:14 jdrf Exp $
 
 #include "mxInfo.h"
 #include "tprod.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef USEBLAS
+#include <stddef.h>
+/* BLAS matrix multiply with 64-bit integers as in MATLAB's libmwblas
+	(declared here as blas.h requires the -largeArrayDims API) */
+#if !defined(_WIN32)
+#define dgemm dgemm_
+#endif
+extern void dgemm(char *transa, char *transb, ptrdiff_t *m, ptrdiff_t *n, 
+						ptrdiff_t *k, double *alpha, double *a, ptrdiff_t *lda, 
+						double *b, ptrdiff_t *ldb, double *beta, double *c, 
+						ptrdiff_t *ldc);
+#endif
+
+/* minimum number of multiply accumulates for multi-threading */
+#ifndef TPRODPARTHRESH
+#define TPRODPARTHRESH 262144
+#endif
 
 /* process the input type information */
 #ifndef XDTYPE 
@@ -124,8 +148,45 @@ $Id: tprod.c,v 1.53 2007-09-07 13:56:14 jdrf Exp $
 /* #define FNNMEXT rxry */
 #include "tprod.def"   /* real x, real y */
 
-/* function to compute the generalised tensor product */
-TprodErrorCode CAT(TYPESTR,tprod)(const MxInfo zinfo, 
+#if defined(USEBLAS) && (XDTYPE == DOUBLE_DTYPE) && (YDTYPE == DOUBLE_DTYPE)
+/* Pass a real problem that is a single 2d x 2d matrix multiply, i.e.
+	Z(i,j) += sum_k X(i,k)*Y(k,j), to dgemm. The strides of X and Y must
+	make each of them a (possibly transposed) column major matrix.
+	Returns 0 if the problem does not have this form. */
+static int CAT(TYPESTR,gemm_tprod)(const MxInfo *zrest, 
+											  const MxInfo *xrest, const MxInfo *yrest,
+											  const MxInfo *xmacc, const MxInfo *ymacc){
+  ptrdiff_t M, N, K, lda, ldb, ldc;
+  char transa, transb;
+  double one=1.0;
+  if ( zrest->nd!=2 || xmacc->nd!=1 || 
+		 xrest->ip!=0 || yrest->ip!=0 || zrest->ip!=0 ||
+		 yrest->stride[0]!=0 || xrest->stride[1]!=0 ) return 0;
+  M=zrest->sz[0]; N=zrest->sz[1]; K=xmacc->sz[0];
+  if ( M<2 || N<2 || K<1 ) return 0;
+  /* Z must be column major */
+  if ( zrest->stride[0]!=1 || zrest->stride[1]<M ) return 0;
+  ldc=zrest->stride[1];
+  /* X is M x K */
+  if ( xrest->stride[0]==1 && (K==1 || xmacc->stride[0]>=M) ) {
+	 transa='N'; lda=(K==1)?M:xmacc->stride[0];
+  } else if ( (K==1 || xmacc->stride[0]==1) && xrest->stride[0]>=K ) {
+	 transa='T'; lda=xrest->stride[0];
+  } else return 0;
+  /* Y is K x N */
+  if ( (K==1 || ymacc->stride[0]==1) && yrest->stride[1]>=K ) {
+	 transb='N'; ldb=yrest->stride[1];
+  } else if ( yrest->stride[1]==1 && (K==1 || ymacc->stride[0]>=N) ) {
+	 transb='T'; ldb=(K==1)?N:ymacc->stride[0];
+  } else return 0;
+  dgemm(&transa,&transb,&M,&N,&K,&one,(double*)xrest->rp,&lda,
+		  (double*)yrest->rp,&ldb,&one,(double*)zrest->rp,&ldc);
+  return 1;
+}
+#endif
+
+/* function to compute the generalised tensor product (single threaded) */
+static TprodErrorCode CAT(TYPESTR,tprod1)(const MxInfo zinfo, 
 											 const MxInfo xrestin, const MxInfo yrestin,
 											 const MxInfo xmaccin, const MxInfo ymaccin,
 											 int blksz){
@@ -165,6 +226,16 @@ TprodErrorCode CAT(TYPESTR,tprod)(const MxInfo zinfo,
   /* enum for the input type, rxry=0,cxry=1,rxcy=2,cxcy=3 */
   intype = (xrest.ip==0?0:1) + (yrest.ip==0?0:2); /* now compute type call */
   
+#if defined(USEBLAS) && (XDTYPE == DOUBLE_DTYPE) && (YDTYPE == DOUBLE_DTYPE)
+  /*-------------------------------------------------------------------------*/
+  /* a plain matrix multiply is done by BLAS */
+  if ( intype==RXRY && CAT(TYPESTR,gemm_tprod)(&zrest,&xrest,&yrest,&xmacc,&ymacc) ) {
+	 delmxInfo(&zrest);delmxInfo(&xrest);delmxInfo(&yrest);
+	 delmxInfo(&xmacc);delmxInfo(&ymacc);FREE(maccsubs); 
+	 return retVal;
+  }
+#endif
+
   /*-------------------------------------------------------------------------*/
   /* use the fast b22 code when we have op over x/y in first 2 dims */
   /* 2 dims only if 2 output dims and y stride 0 in dim 0 and x stride 0 in
@@ -426,3 +497,62 @@ TprodErrorCode CAT(TYPESTR,tprod)(const MxInfo zinfo,
   delmxInfo(&xmacc);delmxInfo(&ymacc);FREE(maccsubs); 
   return retVal;
 }
+
+/* function to compute the generalised tensor product */
+/* With OpenMP large problems are divided into blocks along one of the
+	outer product dimensions of Z; each thread calls the single threaded
+	code on its own block so no two threads write to the same element. */
+TprodErrorCode CAT(TYPESTR,tprod)(const MxInfo zinfo, 
+											 const MxInfo xrestin, const MxInfo yrestin,
+											 const MxInfo xmaccin, const MxInfo ymaccin,
+											 int blksz){
+#ifdef _OPENMP
+  int nthreads=omp_get_max_threads();
+  double work=1;
+  int i, d=-1, t, nt;
+  MxInfo *zb, *xb, *yb;
+  TprodErrorCode *errs, retVal=OK;
+  for ( i=0; i<zinfo.nd;  i++ ) work*=zinfo.sz[i];
+  for ( i=0; i<xmaccin.nd; i++ ) work*=xmaccin.sz[i];
+  if ( nthreads>1 && work>=TPRODPARTHRESH && 
+		 xrestin.nd==zinfo.nd && yrestin.nd==zinfo.nd ) {
+	 /* split the last dimension that has a block for every thread, or
+		 failing that the largest one */
+	 for ( i=zinfo.nd-1; i>=0; i-- ) if ( zinfo.sz[i]>=nthreads ) { d=i; break; }
+	 if ( d<0 ) {
+		for ( d=0, i=1; i<zinfo.nd; i++ ) if ( zinfo.sz[i]>zinfo.sz[d] ) d=i;
+	 }
+	 nt=MIN(nthreads,zinfo.sz[d]);
+	 if ( nt>1 ) {
+		/* N.B. all memory is allocated here; inside the parallel region
+			CALLOC/FREE must be thread safe (see mxInfo_mex.c) */
+		zb=(MxInfo*)CALLOC(3*nt,sizeof(MxInfo));
+		xb=zb+nt; yb=xb+nt;
+		errs=(TprodErrorCode*)CALLOC(nt,sizeof(TprodErrorCode));
+		for ( t=0; t<nt; t++ ){
+		  int start=(int)(((double)zinfo.sz[d]*t)/nt);
+		  int len  =(int)(((double)zinfo.sz[d]*(t+1))/nt)-start;
+		  zb[t]=copymxInfo(zinfo); xb[t]=copymxInfo(xrestin); yb[t]=copymxInfo(yrestin);
+		  zb[t].sz[d]=len; xb[t].sz[d]=len; yb[t].sz[d]=len;
+		  zb[t].rp=(double*)((ZTYPE*)zinfo.rp+start*zinfo.stride[d]);
+		  if ( zinfo.ip ) zb[t].ip=(double*)((ZTYPE*)zinfo.ip+start*zinfo.stride[d]);
+		  xb[t].rp=(double*)((XTYPE*)xrestin.rp+start*xrestin.stride[d]);
+		  if ( xrestin.ip ) xb[t].ip=(double*)((XTYPE*)xrestin.ip+start*xrestin.stride[d]);
+		  yb[t].rp=(double*)((YTYPE*)yrestin.rp+start*yrestin.stride[d]);
+		  if ( yrestin.ip ) yb[t].ip=(double*)((YTYPE*)yrestin.ip+start*yrestin.stride[d]);
+		}
+#pragma omp parallel for num_threads(nt) schedule(static,1)
+		for ( t=0; t<nt; t++ ){
+		  errs[t]=CAT(TYPESTR,tprod1)(zb[t],xb[t],yb[t],xmaccin,ymaccin,blksz);
+		}
+		for ( t=0; t<nt; t++ ){
+		  if ( errs[t]!=OK ) retVal=errs[t];
+		  delmxInfo(zb+t); delmxInfo(xb+t); delmxInfo(yb+t);
+		}
+		FREE(errs); FREE(zb);
+		return retVal;
+	 }
+  }
+#endif
+  return CAT(TYPESTR,tprod1)(zinfo,xrestin,yrestin,xmaccin,ymaccin,blksz);
+}
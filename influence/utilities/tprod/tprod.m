@@ -141,7 +141,12 @@ end
 
 try % try recompiling the MEX file
    fprintf(['Compiling ' mfilename ' for first use\n']);
-   mex('ddtprod.c','dstprod.c','sdtprod.c','sstprod.c','tprod_util.c','tprod_mex.c','mxInfo.c','mxInfo_mex.c','-O','-output',mfilename);
+   % multi-threaded with OpenMP and using MATLAB's BLAS for matrix multiplies
+   if ispc,      flags={'COMPFLAGS=$COMPFLAGS /openmp'};
+   elseif ismac, flags={};
+   else          flags={'CFLAGS=$CFLAGS -fopenmp','LDFLAGS=$LDFLAGS -fopenmp'};
+   end
+   mex('ddtprod.c','dstprod.c','sdtprod.c','sstprod.c','tprod_util.c','tprod_mex.c','mxInfo.c','mxInfo_mex.c','-O',flags{:},'-DUSEBLAS','-lmwblas','-output',mfilename);
    fprintf('done\n');
 catch
    % this may well happen happen, get back to current working directory!
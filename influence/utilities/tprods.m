@@ -1,4 +1,7 @@
 % Called by tprodm
+% When x and y are both sparse the MEX file tprodsc is used if it is
+% available; it works directly on the non-zero elements so neither input
+% is permuted or expanded.
 % This algorithm works by permuting x and y so the matched dimensions are
 % in the columns and the unmatched are in the rows. It then uses a
 % columnwise Kronecker product. Any summed dimensions are then summed
@@ -46,6 +49,19 @@ function [z,nzz]=tprods(x,x2z,nx,y,y2z,ny,nzout,zsparse)
     ii=find(abs(x2z)==i); if ~isempty(ii), nz(i)=nx(ii); end
     ii=find(abs(y2z)==i); if ~isempty(ii), nz(i)=ny(ii); end
   end
+  % sparse x sparse products are done directly on the non-zeros
+  if issparse(x) && issparse(y) && exist('tprodsc','file')==3  % use mex file if it exists
+    nzz=nz(1:max([0 x2z y2z]));
+    summed=-[x2z(x2z<0) y2z(y2z<0)];   % summed dimensions have size 1 in z
+    nzz(summed(summed<=length(nzz)))=1;
+    if zsparse 
+      z=tprodsc(x,x2z,nx,y,y2z,ny,nzout);
+    else
+      if isempty(nzout), nzout=nzz; end
+      z=reshape(full(tprodsc(x,x2z,nx,y,y2z,ny)),[nzout 1 1]);
+    end
+    return
+  end
   % q has the matched dimensions in sorted order
   [q,ix,iy]=intersect(x2z,y2z);
   nomatchx=find(~ismember(x2z,q));
@@ -0,0 +1,319 @@
+#include "mex.h"
+#include <stdlib.h>
+/*
+% tprodsc Tensor product of two sparse virtually multidimensional arrays
+% USAGE
+%   z=tprodsc(x,x2z,nx,y,y2z,ny,nzout);
+% INPUTS
+%   x     : sparse (or full) array with prod(nx) elements
+%   x2z   : labels of the dimensions of x
+%   nx    : sizes of the dimensions of x
+%   y     : sparse (or full) array with prod(ny) elements
+%   y2z   : labels of the dimensions of y
+%   ny    : sizes of the dimensions of y
+%   nzout : 2-vector with the number of rows and columns of z
+%             [default: [nz(1) prod(nz(2:end))]]
+% OUTPUT
+%   z     : sparse nzout(1) x nzout(2) matrix
+%
+% The labels follow tprod: positive label i puts the dimension in
+% dimension i of z and negative labels are summed. A label found in both
+% x and y matches the two dimensions (they must be the same size); a
+% summed label found in only one input is summed over that input. The
+% dimensions of x, y and z are virtual: the first dimension varies fastest
+% over the elements of the array whatever the number of rows.
+%
+% Only the non-zero elements are used. The elements of x and y are sorted
+% on the matched dimensions and the products of elements with equal keys
+% are accumulated into the columns of z, so no full array is formed and
+% the work is proportional to the number of products of non-zeros.
+%
+% Used by tprods.
+%
+% Coded as a MEX file
+*/
+
+/* a non-zero element: key on the matched dimensions, offset in z, value */
+typedef struct {
+  mwIndex key;
+  mwIndex z;
+  double  v;
+} tpelement;
+
+static int compkey(const void *a, const void *b)
+{
+  mwIndex ka=((const tpelement *)a)->key, kb=((const tpelement *)b)->key;
+  return ka<kb ? -1 : (ka>kb ? 1 : 0);
+}
+
+/* position of label in the list or -1 */
+static int findlabel(const double *labels, mwSize n, double label)
+{
+  mwSize i;
+  for (i=0; i<n; i++) if (labels[i]==label) return (int)i;
+  return -1;
+}
+
+/* the non-zero elements of x with their keys and z offsets */
+static tpelement *getelements(const mxArray *x, mwSize d,
+                              const mwSize *nx, const mwIndex *zmult,
+                              const mwIndex *kmult, mwSize *nnzx)
+{
+  mwSize m=mxGetM(x), n=mxGetN(x), nnz, i, j, k;
+  mwIndex *ir=NULL, *jc=NULL, lin, c;
+  double *pr=mxGetPr(x);
+  int sparse=mxIsSparse(x);
+  tpelement *e;
+
+  if (sparse){
+    ir=mxGetIr(x);
+    jc=mxGetJc(x);
+    nnz=jc[n];
+  }
+  else{
+    nnz=0;
+    for (k=0; k<m*n; k++) if (pr[k]!=0) nnz++;
+  }
+  e=mxMalloc((nnz>0 ? nnz : 1)*sizeof(tpelement));
+  k=0;
+  for (j=0; j<n; j++){
+    mwIndex kk, kend;
+    if (sparse){ kk=jc[j]; kend=jc[j+1]; }
+    else       { kk=j*m;   kend=kk+m;     }
+    for (; kk<kend; kk++){
+      if (pr[kk]==0) continue;
+      lin = sparse ? ir[kk]+j*m : kk;
+      e[k].key=0;
+      e[k].z=0;
+      e[k].v=pr[kk];
+      // the first dimension varies fastest
+      for (i=0; i<d; i++){
+        c=lin%nx[i];
+        lin/=nx[i];
+        e[k].key+=c*kmult[i];
+        e[k].z+=c*zmult[i];
+      }
+      k++;
+    }
+  }
+  *nnzx=k;
+  return e;
+}
+
+/* sorts a list of row indices (short lists with insertion sort) */
+static int comprow(const void *a, const void *b)
+{
+  mwIndex ia=*(const mwIndex *)a, ib=*(const mwIndex *)b;
+  return ia<ib ? -1 : (ia>ib ? 1 : 0);
+}
+
+static void sortrows(mwIndex *r, mwSize n)
+{
+  mwSize i, j;
+  mwIndex t;
+  if (n>16){ qsort(r,n,sizeof(mwIndex),comprow); return; }
+  for (i=1; i<n; i++){
+    t=r[i];
+    for (j=i; j>0 && r[j-1]>t; j--) r[j]=r[j-1];
+    r[j]=t;
+  }
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  const double *x2z, *y2z, *pnx, *pny;
+  mwSize dx, dy, dz, i, j, nnzx, nnzy, nprod, rout, cout, nnzz, col;
+  mwSize *nx, *ny, *nz, *count, *ptr, *pos;
+  mwIndex *zmultx, *zmulty, *kmultx, *kmulty, *rows, *mark, *ir, *jc, *list;
+  mwIndex kstride, zstride, a, a1, b, b1, ia, ib, r, L;
+  double *vals, *acc, *pr, label, total;
+  int k;
+  tpelement *ex, *ey;
+
+  if (nrhs<6) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>7) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  for (i=0; i<(mwSize)nrhs; i++){
+    if (!mxIsDouble(prhs[i]) || mxIsComplex(prhs[i]))
+      mexErrMsgTxt("Inputs must be real double arrays");
+    if (i!=0 && i!=3 && mxIsSparse(prhs[i]))
+      mexErrMsgTxt("Inputs 2, 3, 5, 6 and 7 must be full");
+  }
+  dx=mxGetNumberOfElements(prhs[1]);
+  dy=mxGetNumberOfElements(prhs[4]);
+  if (mxGetNumberOfElements(prhs[2])!=dx || mxGetNumberOfElements(prhs[5])!=dy)
+    mexErrMsgTxt("The labels and sizes must be the same length");
+  x2z=mxGetPr(prhs[1]); pnx=mxGetPr(prhs[2]);
+  y2z=mxGetPr(prhs[4]); pny=mxGetPr(prhs[5]);
+
+  nx=mxMalloc((dx+dy+1)*sizeof(mwSize));
+  ny=nx+dx;
+  total=1; for (i=0; i<dx; i++){ nx[i]=(mwSize)pnx[i]; total*=pnx[i]; }
+  if (total!=(double)mxGetNumberOfElements(prhs[0]))
+    mexErrMsgTxt("x and nx are incompatible");
+  total=1; for (i=0; i<dy; i++){ ny[i]=(mwSize)pny[i]; total*=pny[i]; }
+  if (total!=(double)mxGetNumberOfElements(prhs[3]))
+    mexErrMsgTxt("y and ny are incompatible");
+
+  // the output dimensions are the positive labels
+  dz=0;
+  for (i=0; i<dx; i++) if (x2z[i]>dz) dz=(mwSize)x2z[i];
+  for (i=0; i<dy; i++) if (y2z[i]>dz) dz=(mwSize)y2z[i];
+  nz=mxMalloc((dz>0 ? dz : 1)*sizeof(mwSize));
+  for (i=0; i<dz; i++) nz[i]=1;
+  for (i=0; i<dx; i++){
+    if (x2z[i]==0 || x2z[i]!=(double)(mwSignedIndex)x2z[i] ||
+        findlabel(x2z,i,x2z[i])>=0 || findlabel(x2z,i,-x2z[i])>=0)
+      mexErrMsgTxt("x2z must contain distinct non-zero integers");
+    if (x2z[i]>0) nz[(mwSize)x2z[i]-1]=nx[i];
+  }
+  for (i=0; i<dy; i++){
+    if (y2z[i]==0 || y2z[i]!=(double)(mwSignedIndex)y2z[i] ||
+        findlabel(y2z,i,y2z[i])>=0 || findlabel(y2z,i,-y2z[i])>=0)
+      mexErrMsgTxt("y2z must contain distinct non-zero integers");
+    if (findlabel(x2z,dx,-y2z[i])>=0)
+      mexErrMsgTxt("A label cannot be used with both signs");
+    k=findlabel(x2z,dx,y2z[i]);
+    if (k>=0 && nx[k]!=ny[i])
+      mexErrMsgTxt("Matched dimensions must be the same size");
+    if (y2z[i]>0) nz[(mwSize)y2z[i]-1]=ny[i];
+  }
+  total=1; for (i=0; i<dz; i++) total*=nz[i];
+  if (nrhs>6 && !mxIsEmpty(prhs[6])){
+    if (mxGetNumberOfElements(prhs[6])!=2)
+      mexErrMsgTxt("nzout must be a 2-vector");
+    rout=(mwSize)mxGetPr(prhs[6])[0];
+    cout=(mwSize)mxGetPr(prhs[6])[1];
+    if ((double)rout*(double)cout!=total)
+      mexErrMsgTxt("nzout is not compatible with the size of z");
+  }
+  else{
+    rout = dz>0 ? nz[0] : 1;
+    cout = (mwSize)(total/rout);
+  }
+
+  // multipliers for the z offset and for the key on the matched dimensions
+  zmultx=mxMalloc(2*(dx+dy)*sizeof(mwIndex));
+  kmultx=zmultx+dx;
+  zmulty=kmultx+dx;
+  kmulty=zmulty+dy;
+  for (i=0; i<dx; i++){
+    label=x2z[i];
+    zmultx[i]=0;
+    if (label>0){
+      zstride=1;
+      for (j=0; j+1<(mwSize)label; j++) zstride*=nz[j];
+      zmultx[i]=zstride;
+    }
+  }
+  kstride=1;
+  for (i=0; i<dx; i++){
+    kmultx[i]=0;
+    k=findlabel(y2z,dy,x2z[i]);
+    if (k>=0){
+      kmultx[i]=kstride;
+      kstride*=nx[i];
+    }
+  }
+  for (i=0; i<dy; i++){
+    label=y2z[i];
+    k=findlabel(x2z,dx,label);
+    zmulty[i]=0;
+    kmulty[i]=0;
+    if (k>=0) kmulty[i]=kmultx[k];  // matched: z offset comes from x
+    else if (label>0){
+      zstride=1;
+      for (j=0; j+1<(mwSize)label; j++) zstride*=nz[j];
+      zmulty[i]=zstride;
+    }
+  }
+
+  ex=getelements(prhs[0],dx,nx,zmultx,kmultx,&nnzx);
+  ey=getelements(prhs[3],dy,ny,zmulty,kmulty,&nnzy);
+  qsort(ex,nnzx,sizeof(tpelement),compkey);
+  qsort(ey,nnzy,sizeof(tpelement),compkey);
+
+  // first pass: count the products in each column of z
+  count=mxCalloc(cout+1,sizeof(mwSize));
+  nprod=0;
+  for (a=0, b=0; a<nnzx && b<nnzy;){
+    if      (ex[a].key<ey[b].key) a++;
+    else if (ex[a].key>ey[b].key) b++;
+    else{
+      for (a1=a; a1<nnzx && ex[a1].key==ex[a].key; a1++);
+      for (b1=b; b1<nnzy && ey[b1].key==ey[b].key; b1++);
+      for (ia=a; ia<a1; ia++)
+        for (ib=b; ib<b1; ib++) count[(ex[ia].z+ey[ib].z)/rout+1]++;
+      nprod+=(a1-a)*(b1-b);
+      a=a1; b=b1;
+    }
+  }
+  for (j=0; j<cout; j++) count[j+1]+=count[j];
+
+  // second pass: put the products into the columns
+  rows=mxMalloc((nprod>0 ? nprod : 1)*sizeof(mwIndex));
+  vals=mxMalloc((nprod>0 ? nprod : 1)*sizeof(double));
+  pos=mxMalloc((cout+1)*sizeof(mwSize));
+  for (j=0; j<=cout; j++) pos[j]=count[j];
+  for (a=0, b=0; a<nnzx && b<nnzy;){
+    if      (ex[a].key<ey[b].key) a++;
+    else if (ex[a].key>ey[b].key) b++;
+    else{
+      for (a1=a; a1<nnzx && ex[a1].key==ex[a].key; a1++);
+      for (b1=b; b1<nnzy && ey[b1].key==ey[b].key; b1++);
+      for (ia=a; ia<a1; ia++){
+        for (ib=b; ib<b1; ib++){
+          L=ex[ia].z+ey[ib].z;
+          col=L/rout;
+          rows[pos[col]]=L-col*rout;
+          vals[pos[col]++]=ex[ia].v*ey[ib].v;
+        }
+      }
+      a=a1; b=b1;
+    }
+  }
+  mxFree(pos);
+  mxFree(ex);
+  mxFree(ey);
+
+  // sum the products with the same row in each column (in place)
+  acc=mxCalloc(rout>0 ? rout : 1,sizeof(double));
+  mark=mxMalloc((rout>0 ? rout : 1)*sizeof(mwIndex));
+  for (r=0; r<rout; r++) mark[r]=cout;
+  ptr=mxMalloc((cout+1)*sizeof(mwSize));
+  nnzz=0;
+  ptr[0]=0;
+  for (j=0; j<cout; j++){
+    list=rows+nnzz;   // the rows of column j overwrite the used products
+    i=0;
+    for (L=count[j]; L<count[j+1]; L++){
+      r=rows[L];
+      if (mark[r]!=j){ mark[r]=j; acc[r]=0; list[i++]=r; }
+      acc[r]+=vals[L];
+    }
+    sortrows(list,i);
+    for (L=0; L<i; L++){
+      r=list[L];
+      if (acc[r]!=0){ rows[nnzz]=r; vals[nnzz++]=acc[r]; }
+    }
+    ptr[j+1]=nnzz;
+  }
+  mxFree(acc);
+  mxFree(mark);
+  mxFree(count);
+
+  plhs[0]=mxCreateSparse(rout,cout,nnzz>0 ? nnzz : 1,mxREAL);
+  pr=mxGetPr(plhs[0]);
+  ir=mxGetIr(plhs[0]);
+  jc=mxGetJc(plhs[0]);
+  for (j=0; j<=cout; j++) jc[j]=ptr[j];
+  for (L=0; L<nnzz; L++){ ir[L]=rows[L]; pr[L]=vals[L]; }
+  mxFree(ptr);
+  mxFree(rows);
+  mxFree(vals);
+  mxFree(zmultx);
+  mxFree(nz);
+  mxFree(nx);
+}
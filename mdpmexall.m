@@ -9,6 +9,17 @@
 %
 % Note: this will compile all of the C files in the 
 %   MDPSOLVE disrectory and its subdirectories
+%
+% C files that contain OpenMP directives are compiled with OpenMP
+%   enabled so they run multi-threaded (see ompflags below) and files
+%   that use POSIX threads are linked with the pthread library
+%
+% The bench directory is skipped; it contains a stand-alone benchmark
+%   program that is built with its own Makefile
+%
+% The C++ files in mdputils/kdtree are compiled separately (see makekdtree);
+%   each MEX file links with kdtree.cpp and is placed in the @kdtree
+%   class directory
 
 function mdpmexall
 
@@ -20,6 +31,7 @@ mdpdir=stripdir(mdpdir);
 % process subdirectories
 cd(mdpdir)
 processdir
+makekdtree(fullfile(mdpdir,'mdputils','kdtree'))
 % switch back to original default directory
 cd(currentdir)
 
@@ -33,14 +45,50 @@ for i=3:length(fn)
   if fn(i).isdir
     if ~strcmp(fn(i).name(1),'@') && ...
       ~strcmp(fn(i).name,'kdtree') && ...
-      ~strcmp(fn(i).name,'tprod')
+      ~strcmp(fn(i).name,'tprod') && ...
+      ~strcmp(fn(i).name,'bench')
       cd(['.\' fn(i).name])
       processdir
       cd(currentdir)
     end
   elseif strcmp(fn(i).name(end-1:end),'.c')
     % mex all C files in the mdputils subdirectory
-    eval(['mex -largeArrayDims ' fn(i).name])
+    % files that use OpenMP are compiled with multi-threading enabled
+    src=fileread(fn(i).name);
+    flags='';
+    if ~isempty(strfind(src,'_OPENMP')), flags=[flags ' ' ompflags]; end
+    if ~isempty(strfind(src,'pthread.h')) && ~ispc, flags=[flags ' -lpthread']; end
+    eval(['mex -largeArrayDims' flags ' ' fn(i).name])
     disp(['mex file created for ' cd '\' fn(i).name])
   end
 end
+
+% builds the kdtree MEX files from the sources in kdtreedir
+% kdtree is built from kdtree_create.cpp; the others from the file of the same name
+function makekdtree(kdtreedir)
+currentdir=cd;
+cd(kdtreedir)
+names={'kdtree','kdtree_closestpoint','kdtree_range','kdtree_knn','kdtree_scatbas'};
+outdir=fullfile('..','@kdtree');
+for i=1:length(names)
+  if strcmp(names{i},'kdtree'), src='kdtree_create.cpp';
+  else                          src=[names{i} '.cpp'];
+  end
+  eval(['mex -largeArrayDims -I. ' ompflags(true) ' -outdir ' outdir ...
+        ' -output ' names{i} ' ' src ' kdtree.cpp'])
+  disp(['mex file created for ' fullfile(kdtreedir,outdir,names{i})])
+end
+cd(currentdir)
+
+% compiler flags needed to enable OpenMP (cpp=true for C++ files)
+function flags=ompflags(cpp)
+if nargin<1, cpp=false; end
+if ispc
+  flags='COMPFLAGS="$COMPFLAGS /openmp"';
+elseif ismac
+  flags='';  % the default clang compiler does not support OpenMP
+elseif cpp
+  flags='CXXFLAGS="$CXXFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp"';
+else
+  flags='CFLAGS="$CFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp"';
+end
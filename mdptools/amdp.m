@@ -226,7 +226,11 @@ clear ii jj
 
 % low memory procedure to obtain Pb - loops over belief values
 function Pb=getPbAlt1(q,p,ns,nx,N,P,b)
-Pb=sparse(ns*N,N*nx);  
+usesb=exist('sparsebuilder','file')==3;
+if usesb, Pb=sparsebuilder('create',ns*N,N*nx);
+          c=onCleanup(@() sparsebuilder('clear',Pb));  % frees it on error
+else      Pb=sparse(ns*N,N*nx);  
+end
 startcol=1;
 for j=1:N
   if q==2  % save some time and memory
@@ -270,10 +274,13 @@ for j=1:N
   jj=ceil(jj/ns);    
   Pbj=sparse(ii,jj,Pbj,N*ns,nx); 
   clear ii jj
-  Pb=add2sparse(Pb,Pbj,startcol,0.6,true);
+  if usesb, sparsebuilder('add',Pb,Pbj,startcol);
+  else      Pb=add2sparse(Pb,Pbj,startcol,0.6,true);
+  end
   clear Pbj 
   startcol=startcol+nx;
 end
+if usesb, Pb=sparsebuilder('finish',Pb); end
 Pb=Pb(:,reshape(1:nx*N,nx,N)');
 
 
@@ -281,7 +288,11 @@ Pb=Pb(:,reshape(1:nx*N,nx,N)');
 % the assumption here is that N<<nx
 % loops over state/action combinations
 function Pb=getPbAlt2(q,p,ns,nx,N,P,b)
-Pb=sparse(ns*N,nx*N);
+usesb=exist('sparsebuilder','file')==3;
+if usesb, Pb=sparsebuilder('create',ns*N,nx*N);
+          c=onCleanup(@() sparsebuilder('clear',Pb));  % frees it on error
+else      Pb=sparse(ns*N,nx*N);
+end
 startcol=1;
 for j=1:nx
   if q==2  % save some time and memory
@@ -319,7 +330,10 @@ for j=1:nx
   jj=ceil(jj/ns);
   Pbj=sparse(ii,jj,Pbj,N*ns,N);
   clear ii jj
-  Pb=add2sparse(Pb,Pbj,startcol,0.6,true);
+  if usesb, sparsebuilder('add',Pb,Pbj,startcol);
+  else      Pb=add2sparse(Pb,Pbj,startcol,0.6,true);
+  end
   clear Pbj
   startcol=startcol+N;
-end
\ No newline at end of file
+end
+if usesb, Pb=sparsebuilder('finish',Pb); end
\ No newline at end of file
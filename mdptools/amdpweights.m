@@ -19,8 +19,8 @@ if iscell(X)
   Bx=rectbas(Xhist(1:T-1,:),X,[],2);
 % X is composed of arbitrary points
 else
-  Bs=scatterbas(Xhist(2:T,svars),tesselate(X(:,svars)));
-  Bx=scatterbas(Xhist(1:T-1,:),tesselate(X));
+  Bs=scatbas(Xhist(2:T,svars),X(:,svars));
+  Bx=scatbas(Xhist(1:T-1,:),X);
 end
 w(1,:)=w0(:)';
 W=zeros(T-1,q);
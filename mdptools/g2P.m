@@ -38,11 +38,16 @@
 %   non-empty) g should accept a k-row matrix X and an associated k-row
 %   matrix of random noise terms.
 %
-% Currently this function only handles regular rectangular grids.
-
+% s may also be a structure variable with a field 'type' and associated
+%   grid information:
+%     type='rectangular' : grid is a cell array of state variable vectors
+%     type='scatter'     : grid is an nxd matrix of arbitrary grid points
+%                          interpolation uses scatbas; other fields of s
+%                          (k, method, power, tree) are passed to scatbas
+%
 % programming note:
-% the function implements interpolation for simplex and scattered grids as well 
-% but these features have not be adequately tested or documented
+% the function implements interpolation for simplex grids as well 
+% but this feature has not been adequately tested or documented
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011-2013, Paul L. Fackler (paul_fackler@ncsu.edu)
@@ -121,6 +126,14 @@ if isstruct(s)
         s=s.grid;
       case 'scatter'
         geometry=1;
+        % build the kdtree once for all of the shock values
+        if ~isfield(s,'tree') || isempty(s.tree)
+          s.tree=kdtree(s.grid);
+        end
+        if isfield(s,'method') && strcmpi(s.method,'simplex') && ...
+           (~isfield(s,'tri') || isempty(s.tri))
+          s.tri=delaunayn(s.grid);
+        end
       case 'simplex'
         geometry=2;
     end
@@ -201,7 +214,7 @@ function Pk=getPk(gval,s,geometry,cleanup)
     case 0
       Pk = rectbas(gval,s,[],cleanup);
     case 1
-      Pk = scatterbas(gval,s);
+      Pk = scatbas(gval,s);
     case 2
       Pk = simplexbas(gval,s.params{:});
     case 3
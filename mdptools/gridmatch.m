@@ -1,13 +1,19 @@
 % gridmatch Finds the index of the nearest neighbor on a grid
 % USAGE
-%   ind=gridmatch(X,x);
+%   ind=gridmatch(X,x,inttype);
 % INPUTS
-%   X : mxd matrix or d-element cell array composed of mx1 vectors
-%   x : d-element cell array with element i an n(i)x1 vector
+%   X       : mxd matrix or d-element cell array composed of mx1 vectors
+%   x       : d-element cell array with element i an n(i)x1 vector
+%   inttype : 1 to return ind as uint32 (uint64 for grids with
+%               2^32 or more points) [default: 0]
 % OUTPUT
 %   ind : mx1 vector of index values on {1,...,prod(n))
 %         if XX=rectgrid(x) then XX(ind,:) is the
 %         nearest neighbor on the grid to X.
+%
+% Uses the MEX file gridmatchc if it is available; it makes a single pass
+% through the rows of X and computes the position directly when the
+% values in x{i} are evenly spaced.
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2014, Paul L. Fackler (paul_fackler@ncsu.edu)
 % All rights reserved.
@@ -38,10 +44,19 @@
 % For more information, see the Open Source Initiative OSI site:
 %   http://www.opensource.org/licenses/bsd-license.php
 
-function ind=gridmatch(X,x)
+function ind=gridmatch(X,x,inttype)
+if nargin<3 || isempty(inttype), inttype=0; end
 if ~iscell(x), x={x}; end
 d=length(x);
 
+if exist('gridmatchc','file')==3  % use mex file if it exists
+  if iscell(X), X=cellfun(@(Xi) double(Xi(:)),X,'UniformOutput',false);
+  else          X=double(X);
+  end
+  ind=gridmatchc(X,cellfun(@(xi) double(xi(:)),x,'UniformOutput',false),inttype);
+  return
+end
+
 if iscell(X)
   ind=getind(X{1},x{1});
   for i=2:d
@@ -54,6 +69,11 @@ else
   end
 end
 ind=ind+1; % convert to 1-base index
+if inttype
+  if prod(cellfun(@length,x))<2^32, ind=uint32(ind);
+  else                              ind=uint64(ind);
+  end
+end
     
 function ind=getind(X,x)  
   ind=lookup(x+[diff(x)/2;inf],X);
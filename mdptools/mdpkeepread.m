@@ -0,0 +1,112 @@
+% mdpkeepread Reads values and strategies written with the keepfile option
+% USAGE
+%   [v,Ixopt]=mdpkeepread(filename,t);
+% INPUTS
+%   filename : name of the file given as options.keepfile to mdpsolve
+%   t        : vector of periods to return [default: 1:T]
+% OUTPUTS
+%   v        : ns x length(t) matrix of values
+%   Ixopt    : ns x length(t) matrix of indices of the optimal rows of X
+%
+% These are the columns t of results.v and results.Ixopt that mdpsolve
+% returns with keepall=1 when no keepfile is used. If the file was
+% written without keepdelta it is memory mapped so only the requested
+% periods are read.
+
+% MDPSOLVE: MATLAB tools for solving Markov Decision Problems
+% Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
+% All rights reserved.
+%
+% Redistribution and use in source and binary forms, with or without
+% modification, are permitted provided that the following conditions are met:
+%
+%    * Redistributions of source code must retain the above copyright notice,
+%        this list of conditions and the following disclaimer.
+%    * Redistributions in binary form must reproduce the above copyright notice,
+%        this list of conditions and the following disclaimer in the
+%        documentation and/or other materials provided with the distribution.
+%    * Neither the name of the North Carolina State University nor of Paul L.
+%        Fackler may be used to endorse or promote products derived from this
+%        software without specific prior written permission.
+%
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+% FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+% DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+% SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+% CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+% OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+% OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+%
+% For more information, see the Open Source Initiative OSI site:
+%   http://www.opensource.org/licenses/bsd-license.php
+
+function [v,Ixopt]=mdpkeepread(filename,t)
+fid=fopen(filename,'r');
+if fid<0, error(['Cannot open ' filename]); end
+magic=char(fread(fid,4,'uint8')');
+hdr=fread(fid,3,'int32');
+if ~strcmp(magic,'MDPK') || hdr(1)~=1
+  fclose(fid);
+  error([filename ' was not created with the keepfile option'])
+end
+typestr={'uint8','uint16','uint32','double'};
+typebytes=[1 2 4 8];
+ptype=typestr{hdr(2)};
+pbytes=typebytes(hdr(2));
+keepdelta=bitand(hdr(3),1)>0;
+Xindexed=bitand(hdr(3),2)>0;
+sz=fread(fid,2,'int64');
+ns=sz(1); T=sz(2);
+if nargin<2 || isempty(t), t=1:T; end
+t=t(:)';
+if any(t<1 | t>T | t~=fix(t))
+  fclose(fid);
+  error(['t must contain integers between 1 and ' num2str(T)])
+end
+hbytes=64;
+v=zeros(ns,length(t));
+Ixopt=zeros(ns,length(t));
+
+if ~keepdelta
+  fclose(fid);
+  % fixed length records (period T first)
+  pad=mod(-ns*pbytes,8);
+  format={'double',[ns 1],'v'; ptype,[ns 1],'x'};
+  if pad>0, format(3,:)={'uint8',[1 pad],'pad'}; end
+  m=memmapfile(filename,'Offset',hbytes,'Format',format,'Repeat',T);
+  for j=1:length(t)
+    k=T-t(j)+1;
+    v(:,j)=m.Data(k).v;
+    Ixopt(:,j)=double(m.Data(k).x);
+  end
+else
+  % variable length records: apply the changes from period T down to
+  % the earliest period requested
+  if ns<2^32, itype='uint32'; ibytes=4; else itype='double'; ibytes=8; end
+  fseek(fid,hbytes,'bof');
+  x=zeros(ns,1);
+  for tt=T:-1:min(t)
+    j=find(t==tt);
+    if isempty(j)
+      fseek(fid,8*ns,'cof');
+    else
+      vt=fread(fid,ns,'double');
+    end
+    nchg=fread(fid,1,'int64');
+    ind=fread(fid,nchg,itype);
+    x(ind)=fread(fid,nchg,ptype);
+    fseek(fid,mod(-(8+nchg*(ibytes+pbytes)),8),'cof');
+    for jj=j
+      v(:,jj)=vt;
+      Ixopt(:,jj)=x;
+    end
+  end
+  fclose(fid);
+end
+% for problems with R ns x na need to transform a to x
+if ~Xindexed
+  Ixopt=ns*Ixopt + (1-ns:0)'*ones(1,length(t));
+end
@@ -101,6 +101,16 @@ end
 if isfield(results,'iter') && ~isempty(results.iter)
   disp(['MDPSOLVE ran for ' num2str(results.iter) ' iterations'])
 end
+if isfield(results,'PEiter') && ~isempty(results.PEiter) && results.PEiter>0
+  disp(['Iterations used in iterative policy evaluation: ' num2str(results.PEiter)])
+end
+if isfield(results,'profile') && ~isempty(results.profile)
+  p=results.profile;
+  disp(['Time (seconds) in expectations: ' num2str(sum(p.texp)) ...
+        ', maximization: ' num2str(sum(p.tmax)) ...
+        ', policy evaluation: ' num2str(sum(p.teval)) ...
+        ', convergence checks: ' num2str(sum(p.tcheck))])
+end
 if isfield(results,'change') && ~isempty(results.change)
   disp(['Maximum change in the value function on the last iteration: ' num2str(results.change)])
 end
@@ -147,10 +157,12 @@ switch messnum
   case 32, disp('model.vterm has improper size')
   case 33, disp('options.v has improper size')
   case 35, disp(['NaNs or infinities encountered in updating value function - iterations stopped after ' num2str(i{2}) ' iterations'])
+  case 36, disp('The batch option requires a numeric R and an infinite horizon model without stages')
   case 50, disp(['The following warnings were generated in stage ' num2str(i{2})])
   case 51, disp('Policy iteration not implemented with EV option')
   case 52, disp('EV option not allowed with policy iteration - changed to function iteration')
   case 53, disp(['Failure to converge in ' num2str(i{2}) ' iterations'])
+  case 54, disp('The checkpoint file does not match the model - the solve was started from the beginning')
   case 61, disp('R is improperly specified')
   case 62, disp('nx is improperly specified or cannot be determined')
   case 63, disp('ns is improperly specified or cannot be determined')
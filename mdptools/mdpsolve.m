@@ -13,8 +13,11 @@
 %               algorithm   'p', 'f' or 'b'
 %               time        run time
 %               iter        number of iterations (for T=inf only)
+%               PEiter      number of iterative policy evaluation iterations
+%               MPIdepth    number of modified policy iterations at each iteration
 %               change      maximal change on the last iteration (for T=inf only)
 %               numnochange number of interations since the last change in policy
+%               profile     per iteration timing and counters (if options.profile=1)
 %               errors      cell array containing error information
 %               warnings    cell array containing warning information
 % Error and warning information is printed if options.print>=1
@@ -31,6 +34,7 @@
 % The possible fields of the model structure variable are:
 %   d or discount  : a scalar on (0,1]
 %   R or reward    : nx-vector of reward values
+%                      (nx x K matrix with options.batch=1)
 %   transfunc      : for deterministic problems 
 %                      an nxx1 vector of values on {1,...,ns} (not currently implemented)
 %   P or transprob : There are several ways to define the transition matrices
@@ -46,6 +50,8 @@
 %                      memory and speed efficiencies possible using this option)
 %   EV             : 0/1 indicating that P is a function that accepts ns-vector V 
 %                      and returns nx vector E[V+|X]
+%                      (a P too large for memory can be written to disk with
+%                      pfilewrite and used with P=@(v) pfilemult(filename,v))
 %   colstoch       : 0/1 indicating that P is column stochastic (rows are future
 %                      values). This is generally not needed unless the Iexpand
 %                      feature is used because the number of states is less than
@@ -63,14 +69,31 @@
 %                 1 display summary report
 %                 2 display information at each iteration and summary report
 %   checks      : 0/1 checks perfoms checks on input data
+%   batch       : 0/1 solve K problems that differ only in R and d at once
+%                   (infinite horizon non-stage models only). R is nx x K
+%                   and d may be 1 x K. P is read once per iteration for
+%                   all of the problems. v and Ixopt are returned as ns x K
+%                   matrices and iter, change and numnochange as 1 x K 
+%                   vectors (default: 0)
 %       FOR FINITE HORIZON PROBLEMS
 %   keepall     : keep values and actions for every iteration
+%   keepfile    : with keepall=1 (non-stage models) write the values and 
+%                   actions of each period to this file rather than keeping
+%                   them in memory; results.v and results.Ixopt then hold
+%                   period 1 only (use mdpkeepread to get the others)
+%   keepdelta   : 0/1 store only the actions that differ from the following
+%                   period in keepfile (default: 0)
 %       FOR INFINITE HORIZON PROBLEMS
 %   algorithm   : 'p' for policy iteration, 'f' for function iteration
 %                   for infinite horizon problems (default: 'policy')
 %   modpol      : non-negative integer equal to the maximum number of times to
 %                   run modified policy iterations (for algorithm='f' only)
 %                   default: 100
+%   adaptmpi    : 0/1 choose the number of modified policy iterations at 
+%                   each iteration from the observed contraction rate and
+%                   the relative cost of maximization and evaluation 
+%                   (modpol is then the maximum); the number used at each
+%                   iteration is returned in results.MPIdepth (default: 0)
 %   relval      : controls the use of the relative value algorithm
 %                  0: uses ordinary policy or function iteration
 %                  relval = k in {1,2,...,ns} uses the relative value algorithm 
@@ -83,6 +106,33 @@
 %   tol         : convergence tolerance
 %   nochangelim : stop if action does not change in nochangelim iterations
 %   v           : starting value vector
+%   pesolver    : policy evaluation solver for algorithm='p':
+%                   'auto' (default), 'direct', 'bicgstab' or 'gmres'
+%                   'auto' uses a direct solve when ns<=pedirectmax (10000)
+%                   or P is full and bicgstab otherwise
+%   precond     : preconditioner for iterative policy evaluation:
+%                   'ilu0' (default), 'jacobi' or 'none'
+%   petol       : relative residual tolerance used by iterative policy 
+%                   evaluation once the policy has settled (default: 1e-10)
+%   smwmax      : with direct policy evaluation, the factorization of the
+%                   system is reused (via the Sherman-Morrison-Woodbury 
+%                   formula) while at most smwmax states have changed 
+%                   actions since it was computed (default: 20, 0 to 
+%                   refactorize at every iteration)
+%   checkpoint  : name of a file to which the iteration state is saved
+%                   periodically so a long solve can be continued if it
+%                   is interrupted (default: '', no checkpoints)
+%   checkpointint : minimum number of seconds between checkpoints 
+%                   (default: 300)
+%   resume      : 0/1 continue from the state saved in the checkpoint file
+%                   (if the file exists) (default: 0)
+%   profile     : 0/1 record the time spent computing expectations, 
+%                   maximizing, evaluating policies and checking convergence,
+%                   the non-zeros used, estimated bytes allocated and the 
+%                   number of states whose action changed at each iteration
+%                   in results.profile (non-stage models) (default: 0)
+%   profilefile : name of a .csv or .json file to which the profile is 
+%                   written (implies profile=1) (default: '')
 %
 % Other options are available for specifying a model. See user documentation.
 
@@ -134,6 +184,8 @@ function results = mdpsolve(model,options)
                        % (for algorithm='f' only)
   v           = [];    % starting value vector (T<inf only)
   debug       = 0;
+  infopts     = struct();  % additional options passed to mdpsolve_Inf
+  batch       = 0;     % solve several problems that differ only in R and d
   % set default maximu number of iterations
 
   if nargin>=2 && ~isempty(options)
@@ -149,6 +201,32 @@ function results = mdpsolve(model,options)
     if isfield(options,'nochangelim'), nochangelim=options.nochangelim; end
     if isfield(options,'v'),           v=options.v;                     end
     if isfield(options,'debug'),       debug=options.debug;             end
+    if isfield(options,'batch'),       batch=options.batch;             end
+    infonames={'pesolver','precond','petol','pedirectmax','smwmax','adaptmpi', ...
+               'checkpoint','checkpointint','resume','keepfile','keepdelta', ...
+               'profile','profilefile'};
+    for i=1:length(infonames)
+      if isfield(options,infonames{i}), infopts.(infonames{i})=options.(infonames{i}); end
+    end
+  end
+  
+  % batch mode: check the model using the first problem
+  if batch
+    if isfield(model,'reward'), Rname='reward'; else Rname='R'; end
+    if isfield(model,'discount'), dname='discount'; else dname='d'; end
+    if ~isfield(model,Rname) || ~isnumeric(model.(Rname))
+      results.errors={36};
+      if print>0,  mdpreport(results); end
+      return
+    end
+    Rbatch=model.(Rname);
+    model.(Rname)=Rbatch(:,1);
+    dbatch=[];
+    if isfield(model,dname) && isnumeric(model.(dname)) && size(Rbatch,2)>1 ...
+        && size(model.(dname),1)==1 && size(model.(dname),2)==size(Rbatch,2)
+      dbatch=model.(dname);
+      model.(dname)=dbatch(1);
+    end
   end
   
  [errors,warnings,R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,T,nstage,nrep,Xindexed,expandP] ...
@@ -202,24 +280,30 @@ function results = mdpsolve(model,options)
   end
   
   % call appropriate solver
-  if nstage==1 
+  if batch && (nstage>1 || T<inf)
+    results.errors={36};
+  elseif nstage==1 
     [errors,warnings,R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexed,expandP] =  ...
         mdp_getparams(1,checks,R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexed,expandP,debug);
     if ~isempty(errors)>0
       results.errors=errors; results.warnings=[warn0 warnings];
     else
-      if T==inf  % infinite horizon, non-stage model
+      if batch   % infinite horizon, non-stage model, several R and d
+        if ~isempty(dbatch), d=dbatch; end
+        results = mdpsolve_Inf_batch(Rbatch,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexed,expandP, ...
+          v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,[],infopts);
+      elseif T==inf  % infinite horizon, non-stage model
         results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexed,expandP, ...
-          v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,[]);
+          v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,[],infopts);
       else       % finite horizon, non-stage model
         results = mdpsolve_Fin( ...
-           R, P, d, ns, nx, Ix, Iexpand, colstoch, EV, Xindexed, expandP, T, v, keepall, print);
+           R, P, d, ns, nx, Ix, Iexpand, colstoch, EV, Xindexed, expandP, T, v, keepall, print, infopts);
       end
     end
   else
     if T==inf  % infinite horizon, stage model
       results = mdpsolve_Inf_stage(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexed,expandP, ...
-         nstage,nrep,v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,checks);
+         nstage,nrep,v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,checks,infopts);
     else       % finite horizon, stage model
       results = mdpsolve_Fin_stage(nstage,nrep, ...
          R, P, d, ns, nx, Ix, Iexpand, colstoch, EV, Xindexed,expandP, T, v, keepall, print,checks,debug);
@@ -236,7 +320,7 @@ function results = mdpsolve(model,options)
   end
   % for non-staged models get optimal variable values
   results.Xopt=[];
-  if nstage==1 && isfield(model,'X')
+  if nstage==1 && isfield(model,'X') && ~batch
     try
       results.Xopt=getA(model.X,results.Ixopt);
     catch ME
@@ -251,7 +335,7 @@ function results = mdpsolve(model,options)
     results.algorithm='b';
   end
   fnames={'name','v', 'AR','Ixopt', 'Xopt', 'pstar','algorithm','time','iter','stage',...
-          'MPI','change','numnochange','errors','warnings'};
+          'MPI','MPIdepth','PEiter','change','numnochange','profile','errors','warnings'};
   for i=1:length(fnames)
     if ~isfield(results,fnames{i})
       results.(fnames{i})=[];
@@ -188,17 +188,24 @@ catch    %#ok<CTCH>      % otherwise process each action/y value in a loop
   disp('error encountered - switching to alternative algorithm')
   tau=reshape(tau,N,na,ny,ns-1);
   omega=reshape(omega,[N,na,ny]);
-  Pb=sparse([],[],[],N,N*na);
+  usesb=exist('sparsebuilder','file')==3;
+  if usesb, Pb=sparsebuilder('create',N,N*na);
+            c=onCleanup(@() sparsebuilder('clear',Pb));  % frees it on error
+  else      Pb=sparse([],[],[],N,N*na);
+  end
   col=1;
   for k=1:na
     Pk=sparse([],[],[],N,N);
     for l=1:ny
       Pk=Pk+mxv(simplexbas(squeeze(tau(:,k,l,:)),ns,p,1),omega(:,k,l));
     end
-    Pb=add2sparse(Pb,Pk,col,0.6,true);
+    if usesb, sparsebuilder('add',Pb,Pk,col);
+    else      Pb=add2sparse(Pb,Pk,col,0.6,true);
+    end
     clear Pk
     col=col+N;
   end
+  if usesb, Pb=sparsebuilder('finish',Pb); end
 end
 end
 
@@ -81,7 +81,8 @@ KY=getindex(ZO,1:length(indoz),length(indoz)+1:size(ZO,2));
 B=simplexgrid(nu,inc,1);
 nb=size(B,1);
 % compute the updated belief weights
-Pb=sparse(nb,nos*nb*nox);
+% the contributions of the signals are summed once after the loop
+Pb=cell(1,ny);
 for k=1:ny
   Bplus=tprodm(B,[2 -5;nb nu],P(KI(KY(:,k),:),KJ),[1 4 3 -5;nos nu nox nu],[nos*nb*nox,nu]);
   omega=sum(Bplus,2);
@@ -95,12 +96,13 @@ for k=1:ny
   temp=simplexbas(Bplus,nu,inc,1,0);
   temp=mxv(temp,omega,1);
   clear omega
-  Pb=Pb+temp;
+  Pb{k}=temp;
   clear temp
   if ny>1, fprintf('.'); end
 end
 if ny>1, fprintf('\n'); end
 clear Bplus omega
+Pb=sumsparse(Pb,nb,nos*nb*nox);
 Pb=reshape(Pb,nos*nb,nox*nb);
 Rb=B*R(KJ)'; 
 Rb=Rb(:);
@@ -112,6 +114,25 @@ end
 
 
 
+% sums a cell array of sparse matrices
+% uses the MEX file sparsesum if available; otherwise the non-zeros are
+% collected and a single call to sparse sums the duplicates
+function P=sumsparse(P,m,n)
+if exist('sparsesum','file')==3  % use mex file if it exists
+  P=sparsesum(P);
+  return
+end
+nz=cellfun(@nnz,P);
+I=zeros(sum(nz),1); J=I; V=I;
+k=0;
+for i=1:numel(P)
+  [I(k+1:k+nz(i)),J(k+1:k+nz(i)),V(k+1:k+nz(i))]=find(P{i});
+  P{i}=[];
+  k=k+nz(i);
+end
+P=sparse(I,J,V,m,n);
+
+
 % Returns an (no x nu) index matrix K where K(i,j) is the
 % row of X associated with the ith value of the observable
 % variables (in columns indo of X) and the jth value of 
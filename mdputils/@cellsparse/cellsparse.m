@@ -17,6 +17,8 @@
 %   disp
 %   indexed extraction (e.g. B(1:2,:), B(1,[1 4 6]), etc.)
 % disp and extraction may fail if B is large.
+% Products with full double matrices use the MEX file cellsparsemtimes
+% (if it has been compiled), which processes the columns in parallel.
 classdef cellsparse
    properties
      m
@@ -6,6 +6,10 @@ if isa(b,'cellsparse')
   if size(a,2)~=b.m
     error('Inner matrix dimensions must agree.')
   end
+  if usemex(a,b.data)
+    c=cellsparsemtimes(b.data,b.s,a,1);
+    return
+  end
   c=zeros(size(a,1),b.s(end));
   for j=1:b.n
     c(:,b.s(j)+1:b.s(j+1))=a*b.data{j};
@@ -14,8 +18,18 @@ else
   if size(b,1)~=a.s(end)
     error('Inner matrix dimensions must agree.')
   end
+  if usemex(b,a.data)
+    c=cellsparsemtimes(a.data,a.s,b,0);
+    return
+  end
   c=zeros(a.m,size(b,2));
   for j=1:a.n
     c=c+a.data{j}*b(a.s(j)+1:a.s(j+1),:);
-  end    
-end
\ No newline at end of file
+  end
+end
+
+% the MEX file handles full double matrices times real double blocks
+function use=usemex(b,data)
+use=exist('cellsparsemtimes','file')==3 && ~isempty(data) && ...
+    isa(b,'double') && ~issparse(b) && isreal(b) && ismatrix(b) && ...
+    all(cellfun(@(x) isa(x,'double') && isreal(x),data));
@@ -0,0 +1,7 @@
+function disp(G)
+switch G.type
+case 'rect'
+  fprintf('  %d x %d implicit rectangular grid with %d blocks of values\n',G.m,G.n,length(G.blocks))
+case 'simplex'
+  fprintf('  %d x %d implicit simplex grid (q=%d, p=%d, C=%g)\n',G.m,G.n,G.q,G.p,G.C)
+end
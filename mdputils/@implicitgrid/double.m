@@ -0,0 +1,11 @@
+% double Creates the full grid from an implicitgrid object
+% USAGE
+%   X=double(G);
+% X is the matrix that rectgrid or simplexgrid would create
+function X=double(G)
+switch G.type
+case 'rect'
+  X=double(rectgrid(G.blocks{:}));
+case 'simplex'
+  X=simplexgrid(G.q,G.p,G.C,G.getall);
+end
@@ -0,0 +1,8 @@
+function e=end(G,k,n)
+if n==1
+  e=G.m*G.n;
+elseif k==1
+  e=G.m;
+else
+  e=G.n;
+end
@@ -0,0 +1,91 @@
+% implicitgrid creates a class for rectangular and simplex grids that are never formed
+% The grids created by rectgrid and simplexgrid have one row for each point
+% and for large state spaces the matrix can be too large to hold in memory.
+% An implicitgrid object holds only the information that defines the grid;
+% rows and columns are computed when they are requested.
+% To create an implicitgrid object use
+%   G=implicitgrid('rect',x1,x2,...);            % same as rectgrid(x1,x2,...)
+%   G=implicitgrid('simplex',q,p,C,getall);      % same as simplexgrid(q,p,C,getall)
+% The inputs of the rect form can be matrices or cell arrays as with rectgrid.
+%
+% Currently the methods that can be used with implicitgrid objects are
+%   size, end
+%   disp
+%   indexed extraction (e.g. G(1:2,:), G(:,3), G(ind,[1 3]))
+%   ind=rank(G,X)       index numbers of the rows of X (the inverse of G(ind,:))
+%   X=unrank(G,ind,cols) the same as G(ind,cols)
+%   double(G)            the full grid (the same as rectgrid or simplexgrid)
+%   [Ix,S]=subindex(G,cols) indices of the rows of G(:,cols) (see getI)
+% rank and unrank use gridrank and gridunrank; the work is O(d) for each
+% point so millions of points can be processed at once. rectindex,
+% simplexindex and getI accept implicitgrid objects in place of the grid.
+%
+% rank finds the closest grid point to each row; for the rect form a
+% column of values that is not sorted, or a matrix input to rectgrid, is
+% matched with match.
+classdef implicitgrid
+   properties
+     type       % 'rect' or 'simplex'
+     m          % number of rows
+     n          % number of columns
+     blocks     % rect: cell array of value matrices (one for each input)
+     nb         % rect: number of rows of each block
+     colblock   % rect: block containing each column
+     colsub     % rect: column of the block
+     q          % simplex: dimension
+     p          % simplex: number of subintervals
+     C          % simplex: grid points sum to C
+     getall     % simplex: 1 if the last column is included
+   end
+   methods
+     function G=implicitgrid(type,varargin)
+       if nargin<1, error('The grid type must be specified'); end
+       switch type
+       case 'rect'
+         G.type='rect';
+         G.blocks=getblocks(varargin);
+         G.nb=cellfun(@(x) size(x,1),G.blocks);
+         if any(G.nb==0), G.m=0; else G.m=prod(G.nb); end
+         nc=cellfun(@(x) size(x,2),G.blocks);
+         G.n=sum(nc);
+         G.colblock=zeros(1,G.n);
+         G.colsub=zeros(1,G.n);
+         k=0;
+         for i=1:length(nc)
+           G.colblock(k+1:k+nc(i))=i;
+           G.colsub(k+1:k+nc(i))=1:nc(i);
+           k=k+nc(i);
+         end
+       case 'simplex'
+         if length(varargin)<2, error('q and p must be specified'); end
+         G.type='simplex';
+         G.q=varargin{1};
+         G.p=varargin{2};
+         if length(varargin)<3 || isempty(varargin{3}), G.C=G.p;    else G.C=varargin{3};      end
+         if length(varargin)<4 || isempty(varargin{4}), G.getall=1; else G.getall=varargin{4}~=0; end
+         if G.q<2 || G.p<0 || G.q~=fix(G.q) || G.p~=fix(G.p)
+           error('q must be an integer greater than 1 and p a non-negative integer')
+         end
+         G.m=prod((G.p+1:G.p+G.q-1)./(1:G.q-1));
+         G.m=round(G.m);
+         G.n=G.q-1+G.getall;
+       otherwise
+         error('type must be ''rect'' or ''simplex''')
+       end
+     end
+   end
+end
+
+% flattens the (possibly nested) cell array of inputs to rectgrid
+function blocks=getblocks(x)
+blocks={};
+for i=1:numel(x)
+  if iscell(x{i})
+    blocks=[blocks getblocks(x{i})]; %#ok<AGROW>
+  elseif isnumeric(x{i}) || islogical(x{i})
+    if ~isempty(x{i}), blocks{end+1}=x{i}; end %#ok<AGROW>
+  else
+    error('Input of inproper type')
+  end
+end
+end
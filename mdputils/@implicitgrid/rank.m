@@ -0,0 +1,45 @@
+% rank Row numbers of points in an implicitgrid object
+% USAGE
+%   ind=rank(G,X);
+% INPUTS
+%   G   : an implicitgrid object
+%   X   : m x size(G,2) matrix of grid points (for simplex grids with
+%           getall=1 the last column can be omitted)
+% OUTPUT
+%   ind : m-vector of row numbers with G(ind,:) equal to X
+%
+% For rect grids each value is replaced by the closest grid value. For
+% simplex grids the values are rounded to the grid. Rows of X that are
+% not on a simplex grid have NaN indices.
+function ind=rank(G,X)
+m=size(X,1);
+switch G.type
+case 'rect'
+  if size(X,2)~=G.n, error('X must have one column for each column of G'); end
+  nblock=length(G.blocks);
+  D=zeros(m,nblock);
+  for j=1:nblock
+    cols=find(G.colblock==j);
+    s=G.blocks{j};
+    if size(s,2)==1 && issorted(s)
+      if size(s,1)==1
+        D(:,j)=1;
+      else
+        x=double(X(:,cols));
+        s=double(s);
+        D(:,j)=lookup(s,x,3);
+        D(:,j)=D(:,j) + (x-s(D(:,j)) > s(D(:,j)+1)-x);
+      end
+    else
+      D(:,j)=match(double(X(:,cols)),double(s));
+    end
+  end
+  ind=gridrank(D,G.nb);
+case 'simplex'
+  if size(X,2)<G.q-1 || size(X,2)>G.q
+    error('X must have q-1 or q columns')
+  end
+  V=double(X(:,1:G.q-1));
+  if G.C~=G.p, V=V*(double(G.p)/double(G.C)); end
+  ind=gridrank(round(V),G.q,G.p);
+end
@@ -0,0 +1,12 @@
+function varargout=size(G,dim)
+sz=[G.m G.n];
+if nargin>1
+  if dim<=2, varargout{1}=sz(dim);
+  else       varargout{1}=1;
+  end
+elseif nargout<=1
+  varargout{1}=sz;
+else
+  % [m,n,...]=size(G); extra outputs are 1
+  varargout=num2cell([sz ones(1,nargout-2)]);
+end
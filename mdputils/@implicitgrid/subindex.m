@@ -0,0 +1,44 @@
+% subindex Indices of the rows of a subset of the columns of an implicitgrid
+% USAGE
+%   [Ix,S]=subindex(G,cols);
+% INPUTS
+%   G    : an implicitgrid object
+%   cols : vector of column numbers
+% OUTPUTS
+%   Ix   : size(G,1) vector with S(Ix,:) equal to G(:,cols)
+%   S    : implicitgrid object for the distinct rows of G(:,cols)
+%
+% For rect grids in which cols includes every column of the blocks it
+% uses (e.g., the state variables of a grid of states and actions) Ix is
+% computed from the row numbers without forming G(:,cols) and S is an
+% implicitgrid. Otherwise G(:,cols) is formed, Ix and S are obtained with
+% getI and S is a matrix.
+function [Ix,S]=subindex(G,cols)
+cols=cols(:)';
+if strcmp(G.type,'rect')
+  b=unique(G.colblock(cols));
+  whole=true;
+  for j=b
+    if ~isequal(sort(G.colsub(cols(G.colblock(cols)==j))),1:size(G.blocks{j},2))
+      whole=false;
+    end
+  end
+  % the columns must also be in the order they appear in G
+  if whole && isequal(cols,sortcols(G,cols))
+    Ix=zeros(G.m,1);
+    blocksize=1048576;
+    for i0=1:blocksize:G.m
+      ii=(i0:min(G.m,i0+blocksize-1))';
+      D=gridunrank(ii,G.nb);
+      Ix(ii)=gridrank(D(:,b),G.nb(b));
+    end
+    S=implicitgrid('rect',G.blocks{b});
+    return
+  end
+end
+[Ix,S]=getI(subsref(G,struct('type','()','subs',{{':',cols}})),1:length(cols));
+
+% columns in the order they appear in the grid
+function cols=sortcols(G,cols)
+[~,k]=sortrows([G.colblock(cols)' G.colsub(cols)']);
+cols=cols(k);
@@ -0,0 +1,36 @@
+function varargout = subsref(G,S)
+switch S(1).type
+  case '()'
+    if numel(S(1).subs)==2
+      indr=S(1).subs{1};
+      indc=S(1).subs{2};
+      if ischar(indr) && strcmp(indr,':'), indr=1:G.m; end
+      if ischar(indc) && strcmp(indc,':'), indc=1:G.n; end
+      if islogical(indr), indr=find(indr); end
+      if islogical(indc), indc=find(indc); end
+      if strcmp(G.type,'rect') && length(indr)==G.m && isequal(indr(:)',1:G.m)
+        B=getcolumns(G,indc);
+      else
+        B=unrank(G,indr,indc);
+      end
+    else
+      error('Single indexing of implicitgrid objects is not supported')
+    end
+    if length(S)>1, B=subsref(B,S(2:end)); end
+    varargout{1}=B;
+  case '.'
+    error('??? Attempt to reference field of non-structure array.')
+  otherwise
+    error('{} indexing of implicitgrid objects is not supported')
+end
+
+% complete columns of a rect grid (no row numbers are needed)
+function B=getcolumns(G,cols)
+B=zeros(G.m,length(cols),class(G.blocks{end}));
+for jj=1:length(cols)
+  j=G.colblock(cols(jj));
+  k0=prod(G.nb(1:j-1));
+  k1=prod(G.nb(j+1:end));
+  ii=repmat(uint32(1:G.nb(j)),k1,k0);
+  B(:,jj)=G.blocks{j}(ii,G.colsub(cols(jj)));
+end
@@ -0,0 +1,52 @@
+% unrank Rows of an implicitgrid object
+% USAGE
+%   X=unrank(G,ind,cols);
+% INPUTS
+%   G    : an implicitgrid object
+%   ind  : vector of row numbers
+%   cols : vector of column numbers [default: all columns]
+% OUTPUT
+%   X    : length(ind) x length(cols) matrix equal to G(ind,cols)
+%
+% Rows are computed in blocks so the memory used is proportional to the
+% size of X.
+function X=unrank(G,ind,cols)
+if nargin<3 || isempty(cols) || (ischar(cols) && strcmp(cols,':')), cols=1:G.n; end
+if any(cols<1 | cols>G.n | cols~=fix(cols))
+  error('Column index exceeds grid dimensions')
+end
+ind=double(ind(:));
+if any(ind<1 | ind>G.m | ind~=fix(ind))
+  error('Row index exceeds grid dimensions')
+end
+k=length(ind);
+switch G.type
+case 'rect'
+  X=zeros(k,length(cols),classname(G));
+  b=unique(G.colblock(cols));
+  for i0=1:blocksize:k
+    ii=i0:min(k,i0+blocksize-1);
+    D=gridunrank(ind(ii),G.nb);
+    for j=b
+      jj=find(G.colblock(cols)==j);
+      X(ii,jj)=G.blocks{j}(D(:,j),G.colsub(cols(jj)));
+    end
+  end
+case 'simplex'
+  X=zeros(k,length(cols));
+  for i0=1:blocksize:k
+    ii=i0:min(k,i0+blocksize-1);
+    V=gridunrank(ind(ii),G.q,G.p);
+    if G.getall, V=[V G.p-sum(V,2)]; end %#ok<AGROW>
+    X(ii,:)=V(:,cols);
+  end
+  if G.C~=G.p, X=X*(double(G.C)/double(G.p)); end
+end
+
+% number of rows computed at once
+function b=blocksize
+b=1048576;
+
+% class of the rect grid values
+function c=classname(G)
+c=class(G.blocks{end});
@@ -1,4 +1,4 @@
-% FUNCTION kdtree = kdtree_create(points)
+% FUNCTION kdtree = kdtree_create(points,bucketsize)
 %
 % AUTHOR:     Steven Michael
 %             (smichael@ll.mit.edu)
@@ -16,11 +16,18 @@
 %
 %   points   :     A (npoints X ndim) array of points, where "npoints"
 %                  is the number of points and "ndim" is the number
-%                  of dimensions.  Note that the points, even if they
-%                  are double precision, will be converted to single
-%                  precision when the tree is populated.  This is for 
-%                  speed -- most kdtree search applications don't
-%                  necessitate double precision data.
+%                  of dimensions.  The tree keeps the precision of
+%                  the points: single precision points give a single
+%                  precision tree (half the memory), all other numeric
+%                  types are stored in double precision.
+%
+%   bucketsize :   (optional) The maximum number of points held in
+%                  each leaf of the tree (default 8, at most 64).
+%                  The points in a leaf are searched together, so
+%                  larger buckets give shallower trees.
+%
+%  Trees saved by versions of this function prior to 10/18/26 use
+%  a different internal layout and must be recreated.
 %
 % OUTPUTS:
 %
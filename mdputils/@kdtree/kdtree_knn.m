@@ -0,0 +1,46 @@
+% FUNCTION [idx,dist] = kdtree_knn(kdtree, pin, k, nthreads)
+%
+% DESCRIPTION:
+%
+%  For a previously created kdtree (see kdtree_create), this function
+%  returns the k points in the tree nearest to each point in "pin"
+%  along with their Euclidean distances. The searches for the different
+%  points in "pin" are spread across multiple threads.
+%
+% INPUTS:
+%
+%   kdtree   :  A KD Tree previously created with kdtree_create
+%
+%   pin      :  An array (Nxndim) of points.  Note that "ndim" must 
+%               be equal to the dimension of the array that the
+%               "kdtree" was created with.
+%
+%   k        :  The number of neighbors to return for each point
+%
+%   nthreads :  Optional number of threads to use (default: all
+%               available processors)
+%
+% OUTPUTS:
+%
+%   idx    :    An (N x k) array of indices to the original point array.
+%               Row i contains the indices of the k points closest to
+%               pin(i,:) in order of increasing distance. If the tree
+%               contains fewer than k points the extra columns are 0.
+%
+%   dist   :    An (N x k) array of the Euclidean distances between
+%               pin(i,:) and the points in row i of idx (inf for unused
+%               columns).
+%
+% Example: 
+% 
+%    % Create a list of 1000 random points in 3d space
+%    r = rand(1000,3);
+% 
+%    % Create a tree from this list
+%    tree = kdtree(r);
+% 
+%    % Find the 4 nearest points to each of 100 random points and 
+%    % form inverse distance interpolation weights
+%    [idx,dist] = kdtree_knn(tree,rand(100,3),4);
+%    w = 1./max(dist,eps);
+%    w = w./repmat(sum(w,2),1,4);
@@ -37,6 +37,9 @@
 % expansion factor is 0.6).
 
 % Uses: MEX file add2sparcec if available
+%
+% See also: sparsebuilder, which builds the matrix in memory that grows as
+%   needed and does not require the space to be estimated.
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
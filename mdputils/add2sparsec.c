@@ -7,8 +7,8 @@
   It must be the case that cols(M)+startcol<=cols(A)
   
   it must also be true that there is enough memory allocated to A to hold the elements of M
-  currently no checks are made so use of this function could cause Matlab to crash
-  use add2sparse instead.
+  (an error occurs if there is not)
+  A is changed in place so use add2sparse instead (or sparsebuilder).
 */
 
 extern mxArray *mxCreateSharedDataCopy(const mxArray *pr);
@@ -79,6 +79,13 @@ void mexFunction(
     }
   }
   else {
+    k=0;
+    for (i=0;i<mA*nM;i++) if (M[i]!=0) k++;
+    if (k+jA>mxGetNzmax(prhs[0])){
+      mexPrintf("nnz(M)+nnz(A): %llu  nzmax(A): %llu\n",
+        (unsigned long long)(k+jA),(unsigned long long)mxGetNzmax(plhs[0]));
+      mexErrMsgTxt("Not enough memory allocated to A to hold M");
+    }
     k=0;
     for (j=1;j<=nM;j++){
       for (i=0;i<mA;i++,k++){
@@ -0,0 +1,499 @@
+/*
+% mdpbench Stand-alone benchmark for the MDPSolve MEX kernels
+% USAGE
+%   mdpbench [-t seconds] [-s scales] [kernel ...]
+% OPTIONS
+%   -t seconds : minimum time spent timing each case [default: 0.5]
+%   -s scales  : any combination of the letters s, m and l for the small,
+%                  medium and large problem sizes [default: sml]
+%   kernel     : names of the kernels to run [default: all]
+%
+% Each kernel is linked into this program through the MEX shim in
+% mxshim.c (see the Makefile) and called through its mexFunction with
+% synthetic inputs of the kind the kernel sees in MDPSolve. For each case
+% the best time per call is reported together with
+%   rate : work units per second (the unit is given for each kernel)
+%   GB/s : bytes of input and output arrays divided by the time
+% GB/s is a lower bound on the memory traffic and is comparable to the
+% machine's memory bandwidth for the memory bound kernels.
+%
+% The inputs are generated from a fixed seed so results are comparable
+% between runs and between versions of a kernel.
+*/
+#include "mex.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+typedef void (*mexfunction)(int, mxArray *[], int, const mxArray *[]);
+
+/* the kernels are compiled with mexFunction renamed to mex_<name> */
+void mex_indexmax(int, mxArray *[], int, const mxArray *[]);
+void mex_kron(int, mxArray *[], int, const mxArray *[]);
+void mex_kroncol(int, mxArray *[], int, const mxArray *[]);
+void mex_kronrow(int, mxArray *[], int, const mxArray *[]);
+void mex_getbas1(int, mxArray *[], int, const mxArray *[]);
+void mex_simplexbasc(int, mxArray *[], int, const mxArray *[]);
+void mex_getpzc(int, mxArray *[], int, const mxArray *[]);
+void mex_dompurge(int, mxArray *[], int, const mxArray *[]);
+void mex_fs2f(int, mxArray *[], int, const mxArray *[]);
+void mex_sppermutec(int, mxArray *[], int, const mxArray *[]);
+
+#define MAXARGS 8
+
+/* one benchmark case */
+struct benchcase {
+  int nrhs, nlhs;
+  mxArray *prhs[MAXARGS];
+  char desc[64];     /* problem size */
+  double work;       /* work units per call */
+  const char *unit;  /* name of the work unit */
+};
+
+struct kernel {
+  const char *name;
+  mexfunction f;
+  void (*setup)(int scale, struct benchcase *c);
+};
+
+/***************************************************************/
+/* utilities */
+
+static double now(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER t, f;
+  QueryPerformanceCounter(&t);
+  QueryPerformanceFrequency(&f);
+  return((double)t.QuadPart/(double)f.QuadPart);
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return(t.tv_sec+1e-9*t.tv_nsec);
+#endif
+}
+
+/* xorshift generator so inputs do not depend on the C library */
+static unsigned long long rngstate=88172645463325252ULL;
+
+static unsigned long long rnd(void)
+{
+  rngstate^=rngstate<<13;
+  rngstate^=rngstate>>7;
+  rngstate^=rngstate<<17;
+  return(rngstate);
+}
+
+static double urand(void)
+{
+  return((rnd()>>11)*(1.0/9007199254740992.0));
+}
+
+static mwIndex irand(mwSize n)
+{
+  return((mwIndex)(rnd()%n));
+}
+
+static mxArray *randmatrix(mwSize m, mwSize n)
+{
+  mxArray *a=mxCreateDoubleMatrix(m,n,mxREAL);
+  double *x=mxGetPr(a);
+  mwSize i;
+  for (i=0; i<m*n; i++) x[i]=urand();
+  return(a);
+}
+
+static mxArray *scalar(double v)
+{
+  mxArray *a=mxCreateDoubleMatrix(1,1,mxREAL);
+  *mxGetPr(a)=v;
+  return(a);
+}
+
+static mxArray *vector(mwSize n, const double *v)
+{
+  mxArray *a=mxCreateDoubleMatrix(1,n,mxREAL);
+  memcpy(mxGetPr(a),v,n*sizeof(double));
+  return(a);
+}
+
+/* m x n sparse matrix with k random non-zeros in each column */
+static mxArray *randsparse(mwSize m, mwSize n, mwSize k)
+{
+  mxArray *a;
+  mwIndex *ir, *jc, i, j, r, t;
+  double *pr;
+  if (k>m) k=m;
+  a=mxCreateSparse(m,n,n*k,mxREAL);
+  ir=mxGetIr(a); jc=mxGetJc(a); pr=mxGetPr(a);
+  for (j=0; j<n; j++){
+    mwIndex *c=ir+j*k;
+    jc[j]=j*k;
+    for (i=0; i<k; i++){
+      // distinct rows kept in increasing order
+      do{
+        r=irand(m);
+        for (t=0; t<i && c[t]!=r; t++);
+      } while (t<i);
+      for (t=i; t>0 && c[t-1]>r; t--) c[t]=c[t-1];
+      c[t]=r;
+      pr[j*k+i]=urand();
+    }
+  }
+  jc[n]=n*k;
+  return(a);
+}
+
+/* bytes held by an array (non-zeros only for sparse arrays) */
+static double arraybytes(const mxArray *a)
+{
+  double b;
+  mwSize i, n;
+  if (a==NULL) return(0);
+  if (mxIsCell(a)){
+    b=0;
+    n=mxGetNumberOfElements(a);
+    for (i=0; i<n; i++) b+=arraybytes(mxGetCell(a,i));
+    return(b);
+  }
+  if (mxIsSparse(a)){
+    n=mxGetN(a);
+    return((double)mxGetJc(a)[n]*(sizeof(double)+sizeof(mwIndex))
+           +(double)(n+1)*sizeof(mwIndex));
+  }
+  b=(double)mxGetNumberOfElements(a)*mxGetElementSize(a);
+  return(mxIsComplex(a) ? 2*b : b);
+}
+
+static const char *scalename[3]={"small","medium","large"};
+
+/***************************************************************/
+/* problem generators; scale is 0, 1 or 2 */
+
+// maximization over the actions available in each state (valmax)
+static void setup_indexmax(int scale, struct benchcase *c)
+{
+  static const mwSize nx[3]={10000,1000000,10000000};
+  mwSize n=nx[scale]/10, i;
+  double *ind;
+  c->prhs[0]=randmatrix(nx[scale],1);
+  c->prhs[1]=mxCreateDoubleMatrix(nx[scale],1,mxREAL);
+  ind=mxGetPr(c->prhs[1]);
+  for (i=0; i<nx[scale]; i++) ind[i]=(double)(i/10+1);
+  c->prhs[2]=scalar((double)n);
+  c->nrhs=3; c->nlhs=2;
+  sprintf(c->desc,"nx=%lu ns=%lu",(unsigned long)nx[scale],(unsigned long)n);
+  c->work=(double)nx[scale]; c->unit="elem";
+}
+
+// Kronecker product of two sparse transition matrices
+static void setup_kron(int scale, struct benchcase *c)
+{
+  static const mwSize n[3]={50,200,500};
+  static const mwSize k[3]={5,5,5};
+  c->prhs[0]=randsparse(n[scale],n[scale],k[scale]);
+  c->prhs[1]=randsparse(n[scale],n[scale],k[scale]);
+  c->nrhs=2; c->nlhs=1;
+  sprintf(c->desc,"%lux%lu sparse, %lu nz/col",(unsigned long)n[scale],
+    (unsigned long)n[scale],(unsigned long)k[scale]);
+  c->work=(double)n[scale]*n[scale]*k[scale]*k[scale]; c->unit="nz";
+}
+
+// column-wise Kronecker product of conditional transition matrices
+static void setup_kroncol(int scale, struct benchcase *c)
+{
+  static const mwSize n[3]={10000,100000,1000000};
+  mwSize m=20, k=3;
+  c->prhs[0]=randsparse(m,n[scale],k);
+  c->prhs[1]=randsparse(m,n[scale],k);
+  c->nrhs=2; c->nlhs=1;
+  sprintf(c->desc,"2 x %lux%lu sparse, %lu nz/col",(unsigned long)m,
+    (unsigned long)n[scale],(unsigned long)k);
+  c->work=(double)n[scale]*k*k; c->unit="nz";
+}
+
+// row-wise tensor product of full matrices
+static void setup_kronrow(int scale, struct benchcase *c)
+{
+  static const mwSize m[3]={1000,10000,50000};
+  mwSize n=10;
+  c->prhs[0]=randmatrix(m[scale],n);
+  c->prhs[1]=randmatrix(m[scale],n);
+  c->nrhs=2; c->nlhs=1;
+  sprintf(c->desc,"2 x %lux%lu full",(unsigned long)m[scale],(unsigned long)n);
+  c->work=(double)m[scale]*n*n; c->unit="elem";
+}
+
+// linear interpolation basis on an unevenly spaced grid
+static void setup_getbas1(int scale, struct benchcase *c)
+{
+  static const mwSize n[3]={100,1000,10000};
+  static const mwSize N[3]={10000,100000,1000000};
+  mwSize i;
+  double *s, *x;
+  c->prhs[0]=mxCreateDoubleMatrix(n[scale],1,mxREAL);
+  s=mxGetPr(c->prhs[0]);
+  for (i=0; i<n[scale]; i++) s[i]=pow((double)i/(n[scale]-1),2);
+  c->prhs[1]=randmatrix(N[scale],1);
+  x=mxGetPr(c->prhs[1]);
+  for (i=0; i<N[scale]; i++) x[i]=x[i]*1.1-0.05;
+  c->prhs[2]=scalar(0);
+  c->nrhs=3; c->nlhs=1;
+  sprintf(c->desc,"n=%lu N=%lu",(unsigned long)n[scale],(unsigned long)N[scale]);
+  c->work=(double)N[scale]; c->unit="pts";
+}
+
+// interpolation basis on a simplex
+static void setup_simplexbasc(int scale, struct benchcase *c)
+{
+  static const mwSize p[3]={10,30,100};
+  static const mwSize N[3]={10000,100000,1000000};
+  mwSize q=3, i, j;
+  double *x, s;
+  c->prhs[0]=randmatrix(N[scale],q);
+  x=mxGetPr(c->prhs[0]);
+  for (i=0; i<N[scale]; i++){
+    s=0;
+    for (j=0; j<q; j++) s+=x[i+j*N[scale]];
+    for (j=0; j<q; j++) x[i+j*N[scale]]*=p[scale]/s;
+  }
+  c->prhs[1]=scalar((double)q);
+  c->prhs[2]=scalar((double)p[scale]);
+  c->nrhs=3; c->nlhs=1;
+  sprintf(c->desc,"q=%lu p=%lu N=%lu",(unsigned long)q,(unsigned long)p[scale],
+    (unsigned long)N[scale]);
+  c->work=(double)N[scale]; c->unit="pts";
+}
+
+// one column of a categorical count transition matrix (see catcountP)
+static void setup_getpzc(int scale, struct benchcase *c)
+{
+  static const mwSize cats[3]={3,4,5};
+  static const unsigned int pops[3]={20,30,30};
+  mwSize n=cats[scale], n1=n-1, ns, i, j, k;
+  unsigned int N=pops[scale], *S, *xn, *tab, *Xj, *nxind, s;
+  double *factor, *logp;
+  mxArray *xind;
+
+  // S: the n-1 x ns grid simplexgrid(n,N,N,0,'uint32')'
+  ns=1;
+  for (i=1; i<n; i++) ns=ns*(N+i)/i;
+  c->prhs[0]=mxCreateNumericMatrix(n1,ns,mxUINT32_CLASS,mxREAL);
+  S=mxGetData(c->prhs[0]);
+  xn=mxCalloc(n,sizeof(unsigned int));
+  xn[n-1]=N;
+  for (j=0; j<ns; j++){
+    memcpy(S+j*n1,xn,n1*sizeof(unsigned int));
+    if (j+1==ns) break;
+    if (xn[n-1]>0){
+      xn[n-2]++; xn[n-1]--;
+    }
+    else{
+      k=n-2;
+      while (xn[k]==0) k--;
+      xn[k-1]++; xn[n-1]=xn[k]-1; xn[k]=0;
+    }
+  }
+  mxFree(xn);
+  // columns of S that sum to i or less
+  c->prhs[1]=xind=mxCreateCellMatrix(N+1,1);
+  c->prhs[2]=mxCreateNumericMatrix(N+1,1,mxUINT32_CLASS,mxREAL);
+  nxind=mxGetData(c->prhs[2]);
+  for (i=0; i<=N; i++){
+    mxArray *ind=mxCreateNumericMatrix(1,ns,mxUINT32_CLASS,mxREAL);
+    unsigned int *p=mxGetData(ind);
+    nxind[i]=0;
+    for (j=0; j<ns; j++){
+      for (s=0, k=0; k<n1; k++) s+=S[j*n1+k];
+      if (s<=i) p[nxind[i]++]=(unsigned int)j;
+    }
+    mxSetCell(xind,i,ind);
+  }
+  // table of multiset coefficients
+  c->prhs[3]=mxCreateNumericMatrix(N+2,n,mxUINT32_CLASS,mxREAL);
+  tab=mxGetData(c->prhs[3]);
+  for (i=0; i<N+2; i++) tab[i]=(unsigned int)i;
+  for (j=1; j<n; j++)
+    for (s=0, i=0; i<N+2; i++){ s+=tab[i+(j-1)*(N+2)]; tab[i+j*(N+2)]=s; }
+  c->prhs[4]=mxCreateDoubleMatrix(N+1,1,mxREAL);
+  factor=mxGetPr(c->prhs[4]);
+  factor[0]=0;
+  for (i=1; i<=N; i++) factor[i]=factor[i-1]+log((double)i);
+  // log of a column stochastic n x n matrix
+  c->prhs[5]=randmatrix(n,n);
+  logp=mxGetPr(c->prhs[5]);
+  for (j=0; j<n; j++){
+    double t=0;
+    for (i=0; i<n; i++) t+=logp[i+j*n];
+    for (i=0; i<n; i++) logp[i+j*n]=log(logp[i+j*n]/t);
+  }
+  // the counts in each category are as equal as possible
+  c->prhs[6]=mxCreateNumericMatrix(n,1,mxUINT32_CLASS,mxREAL);
+  Xj=mxGetData(c->prhs[6]);
+  for (i=0; i<n; i++) Xj[i]=(unsigned int)((N*(i+1))/n-(N*i)/n);
+  c->nrhs=7; c->nlhs=1;
+  sprintf(c->desc,"n=%lu N=%u ns=%lu",(unsigned long)n,N,(unsigned long)ns);
+  c->work=(double)ns; c->unit="states";
+}
+
+// purge dominated alpha vectors (POMDPs)
+static void setup_dompurge(int scale, struct benchcase *c)
+{
+  static const mwSize n[3]={10,20,20};
+  static const mwSize m[3]={100,300,1000};
+  c->prhs[0]=randmatrix(n[scale],m[scale]);
+  c->nrhs=1; c->nlhs=1;
+  sprintf(c->desc,"n=%lu m=%lu",(unsigned long)n[scale],(unsigned long)m[scale]);
+  c->work=0.5*m[scale]*(m[scale]-1); c->unit="pairs";
+}
+
+// full times sparse tensor product: V'*P with V ns x k and P ns x nx
+static void setup_fs2f(int scale, struct benchcase *c)
+{
+  static const mwSize n[3]={1000,10000,100000};
+  mwSize k=10, nz=5;
+  double x2z[4], y2z[4];
+  c->prhs[0]=randmatrix(k,n[scale]);
+  x2z[0]=1;  x2z[1]=(double)k; x2z[2]=-3; x2z[3]=(double)n[scale];
+  c->prhs[1]=mxCreateDoubleMatrix(2,2,mxREAL);
+  memcpy(mxGetPr(c->prhs[1]),x2z,4*sizeof(double));
+  c->prhs[2]=randsparse(n[scale],n[scale],nz);
+  y2z[0]=-3; y2z[1]=(double)n[scale]; y2z[2]=2; y2z[3]=(double)n[scale];
+  c->prhs[3]=mxCreateDoubleMatrix(2,2,mxREAL);
+  memcpy(mxGetPr(c->prhs[3]),y2z,4*sizeof(double));
+  c->nrhs=4; c->nlhs=1;
+  sprintf(c->desc,"%lux%lu full * %lux%lu sparse",(unsigned long)k,
+    (unsigned long)n[scale],(unsigned long)n[scale],(unsigned long)n[scale]);
+  c->work=(double)k*n[scale]*nz; c->unit="flop";
+}
+
+// permutation of the dimensions of a sparse 3-D array
+static void setup_sppermutec(int scale, struct benchcase *c)
+{
+  static const mwSize a[3]={20,50,100};
+  static const mwSize n[3]={1000,10000,100000};
+  mwSize nz=10;
+  double order[3], nx[3], nout[2];
+  c->prhs[0]=randsparse(a[scale]*a[scale],n[scale],nz);
+  order[0]=2; order[1]=1; order[2]=3;
+  nx[0]=(double)a[scale]; nx[1]=(double)a[scale]; nx[2]=(double)n[scale];
+  nout[0]=(double)(a[scale]*a[scale]); nout[1]=(double)n[scale];
+  c->prhs[1]=vector(3,order);
+  c->prhs[2]=vector(3,nx);
+  c->prhs[3]=vector(2,nout);
+  c->nrhs=4; c->nlhs=1;
+  sprintf(c->desc,"%lux%lux%lu, %lu nz/col",(unsigned long)a[scale],
+    (unsigned long)a[scale],(unsigned long)n[scale],(unsigned long)nz);
+  c->work=(double)n[scale]*nz; c->unit="nz";
+}
+
+static const struct kernel kernels[]={
+  {"indexmax",    mex_indexmax,    setup_indexmax},
+  {"kron",        mex_kron,        setup_kron},
+  {"kroncol",     mex_kroncol,     setup_kroncol},
+  {"kronrow",     mex_kronrow,     setup_kronrow},
+  {"getbas1",     mex_getbas1,     setup_getbas1},
+  {"simplexbasc", mex_simplexbasc, setup_simplexbasc},
+  {"getpzc",      mex_getpzc,      setup_getpzc},
+  {"dompurge",    mex_dompurge,    setup_dompurge},
+  {"fs2f",        mex_fs2f,        setup_fs2f},
+  {"sppermutec",  mex_sppermutec,  setup_sppermutec},
+};
+#define NKERNELS (sizeof(kernels)/sizeof(kernels[0]))
+
+/***************************************************************/
+
+/* times one case; returns the best time per call */
+static double runcase(const struct kernel *k, struct benchcase *c,
+                      double mintime, int *reps, double *bytes)
+{
+  mxArray *plhs[MAXARGS];
+  const mxArray *args[MAXARGS];
+  double t0, t, best, total;
+  int i;
+  for (i=0; i<c->nrhs; i++) args[i]=c->prhs[i];
+  // the first call is not timed; it gives the size of the outputs
+  memset(plhs,0,sizeof(plhs));
+  k->f(c->nlhs,plhs,c->nrhs,args);
+  *bytes=0;
+  for (i=0; i<c->nrhs; i++) *bytes+=arraybytes(c->prhs[i]);
+  for (i=0; i<c->nlhs; i++){
+    *bytes+=arraybytes(plhs[i]);
+    mxDestroyArray(plhs[i]);
+  }
+  best=HUGE_VAL;
+  total=0;
+  *reps=0;
+  while (*reps<3 || total<mintime){
+    memset(plhs,0,sizeof(plhs));
+    t0=now();
+    k->f(c->nlhs,plhs,c->nrhs,args);
+    t=now()-t0;
+    for (i=0; i<c->nlhs; i++) mxDestroyArray(plhs[i]);
+    if (t<best) best=t;
+    total+=t;
+    (*reps)++;
+  }
+  return(best);
+}
+
+static void usage(void)
+{
+  size_t i;
+  printf("usage: mdpbench [-t seconds] [-s sml] [kernel ...]\nkernels:");
+  for (i=0; i<NKERNELS; i++) printf(" %s",kernels[i].name);
+  printf("\n");
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  double mintime=0.5, t, bytes;
+  int scales[3]={1,1,1}, selected[NKERNELS], any=0, i, s, reps;
+  size_t j;
+  memset(selected,0,sizeof(selected));
+  for (i=1; i<argc; i++){
+    if (strcmp(argv[i],"-t")==0 && i+1<argc){
+      mintime=atof(argv[++i]);
+    }
+    else if (strcmp(argv[i],"-s")==0 && i+1<argc){
+      const char *p=argv[++i];
+      scales[0]=strchr(p,'s')!=NULL;
+      scales[1]=strchr(p,'m')!=NULL;
+      scales[2]=strchr(p,'l')!=NULL;
+    }
+    else if (argv[i][0]=='-') usage();
+    else{
+      for (j=0; j<NKERNELS && strcmp(argv[i],kernels[j].name); j++);
+      if (j==NKERNELS) usage();
+      selected[j]=1;
+      any=1;
+    }
+  }
+
+  printf("%-12s %-7s %-38s %6s %12s %14s %8s\n",
+    "kernel","scale","size","reps","time (ms)","rate","GB/s");
+  for (j=0; j<NKERNELS; j++){
+    if (any && !selected[j]) continue;
+    for (s=0; s<3; s++){
+      struct benchcase c;
+      char rate[32];
+      if (!scales[s]) continue;
+      memset(&c,0,sizeof(c));
+      rngstate=88172645463325252ULL;
+      kernels[j].setup(s,&c);
+      t=runcase(kernels+j,&c,mintime,&reps,&bytes);
+      sprintf(rate,"%.4g M%s/s",c.work/t*1e-6,c.unit);
+      printf("%-12s %-7s %-38s %6d %12.4f %14s %8.3f\n",kernels[j].name,
+        scalename[s],c.desc,reps,t*1e3,rate,bytes/t*1e-9);
+      fflush(stdout);
+      for (i=0; i<c.nrhs; i++) mxDestroyArray(c.prhs[i]);
+    }
+  }
+  return(0);
+}
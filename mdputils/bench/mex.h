@@ -0,0 +1,84 @@
+/*
+  Minimal replacement for MATLAB's mex.h used to build the MEX kernels
+  into the stand-alone benchmark program mdpbench. Only the parts of
+  the MEX API used by the benchmarked kernels are provided (see mxshim.c).
+  Arrays use the same memory layout as MATLAB: column major data,
+  0-based row indices and column pointers for sparse matrices.
+*/
+#ifndef MDPBENCH_MEX_H
+#define MDPBENCH_MEX_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef size_t    mwSize;
+typedef size_t    mwIndex;
+typedef ptrdiff_t mwSignedIndex;
+
+typedef enum {
+  mxUNKNOWN_CLASS=0, mxCELL_CLASS, mxSTRUCT_CLASS, mxLOGICAL_CLASS,
+  mxCHAR_CLASS, mxVOID_CLASS, mxDOUBLE_CLASS, mxSINGLE_CLASS,
+  mxINT8_CLASS, mxUINT8_CLASS, mxINT16_CLASS, mxUINT16_CLASS,
+  mxINT32_CLASS, mxUINT32_CLASS, mxINT64_CLASS, mxUINT64_CLASS
+} mxClassID;
+
+typedef enum { mxREAL=0, mxCOMPLEX } mxComplexity;
+
+typedef struct mxArray_tag mxArray;
+
+/* creation and destruction */
+mxArray *mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity c);
+mxArray *mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID cls, mxComplexity c);
+mxArray *mxCreateNumericArray(mwSize nd, const mwSize *dims, mxClassID cls, mxComplexity c);
+mxArray *mxCreateSparse(mwSize m, mwSize n, mwSize nzmax, mxComplexity c);
+mxArray *mxCreateCellMatrix(mwSize m, mwSize n);
+mxArray *mxDuplicateArray(const mxArray *a);
+void     mxDestroyArray(mxArray *a);
+
+/* access */
+double  *mxGetPr(const mxArray *a);
+double  *mxGetPi(const mxArray *a);
+void    *mxGetData(const mxArray *a);
+mwIndex *mxGetIr(const mxArray *a);
+mwIndex *mxGetJc(const mxArray *a);
+mwSize   mxGetNzmax(const mxArray *a);
+mwSize   mxGetM(const mxArray *a);
+mwSize   mxGetN(const mxArray *a);
+mwSize   mxGetNumberOfElements(const mxArray *a);
+mwSize   mxGetNumberOfDimensions(const mxArray *a);
+const mwSize *mxGetDimensions(const mxArray *a);
+size_t   mxGetElementSize(const mxArray *a);
+mxClassID mxGetClassID(const mxArray *a);
+mxArray *mxGetCell(const mxArray *a, mwIndex i);
+void     mxSetCell(mxArray *a, mwIndex i, mxArray *value);
+double   mxGetScalar(const mxArray *a);
+double   mxGetInf(void);
+
+/* queries */
+bool mxIsDouble(const mxArray *a);
+bool mxIsSparse(const mxArray *a);
+bool mxIsComplex(const mxArray *a);
+bool mxIsEmpty(const mxArray *a);
+bool mxIsCell(const mxArray *a);
+
+/* memory */
+void *mxMalloc(size_t n);
+void *mxCalloc(size_t n, size_t size);
+void *mxRealloc(void *p, size_t n);
+void  mxFree(void *p);
+
+/* messages */
+void mexErrMsgTxt(const char *msg);
+void mexWarnMsgTxt(const char *msg);
+int  mexPrintf(const char *fmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,240 @@
+/*
+  Implementation of the subset of the MEX API declared in mex.h.
+  mexErrMsgTxt prints the message and exits since the benchmark inputs
+  are always valid; an error indicates a problem with the benchmark.
+*/
+#include "mex.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+#define MAXDIMS 32
+
+struct mxArray_tag {
+  mxClassID cls;
+  bool      sparse;
+  bool      complex;
+  mwSize    ndim;
+  mwSize    dims[MAXDIMS];
+  void     *pr, *pi;
+  mwIndex  *ir, *jc;
+  mwSize    nzmax;
+  mxArray **cells;
+};
+
+static size_t classsize(mxClassID cls)
+{
+  switch (cls){
+  case mxDOUBLE_CLASS: case mxINT64_CLASS: case mxUINT64_CLASS: return(8);
+  case mxSINGLE_CLASS: case mxINT32_CLASS: case mxUINT32_CLASS: return(4);
+  case mxINT16_CLASS:  case mxUINT16_CLASS: case mxCHAR_CLASS:  return(2);
+  case mxCELL_CLASS:   case mxSTRUCT_CLASS: return(sizeof(mxArray *));
+  default: return(1);
+  }
+}
+
+static void *allocate(size_t n, size_t size)
+{
+  void *p=calloc(n>0 ? n : 1, size>0 ? size : 1);
+  if (p==NULL) mexErrMsgTxt("Out of memory");
+  return(p);
+}
+
+static mxArray *newarray(mwSize nd, const mwSize *dims, mxClassID cls)
+{
+  mxArray *a=allocate(1,sizeof(mxArray));
+  mwSize i;
+  if (nd>MAXDIMS) mexErrMsgTxt("Too many dimensions");
+  a->cls=cls;
+  a->ndim= nd<2 ? 2 : nd;
+  a->dims[0]=a->dims[1]=1;
+  for (i=0; i<nd; i++) a->dims[i]=dims[i];
+  return(a);
+}
+
+mxArray *mxCreateNumericArray(mwSize nd, const mwSize *dims, mxClassID cls, mxComplexity c)
+{
+  mxArray *a=newarray(nd,dims,cls);
+  mwSize n=mxGetNumberOfElements(a);
+  a->pr=allocate(n,classsize(cls));
+  if (c==mxCOMPLEX){
+    a->complex=true;
+    a->pi=allocate(n,classsize(cls));
+  }
+  return(a);
+}
+
+mxArray *mxCreateNumericMatrix(mwSize m, mwSize n, mxClassID cls, mxComplexity c)
+{
+  mwSize dims[2];
+  dims[0]=m; dims[1]=n;
+  return(mxCreateNumericArray(2,dims,cls,c));
+}
+
+mxArray *mxCreateDoubleMatrix(mwSize m, mwSize n, mxComplexity c)
+{
+  return(mxCreateNumericMatrix(m,n,mxDOUBLE_CLASS,c));
+}
+
+mxArray *mxCreateSparse(mwSize m, mwSize n, mwSize nzmax, mxComplexity c)
+{
+  mwSize dims[2];
+  mxArray *a;
+  dims[0]=m; dims[1]=n;
+  a=newarray(2,dims,mxDOUBLE_CLASS);
+  if (nzmax<1) nzmax=1;
+  a->sparse=true;
+  a->nzmax=nzmax;
+  a->pr=allocate(nzmax,sizeof(double));
+  if (c==mxCOMPLEX){
+    a->complex=true;
+    a->pi=allocate(nzmax,sizeof(double));
+  }
+  a->ir=allocate(nzmax,sizeof(mwIndex));
+  a->jc=allocate(n+1,sizeof(mwIndex));
+  return(a);
+}
+
+mxArray *mxCreateCellMatrix(mwSize m, mwSize n)
+{
+  mwSize dims[2];
+  mxArray *a;
+  dims[0]=m; dims[1]=n;
+  a=newarray(2,dims,mxCELL_CLASS);
+  a->cells=allocate(m*n,sizeof(mxArray *));
+  return(a);
+}
+
+mxArray *mxDuplicateArray(const mxArray *a)
+{
+  mxArray *b=allocate(1,sizeof(mxArray));
+  mwSize i, n=mxGetNumberOfElements(a);
+  size_t bytes;
+  *b=*a;
+  if (a->cls==mxCELL_CLASS){
+    b->cells=allocate(n,sizeof(mxArray *));
+    for (i=0; i<n; i++)
+      if (a->cells[i]!=NULL) b->cells[i]=mxDuplicateArray(a->cells[i]);
+    return(b);
+  }
+  if (a->sparse){
+    b->ir=allocate(a->nzmax,sizeof(mwIndex));
+    b->jc=allocate(a->dims[1]+1,sizeof(mwIndex));
+    memcpy(b->ir,a->ir,a->nzmax*sizeof(mwIndex));
+    memcpy(b->jc,a->jc,(a->dims[1]+1)*sizeof(mwIndex));
+    n=a->nzmax;
+  }
+  bytes=n*classsize(a->cls);
+  b->pr=allocate(n,classsize(a->cls));
+  memcpy(b->pr,a->pr,bytes);
+  if (a->complex){
+    b->pi=allocate(n,classsize(a->cls));
+    memcpy(b->pi,a->pi,bytes);
+  }
+  return(b);
+}
+
+void mxDestroyArray(mxArray *a)
+{
+  mwSize i, n;
+  if (a==NULL) return;
+  if (a->cls==mxCELL_CLASS){
+    n=mxGetNumberOfElements(a);
+    for (i=0; i<n; i++) mxDestroyArray(a->cells[i]);
+  }
+  free(a->pr);
+  free(a->pi);
+  free(a->ir);
+  free(a->jc);
+  free(a->cells);
+  free(a);
+}
+
+double  *mxGetPr(const mxArray *a)   { return((double *)a->pr); }
+double  *mxGetPi(const mxArray *a)   { return((double *)a->pi); }
+void    *mxGetData(const mxArray *a) { return(a->pr); }
+mwIndex *mxGetIr(const mxArray *a)   { return(a->ir); }
+mwIndex *mxGetJc(const mxArray *a)   { return(a->jc); }
+mwSize   mxGetNzmax(const mxArray *a){ return(a->nzmax); }
+mwSize   mxGetM(const mxArray *a)    { return(a->dims[0]); }
+
+mwSize mxGetN(const mxArray *a)
+{
+  mwSize i, n=1;
+  for (i=1; i<a->ndim; i++) n*=a->dims[i];
+  return(n);
+}
+
+mwSize mxGetNumberOfElements(const mxArray *a)
+{
+  return(a->dims[0]*mxGetN(a));
+}
+
+mwSize        mxGetNumberOfDimensions(const mxArray *a) { return(a->ndim); }
+const mwSize *mxGetDimensions(const mxArray *a)         { return(a->dims); }
+size_t        mxGetElementSize(const mxArray *a)        { return(classsize(a->cls)); }
+mxClassID     mxGetClassID(const mxArray *a)            { return(a->cls); }
+
+mxArray *mxGetCell(const mxArray *a, mwIndex i)            { return(a->cells[i]); }
+void     mxSetCell(mxArray *a, mwIndex i, mxArray *value)  { a->cells[i]=value; }
+
+double mxGetScalar(const mxArray *a)
+{
+  switch (a->cls){
+  case mxDOUBLE_CLASS: return(*(double *)a->pr);
+  case mxSINGLE_CLASS: return(*(float *)a->pr);
+  case mxUINT32_CLASS: return(*(unsigned int *)a->pr);
+  case mxINT32_CLASS:  return(*(int *)a->pr);
+  case mxUINT64_CLASS: return((double)*(unsigned long long *)a->pr);
+  case mxINT64_CLASS:  return((double)*(long long *)a->pr);
+  default:             return(*(unsigned char *)a->pr);
+  }
+}
+
+double mxGetInf(void) { return(HUGE_VAL); }
+
+bool mxIsDouble(const mxArray *a)  { return(a->cls==mxDOUBLE_CLASS); }
+bool mxIsSparse(const mxArray *a)  { return(a->sparse); }
+bool mxIsComplex(const mxArray *a) { return(a->complex); }
+bool mxIsEmpty(const mxArray *a)   { return(mxGetNumberOfElements(a)==0); }
+bool mxIsCell(const mxArray *a)    { return(a->cls==mxCELL_CLASS); }
+
+void *mxMalloc(size_t n)
+{
+  void *p=malloc(n>0 ? n : 1);
+  if (p==NULL) mexErrMsgTxt("Out of memory");
+  return(p);
+}
+
+void *mxCalloc(size_t n, size_t size) { return(allocate(n,size)); }
+
+void *mxRealloc(void *p, size_t n)
+{
+  p=realloc(p,n>0 ? n : 1);
+  if (p==NULL) mexErrMsgTxt("Out of memory");
+  return(p);
+}
+
+void mxFree(void *p) { free(p); }
+
+void mexErrMsgTxt(const char *msg)
+{
+  fprintf(stderr,"Error: %s\n",msg);
+  exit(1);
+}
+
+void mexWarnMsgTxt(const char *msg)
+{
+  fprintf(stderr,"Warning: %s\n",msg);
+}
+
+int mexPrintf(const char *fmt, ...)
+{
+  va_list ap;
+  int r;
+  va_start(ap,fmt);
+  r=vprintf(fmt,ap);
+  va_end(ap);
+  return(r);
+}
@@ -0,0 +1,224 @@
+#include "mex.h"
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+/*
+% cellsparsemtimes Product of a block partitioned matrix and a full matrix
+% USAGE
+%   C=cellsparsemtimes(A,s,B,pre);
+% INPUTS
+%   A   : cell array of m-row matrices (sparse or full); the whole matrix is
+%           [A{:}]
+%   s   : (length(A)+1)-vector of column offsets with s(j+1)-s(j)
+%           columns in A{j} (s(1)=0)
+%   B   : full matrix
+%   pre : 0 to compute [A{:}]*B, 1 to compute B*[A{:}]  [default: 0]
+% OUTPUT
+%   C   : full matrix
+%
+% This is the product used by the mtimes method of the cellsparse class;
+% the blocks of A are never concatenated.
+%
+% For B*[A{:}] each column of C depends on a single column of a single
+% block so the columns are processed in parallel (when compiled with
+% OpenMP) with each thread writing to its own columns of C.
+% For [A{:}]*B each thread accumulates the products for its own set of
+% columns of [A{:}]; the first thread uses C directly and the others use
+% a work array of the same size that is added to C at the end.
+%
+% Coded as a MEX file
+*/
+
+// minimum number of non-zeros for multi-threading
+#define MINPARALLEL 100000
+
+/* block containing global column g (s[k]<=g<s[k+1]) */
+static mwIndex getblock(const double *s, mwSize n, mwIndex g)
+{
+  mwIndex lo=0, hi=n-1, k;
+  while (lo<hi){
+    k=(lo+hi+1)/2;
+    if ((double)g>=s[k]) lo=k;
+    else                 hi=k-1;
+  }
+  return lo;
+}
+
+/* C(:,g) = B*A(:,g) for all columns g; B is p x m, C is p x N
+   Pr, Ir, Jc and sp hold the pointers and sparsity of each block */
+void premult(const double **Pr, const mwIndex **Ir, const mwIndex **Jc,
+             const int *sp, const double *s, mwSize n, mwSize m,
+             const double *B, mwSize p, double *C, mwSize N, mwSize nnz)
+{
+  mwSignedIndex g;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(nnz*p>MINPARALLEL)
+#endif
+  for (g=0; g<(mwSignedIndex)N; g++){
+    mwIndex k=getblock(s,n,g), j=g-(mwIndex)s[k], e, eend, i;
+    const double *pr=Pr[k], *Bi;
+    double *Cg=C+g*p, a;
+    memset(Cg,0,p*sizeof(double));
+    if (sp[k]){
+      const mwIndex *ir=Ir[k], *jc=Jc[k];
+      eend=jc[j+1];
+      if (p==1)
+        for (e=jc[j]; e<eend; e++) Cg[0]+=B[ir[e]]*pr[e];
+      else{
+        for (e=jc[j]; e<eend; e++){
+          a=pr[e];
+          Bi=B+ir[e]*p;
+          for (i=0; i<p; i++) Cg[i]+=Bi[i]*a;
+        }
+      }
+    }
+    else{
+      pr+=j*m;
+      for (e=0; e<m; e++){
+        a=pr[e];
+        if (a==0) continue;
+        Bi=B+e*p;
+        for (i=0; i<p; i++) Cg[i]+=Bi[i]*a;
+      }
+    }
+  }
+}
+
+/* C += A(:,g)*B(g,:) for columns g=g0,...,g1-1; B is N x q, C is m x q */
+static void postmultcols(const double **Pr, const mwIndex **Ir,
+                         const mwIndex **Jc, const int *sp,
+                         const double *s, mwSize n, mwSize m,
+                         const double *B, mwSize N, mwSize q,
+                         double *C, mwIndex g0, mwIndex g1)
+{
+  mwIndex g, k, j, e, eend, l;
+  const double *pr;
+  double b;
+  if (g0>=g1) return;
+  k=getblock(s,n,g0);
+  for (g=g0; g<g1; g++){
+    while ((double)g>=s[k+1]) k++;
+    j=g-(mwIndex)s[k];
+    pr=Pr[k];
+    if (sp[k]){
+      const mwIndex *ir=Ir[k], *jc=Jc[k];
+      eend=jc[j+1];
+      for (l=0; l<q; l++){
+        b=B[g+l*N];
+        if (b==0) continue;
+        for (e=jc[j]; e<eend; e++) C[ir[e]+l*m]+=pr[e]*b;
+      }
+    }
+    else{
+      for (l=0; l<q; l++){
+        b=B[g+l*N];
+        if (b==0) continue;
+        for (e=0; e<m; e++) C[e+l*m]+=pr[e+j*m]*b;
+      }
+    }
+  }
+}
+
+/* C = [A{:}]*B; B is N x q, C is m x q */
+void postmult(const double **Pr, const mwIndex **Ir, const mwIndex **Jc,
+              const int *sp, const double *s, mwSize n, mwSize m,
+              const double *B, mwSize N, mwSize q, double *C, mwSize nnz)
+{
+  int nthreads=1;
+  double *work=NULL;
+#ifdef _OPENMP
+  if (nnz*q>MINPARALLEL) nthreads=omp_get_max_threads();
+#endif
+  if (nthreads>1) work=mxCalloc((nthreads-1)*m*q,sizeof(double));
+  if (work==NULL) nthreads=1;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+  {
+    int t=0, nt=1;
+    mwSignedIndex i;
+    mwSize mq=m*q;
+#ifdef _OPENMP
+    t=omp_get_thread_num();
+    nt=omp_get_num_threads();
+#endif
+    postmultcols(Pr,Ir,Jc,sp,s,n,m,B,N,q, t==0 ? C : work+(t-1)*mq,
+                 (N*t)/nt,(N*(t+1))/nt);
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp for schedule(static)
+#endif
+    for (i=0; i<(mwSignedIndex)mq; i++){
+      int tt;
+      for (tt=1; tt<nt; tt++) C[i]+=work[(tt-1)*mq+i];
+    }
+  }
+  if (work!=NULL) mxFree(work);
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  const mxArray *A, *Ak;
+  const double *s;
+  mwSize n, m, N, nnz, k, p, q;
+  int pre, *sp;
+  const double **Pr;
+  const mwIndex **Ir, **Jc;
+
+  if (nrhs<3) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>4) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  A=prhs[0];
+  if (!mxIsCell(A)) mexErrMsgTxt("A must be a cell array");
+  n=mxGetNumberOfElements(A);
+  if (!mxIsDouble(prhs[1]) || mxGetNumberOfElements(prhs[1])!=n+1)
+    mexErrMsgTxt("s must have one more element than A");
+  if (!mxIsDouble(prhs[2]) || mxIsSparse(prhs[2]) || mxIsComplex(prhs[2]))
+    mexErrMsgTxt("B must be a real full double matrix");
+  pre = nrhs>3 && mxGetScalar(prhs[3])!=0;
+  s=mxGetPr(prhs[1]);
+  if (s[0]!=0) mexErrMsgTxt("s(1) must be 0");
+  N=(mwSize)s[n];
+
+  // check the blocks and collect their pointers so the threads do not call the API
+  Pr=mxMalloc((n>0 ? n : 1)*sizeof(double *));
+  Ir=mxMalloc((n>0 ? n : 1)*sizeof(mwIndex *));
+  Jc=mxMalloc((n>0 ? n : 1)*sizeof(mwIndex *));
+  sp=mxMalloc((n>0 ? n : 1)*sizeof(int));
+  m=0;
+  nnz=0;
+  for (k=0; k<n; k++){
+    Ak=mxGetCell(A,k);
+    if (Ak==NULL || !mxIsDouble(Ak) || mxIsComplex(Ak))
+      mexErrMsgTxt("The blocks of A must be real double matrices");
+    if (k==0) m=mxGetM(Ak);
+    if (mxGetM(Ak)!=m) mexErrMsgTxt("The blocks of A must have the same number of rows");
+    if ((double)mxGetN(Ak)!=s[k+1]-s[k]) mexErrMsgTxt("s is not compatible with A");
+    Pr[k]=mxGetPr(Ak);
+    sp[k]=mxIsSparse(Ak);
+    Ir[k]=sp[k] ? mxGetIr(Ak) : NULL;
+    Jc[k]=sp[k] ? mxGetJc(Ak) : NULL;
+    if (sp[k]) nnz+=Jc[k][mxGetN(Ak)];
+    else       nnz+=mxGetNumberOfElements(Ak);
+  }
+
+  if (pre){
+    p=mxGetM(prhs[2]);
+    if (mxGetN(prhs[2])!=m) mexErrMsgTxt("Inner matrix dimensions must agree.");
+    plhs[0]=mxCreateDoubleMatrix(p,N,mxREAL);
+    if (N>0 && p>0) premult(Pr,Ir,Jc,sp,s,n,m,mxGetPr(prhs[2]),p,mxGetPr(plhs[0]),N,nnz);
+  }
+  else{
+    q=mxGetN(prhs[2]);
+    if (mxGetM(prhs[2])!=N) mexErrMsgTxt("Inner matrix dimensions must agree.");
+    plhs[0]=mxCreateDoubleMatrix(m,q,mxREAL);
+    if (N>0 && m>0) postmult(Pr,Ir,Jc,sp,s,n,m,mxGetPr(prhs[2]),N,q,mxGetPr(plhs[0]),nnz);
+  }
+  mxFree(sp);
+  mxFree(Jc);
+  mxFree(Ir);
+  mxFree(Pr);
+}
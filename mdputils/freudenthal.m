@@ -25,6 +25,9 @@
 % triangulation.
 %
 % Note that the rows of B are arranged so B'*rectgrid(s) equals S.
+%
+% If the MEX file freudenthalc is available it is used to compute B
+% directly without forming the N x d intermediate arrays.
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
@@ -68,6 +71,10 @@ end
 if dim~=d
   error('s and S are incompatible')
 end
+if exist('freudenthalc','file')==3  % use mex file if it exists
+  B=freudenthalc(full(double(S)),s,double(cleanup));
+  return
+end
   
 n=zeros(dim,1);
 ind=zeros(N,dim);
@@ -0,0 +1,227 @@
+#include "mex.h"
+#include <math.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+/*
+% freudenthalc Freudenthal interpolation basis matrix for a lattice
+% USAGE
+%   B=freudenthalc(S,s,cleanup);
+% INPUTS
+%   S       : Nxd matrix of evaluation points
+%   s       : d element cell array of vectors defining the lattice
+%   cleanup : 0/1/2 (see freudenthal)
+% OUTPUT
+%   B       : nxN sparse matrix of basis values (n is the number of grid points)
+%
+% MEX file version of freudenthal
+% This function is called by freudenthal and is best if not called directly
+% because freudenthal includes error checking
+%
+% Each evaluation point is handled independently: the lattice cell is found
+% for each dimension, the relative coordinates are sorted and the weights
+% and vertex indices are computed using only d-element work vectors.
+% The columns of B are computed in parallel when compiled with OpenMP.
+*/
+
+// sorts a in descending order
+// also returns the index of the sorted values
+// ties are kept in their original order (as in MATLAB's sort)
+static void insertionsort(double *a, mwIndex *ind, mwIndex n){
+  mwIndex i, j;
+  mwIndex ix;
+  double ax;
+  for (i=1; i<n; i++) {
+    ax = a[i]; ix = ind[i];
+    j = i;
+    while (j>0 && a[j-1]<ax) {
+      a[j]   = a[j-1];
+      ind[j] = ind[j-1];
+      j--;
+    }
+    a[j]   = ax;
+    ind[j] = ix;
+  }
+}
+
+// returns the 0-based index k of the interval [s[k],s[k+1]] used for x
+// k is the largest value with x>=s[k], limited to 0<=k<=n-2
+static mwIndex findcell(const double *s, mwSize n, double x){
+  mwIndex lo, hi, j;
+  if (x<s[1])   return(0);
+  if (x>=s[n-2]) return(n-2);
+  lo=1; hi=n-2;
+  while (hi-lo>1) {
+    j=(lo+hi)/2;
+    if (x>=s[j]) lo=j;
+    else hi=j;
+  }
+  return(lo);
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  double *S, **s, *h, *w, *dwork;
+  mwIndex *ir, *jc, *bw, *cwork, *n, nnz, i, j, k;
+  mwSize N, d, d1, ns;
+  mwSignedIndex jj;
+  int cleanup, *even, nthreads;
+
+  /* Error checking on inputs */
+  if (nrhs<2) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>3) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  if (!mxIsDouble(prhs[0]) || mxIsSparse(prhs[0]) || mxIsComplex(prhs[0]))
+    mexErrMsgTxt("S must be a real full double matrix");
+  if (!mxIsCell(prhs[1]))
+    mexErrMsgTxt("s must be a cell array");
+  if (nrhs>2) cleanup=(int) mxGetScalar(prhs[2]);
+  else        cleanup=0;
+
+  S=mxGetPr(prhs[0]);
+  N=mxGetM(prhs[0]);
+  d=mxGetN(prhs[0]);
+  if (mxGetNumberOfElements(prhs[1])!=d)
+    mexErrMsgTxt("s and S are incompatible");
+  d1=d+1;
+
+  // get the grid vectors and check for even spacing
+  s    = mxMalloc(d*sizeof(double *));
+  n    = mxMalloc(d*sizeof(mwIndex));
+  h    = mxMalloc(d*sizeof(double));
+  even = mxMalloc(d*sizeof(int));
+  bw   = mxMalloc(d*sizeof(mwIndex));
+  for (i=0; i<d; i++){
+    mxArray *si=mxGetCell(prhs[1],i);
+    if (si==NULL || !mxIsDouble(si) || mxIsSparse(si))
+      mexErrMsgTxt("elements of s must be double vectors");
+    s[i]=mxGetPr(si);
+    n[i]=mxGetNumberOfElements(si);
+    if (n[i]<2)
+      mexErrMsgTxt("elements of s must have at least 2 values");
+    h[i]=s[i][1]-s[i][0];
+    even[i]=1;
+    for (k=1; k<n[i]-1; k++){
+      if (fabs((s[i][k+1]-s[i][k])/h[i]-1)>=1e-15) {even[i]=0; break;}
+    }
+  }
+  // vertex index weights (last variable changes fastest)
+  ns=1;
+  for (jj=d-1; jj>=0; jj--){ bw[jj]=ns; ns*=n[jj]; }
+
+  // allocate memory for the output
+  // entries with zero weight are removed after the loop
+  plhs[0]=mxCreateSparse(ns, N, N*d1>0 ? N*d1 : 1, mxREAL);
+  w  = mxGetPr(plhs[0]);
+  ir = mxGetIr(plhs[0]);
+  jc = mxGetJc(plhs[0]);
+
+  // work space for each thread
+#ifdef _OPENMP
+  nthreads=omp_get_max_threads();
+#else
+  nthreads=1;
+#endif
+  dwork = mxMalloc(nthreads*d*sizeof(double));
+  cwork = mxMalloc(nthreads*(2*d)*sizeof(mwIndex));
+
+  // loop over the evaluation points
+  // jc[j+1] temporarily holds the number of non-zeros in column j
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads) if(N>1000)
+#endif
+  {
+  int tid=0;
+  double *dj, *wj, sumw, xi;
+  mwIndex *ind, *p, *irj, ii, m, v;
+  mwSignedIndex jl;
+#ifdef _OPENMP
+  tid=omp_get_thread_num();
+#endif
+  dj=dwork+tid*d;
+  ind=cwork+tid*2*d;
+  p=ind+d;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+  for (jl=0; jl<(mwSignedIndex)N; jl++){
+    // find the lattice cell and relative position for each dimension
+    for (ii=0; ii<d; ii++){
+      xi=S[jl+ii*N];
+      if (cleanup==2){
+        if (xi<s[ii][0])           xi=s[ii][0];
+        else if (xi>s[ii][n[ii]-1]) xi=s[ii][n[ii]-1];
+      }
+      if (even[ii]){
+        double c=ceil((xi-s[ii][0])/h[ii]);
+        if (!(c>=1)) c=1;  // also catches NaN (gives NaN weights)
+        else if (c>n[ii]-1) c=(double)(n[ii]-1);
+        ind[ii]=(mwIndex)c-1;
+        dj[ii]=(xi-s[ii][ind[ii]])/h[ii];
+      }
+      else{
+        ind[ii]=findcell(s[ii],n[ii],xi);
+        dj[ii]=(xi-s[ii][ind[ii]])/(s[ii][ind[ii]+1]-s[ii][ind[ii]]);
+      }
+      p[ii]=ii;
+    }
+    insertionsort(dj,p,d);
+    // weights: 1-d(1), d(1)-d(2), ..., d(d-1)-d(d), d(d)
+    wj=w+jl*d1;
+    irj=ir+jl*d1;
+    wj[0]=1-dj[0];
+    for (ii=1; ii<d; ii++) wj[ii]=dj[ii-1]-dj[ii];
+    wj[d]=dj[d-1];
+    if (cleanup==1){
+      sumw=0;
+      for (ii=0; ii<=d; ii++){
+        if (wj[ii]<0) wj[ii]=0;
+        sumw+=wj[ii];
+      }
+      for (ii=0; ii<=d; ii++) wj[ii]/=sumw;
+    }
+    // vertex indices (increasing so no sort is needed)
+    v=0;
+    for (ii=0; ii<d; ii++) v+=ind[ii]*bw[ii];
+    irj[0]=v;
+    for (ii=0; ii<d; ii++){
+      v+=bw[p[ii]];
+      irj[ii+1]=v;
+    }
+    // remove zero weights
+    m=0;
+    for (ii=0; ii<=d; ii++){
+      if (wj[ii]!=0){
+        wj[m]=wj[ii];
+        irj[m]=irj[ii];
+        m++;
+      }
+    }
+    jc[jl+1]=m;
+  }
+  }
+
+  // compact the columns
+  jc[0]=0;
+  nnz=0;
+  for (j=0; j<N; j++){
+    mwIndex m=jc[j+1], start=j*d1;
+    if (nnz!=start){
+      memmove(w+nnz, w+start,m*sizeof(double));
+      memmove(ir+nnz,ir+start,m*sizeof(mwIndex));
+    }
+    nnz+=m;
+    jc[j+1]=nnz;
+  }
+
+  mxFree(s);
+  mxFree(n);
+  mxFree(h);
+  mxFree(even);
+  mxFree(bw);
+  mxFree(dwork);
+  mxFree(cwork);
+}
@@ -0,0 +1,52 @@
+% freudenthalc Freudenthal interpolation basis matrix for a lattice
+% USAGE
+%   B=freudenthalc(S,s,cleanup);
+% INPUTS
+%   S       : Nxd matrix of evaluation points
+%   s       : d element cell array of vectors defining the lattice
+%   cleanup : 0/1/2 - Determines how extrapolation is handled
+%               (see freudenthal)
+% OUTPUT
+%   B       : nxN sparse matrix of basis values (n is the number of grid points)
+%
+% MEX file version of freudenthal
+% This function is called by freudenthal and is best if not called directly
+% because freudenthal includes error checking
+%
+% Each evaluation point is processed independently using only d-element
+% work vectors so no N x d intermediate arrays are formed. Columns are 
+% computed in parallel when the MEX file is compiled with OpenMP
+% (see mdpmexall).
+
+% MDPSOLVE: MATLAB tools for solving Markov Decision Problems
+% Copyright (c) 2026, Paul L. Fackler (paul_fackler@ncsu.edu)
+% All rights reserved.
+% 
+% Redistribution and use in source and binary forms, with or without  
+% modification, are permitted provided that the following conditions are met:
+% 
+%    * Redistributions of source code must retain the above copyright notice, 
+%        this list of conditions and the following disclaimer.
+%    * Redistributions in binary form must reproduce the above copyright notice, 
+%        this list of conditions and the following disclaimer in the 
+%        documentation and/or other materials provided with the distribution.
+%    * Neither the name of the North Carolina State University nor of Paul L. 
+%        Fackler may be used to endorse or promote products derived from this 
+%        software without specific prior written permission.
+% 
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+% FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+% DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+% SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+% CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+% OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+% OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+% 
+% For more information, see the Open Source Initiative OSI site:
+%   http://www.opensource.org/licenses/bsd-license.php
+
+function varargout=freudenthalc(varargin)
+error('This function should not be called')
@@ -14,6 +14,13 @@
 % The matrix of state values can be defined using
 %   S=X(Ix,svars);
 %
+% With 2 inputs the MEX function getIc is used if it is available; it
+%   hashes the rows rather than sorting them.
+%
+% X and S can be implicitgrid objects. If X is an implicitgrid and svars
+%   are the columns of some of its inputs, Ix is computed without forming
+%   X and S is an implicitgrid (see implicitgrid/subindex).
+%
 % Warning: if X does not contain at least one row for every value of S the
 %   indices moght be incorrectly computed using only 2 inputs; if this is a 
 %   possability use 3 inputs.
@@ -49,8 +56,23 @@
 %   http://www.opensource.org/licenses/bsd-license.php
 
 function [Ix,S]=getI(X,svars,S)
+if isa(X,'implicitgrid') || (nargin>=3 && isa(S,'implicitgrid'))
+  if nargin<3
+    [Ix,S]=subindex(X,svars);
+  elseif isa(S,'implicitgrid')
+    Ix=rank(S,X(:,svars));
+  else
+    Ix=match(X(:,svars),S);
+  end
+  return
+end
 if nargin<3
-  [S,temp,Ix]=unique(X(:,svars),'rows');
+  if (isnumeric(X) || islogical(X)) && ~issparse(X) && isreal(X) ...
+     && exist('getIc','file')==3  % use mex file if it exists
+    [Ix,S]=getIc(X,svars,1);
+  else
+    [S,temp,Ix]=unique(X(:,svars),'rows');
+  end
 else
   Ix=match(X(:,svars),S);
 end
\ No newline at end of file
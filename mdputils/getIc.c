@@ -0,0 +1,478 @@
+#include "mex.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+/*
+% getIc Indexes the distinct rows of selected columns of a matrix
+% USAGE
+%   [Ix,S]=getIc(X,svars,sorted);
+% INPUTS
+%   X      : nx x d numeric matrix (double, single, integer or logical)
+%   svars  : vector of column numbers of X
+%   sorted : 1 to return S in sorted order (as unique(...,'rows') does),
+%              0 for the order of first occurrence in X [default: 1]
+% OUTPUTS
+%   Ix     : nx-vector with S(Ix,:) equal to X(:,svars)
+%   S      : ns x length(svars) matrix of the distinct rows of X(:,svars)
+%              (same class as X)
+%
+% Used by getI in place of unique(X(:,svars),'rows').
+%
+% When the selected columns hold integer values whose ranges fit in 64
+% bits each row is packed into a 64-bit key (the first column in the
+% highest bits so keys sort in the same order as the rows). The keys are
+% placed in an open addressing hash table so the memory used, other than
+% the outputs, is proportional to the number of distinct rows. For very
+% large nx the keys are instead sorted with a parallel radix sort (when
+% compiled with OpenMP and more than one thread is available). Other values are hashed and compared a row at a
+% time; rows containing NaNs are never equal to other rows, as with unique.
+%
+% Coded as a MEX file
+*/
+
+typedef unsigned long long uint64;
+
+// nx at or above which packed keys are radix sorted
+#define RADIXMIN 4194304
+// minimum number of rows for multi-threading
+#define MINPARALLEL 100000
+
+/* data shared by the routines */
+static const void *Xdata;
+static mxClassID Xclass;
+static mwSize nx, ncols;
+static mwIndex *colind;   /* 0-based column numbers */
+
+/* element i of column c of X */
+static double getval(mwIndex c, mwIndex i)
+{
+  mwIndex k=colind[c]*nx+i;
+  switch (Xclass){
+  case mxDOUBLE_CLASS:  return(((const double *)Xdata)[k]);
+  case mxSINGLE_CLASS:  return(((const float *)Xdata)[k]);
+  case mxINT8_CLASS:    return(((const signed char *)Xdata)[k]);
+  case mxUINT8_CLASS:   return(((const unsigned char *)Xdata)[k]);
+  case mxINT16_CLASS:   return(((const short *)Xdata)[k]);
+  case mxUINT16_CLASS:  return(((const unsigned short *)Xdata)[k]);
+  case mxINT32_CLASS:   return(((const int *)Xdata)[k]);
+  case mxUINT32_CLASS:  return(((const unsigned int *)Xdata)[k]);
+  case mxINT64_CLASS:   return((double)((const long long *)Xdata)[k]);
+  case mxUINT64_CLASS:  return((double)((const uint64 *)Xdata)[k]);
+  case mxLOGICAL_CLASS: return(((const mxLogical *)Xdata)[k]);
+  default:              return(0);
+  }
+}
+
+/* mixes the bits of a key (splitmix64 finalizer) */
+static uint64 hash64(uint64 x)
+{
+  x^=x>>30; x*=0xbf58476d1ce4e5b9ULL;
+  x^=x>>27; x*=0x94d049bb133111ebULL;
+  x^=x>>31;
+  return(x);
+}
+
+/***************************************************************/
+/* packed keys */
+
+static double *colmin;
+static int *shift;
+
+static uint64 rowkey(mwIndex i)
+{
+  uint64 key=0;
+  mwIndex c;
+  for (c=0; c<ncols; c++)
+    key|=(uint64)(getval(c,i)-colmin[c])<<shift[c];
+  return(key);
+}
+
+/* determines the shifts for packed keys; returns the number of bits used
+   or -1 if the rows cannot be packed */
+static int packkeys(void)
+{
+  mwSignedIndex c;
+  int bits=0, ok=1;
+  double *colmax=mxMalloc(ncols*sizeof(double));
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if(nx*ncols>MINPARALLEL)
+#endif
+  for (c=0; c<(mwSignedIndex)ncols; c++){
+    double x, xmin=HUGE_VAL, xmax=-HUGE_VAL;
+    mwIndex i;
+    int cok=1;
+    for (i=0; i<nx; i++){
+      x=getval(c,i);
+      if (x!=floor(x) || x-x!=0){ cok=0; break; }   // NaNs fail x==floor(x), Infs x-x==0
+      if (x<xmin) xmin=x;
+      if (x>xmax) xmax=x;
+    }
+    if (!cok) ok=0;
+    colmin[c]=xmin;
+    colmax[c]=xmax;
+  }
+  if (ok && nx>0){
+    for (c=(mwSignedIndex)ncols-1; c>=0; c--){
+      double range=colmax[c]-colmin[c];
+      int b=0;
+      while (b<64 && ldexp(1.0,b)<=range) b++;
+      if (range>9007199254740991.0) ok=0;   // ranges beyond 2^53 are inexact
+      shift[c]=bits;
+      bits+=b;
+    }
+    if (bits>64) ok=0;
+  }
+  mxFree(colmax);
+  if (!ok) return(-1);
+  if (nx==0) return(0);
+  // a shift of 64 is undefined; only happens for zero-width columns
+  for (c=0; c<(mwSignedIndex)ncols; c++) if (shift[c]>=64) shift[c]=0;
+  return(bits);
+}
+
+/* hash table of packed keys; returns the number of distinct rows
+   with first[g] the first row of group g and gkey[g] its key */
+static mwSize hashkeys(double *Ix, mwIndex **first, uint64 **gkey)
+{
+  mwSize tsize=1024, ng=0, gsize=1024, mask, j;
+  uint64 *tkey, key, h;
+  mwIndex *tgrp, i;
+  tkey=mxMalloc(tsize*sizeof(uint64));
+  tgrp=mxCalloc(tsize,sizeof(mwIndex));    // 0: empty, otherwise group+1
+  *first=mxMalloc(gsize*sizeof(mwIndex));
+  *gkey=mxMalloc(gsize*sizeof(uint64));
+  mask=tsize-1;
+  for (i=0; i<nx; i++){
+    key=rowkey(i);
+    h=hash64(key)&mask;
+    while (tgrp[h]!=0 && tkey[h]!=key) h=(h+1)&mask;
+    if (tgrp[h]==0){
+      if (ng==gsize){
+        gsize*=2;
+        *first=mxRealloc(*first,gsize*sizeof(mwIndex));
+        *gkey=mxRealloc(*gkey,gsize*sizeof(uint64));
+      }
+      (*first)[ng]=i;
+      (*gkey)[ng]=key;
+      ng++;
+      tkey[h]=key;
+      tgrp[h]=ng;
+      Ix[i]=(double)ng;
+      // keep the load factor below 1/2
+      if (2*ng>tsize){
+        mxFree(tkey);
+        mxFree(tgrp);
+        tsize*=2;
+        mask=tsize-1;
+        tkey=mxMalloc(tsize*sizeof(uint64));
+        tgrp=mxCalloc(tsize,sizeof(mwIndex));
+        for (j=0; j<ng; j++){
+          h=hash64((*gkey)[j])&mask;
+          while (tgrp[h]!=0) h=(h+1)&mask;
+          tkey[h]=(*gkey)[j];
+          tgrp[h]=j+1;
+        }
+      }
+    }
+    else Ix[i]=(double)tgrp[h];
+  }
+  mxFree(tkey);
+  mxFree(tgrp);
+  return(ng);
+}
+
+/* sorts the packed keys with a (parallel) LSD radix sort and assigns
+   groups; returns the number of distinct rows */
+static mwSize radixkeys(int bits, double *Ix, mwIndex **first, uint64 **gkey)
+{
+  uint64 *key, *key2, *tk;
+  mwIndex *ind, *ind2, *ti, *count;
+  mwSize ng, gsize;
+  mwSignedIndex i;
+  int pass, npass=(bits+7)/8, nthreads=1;
+#ifdef _OPENMP
+  nthreads=omp_get_max_threads();
+#endif
+  key=mxMalloc(nx*sizeof(uint64));
+  key2=mxMalloc(nx*sizeof(uint64));
+  ind=mxMalloc(nx*sizeof(mwIndex));
+  ind2=mxMalloc(nx*sizeof(mwIndex));
+  count=mxMalloc(nthreads*256*sizeof(mwIndex));
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (i=0; i<(mwSignedIndex)nx; i++){
+    key[i]=rowkey(i);
+    ind[i]=i;
+  }
+  for (pass=0; pass<npass; pass++){
+    int sh=8*pass;
+    // each thread counts and then scatters its own block of rows;
+    // blocks are scattered in order so the sort is stable
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+    {
+      int t=0, nt=1, d, tt;
+      mwIndex *cnt, lo, hi, k;
+#ifdef _OPENMP
+      t=omp_get_thread_num();
+      nt=omp_get_num_threads();
+#endif
+      cnt=count+256*t;
+      lo=(nx*t)/nt;
+      hi=(nx*(t+1))/nt;
+      memset(cnt,0,256*sizeof(mwIndex));
+      for (k=lo; k<hi; k++) cnt[(key[k]>>sh)&255]++;
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+      {
+        mwIndex s=0, c;
+        for (d=0; d<256; d++){
+          for (tt=0; tt<nt; tt++){
+            c=count[256*tt+d];
+            count[256*tt+d]=s;
+            s+=c;
+          }
+        }
+      }
+      for (k=lo; k<hi; k++){
+        mwIndex pos=cnt[(key[k]>>sh)&255]++;
+        key2[pos]=key[k];
+        ind2[pos]=ind[k];
+      }
+    }
+    tk=key; key=key2; key2=tk;
+    ti=ind; ind=ind2; ind2=ti;
+  }
+  mxFree(key2);
+  mxFree(ind2);
+  mxFree(count);
+  // groups; the first row of each group is the first occurrence
+  gsize=1024;
+  *first=mxMalloc(gsize*sizeof(mwIndex));
+  *gkey=mxMalloc(gsize*sizeof(uint64));
+  ng=0;
+  for (i=0; i<(mwSignedIndex)nx; i++){
+    if (i==0 || key[i]!=key[i-1]){
+      if (ng==gsize){
+        gsize*=2;
+        *first=mxRealloc(*first,gsize*sizeof(mwIndex));
+        *gkey=mxRealloc(*gkey,gsize*sizeof(uint64));
+      }
+      (*first)[ng]=ind[i];
+      (*gkey)[ng]=key[i];
+      ng++;
+    }
+    Ix[ind[i]]=(double)ng;
+  }
+  mxFree(key);
+  mxFree(ind);
+  return(ng);
+}
+
+/***************************************************************/
+/* general rows (non-integer values) */
+
+static uint64 rowhash(mwIndex i)
+{
+  uint64 h=0, b;
+  double x;
+  mwIndex c;
+  for (c=0; c<ncols; c++){
+    x=getval(c,i);
+    if (x==0) x=0;            // -0 and 0 are equal
+    memcpy(&b,&x,sizeof(uint64));
+    h=hash64(h^b)+c;
+  }
+  return(h);
+}
+
+static int rowsequal(mwIndex i, mwIndex j)
+{
+  mwIndex c;
+  for (c=0; c<ncols; c++) if (!(getval(c,i)==getval(c,j))) return(0);
+  return(1);
+}
+
+static mwSize hashrows(double *Ix, mwIndex **first)
+{
+  mwSize tsize=1024, ng=0, gsize=1024, mask, j;
+  uint64 h, *ghash, *thash;
+  mwIndex *tgrp, i;
+  thash=mxMalloc(tsize*sizeof(uint64));
+  tgrp=mxCalloc(tsize,sizeof(mwIndex));
+  *first=mxMalloc(gsize*sizeof(mwIndex));
+  ghash=mxMalloc(gsize*sizeof(uint64));
+  mask=tsize-1;
+  for (i=0; i<nx; i++){
+    uint64 hi=rowhash(i);
+    h=hi&mask;
+    while (tgrp[h]!=0 && (thash[h]!=hi || !rowsequal((*first)[tgrp[h]-1],i)))
+      h=(h+1)&mask;
+    if (tgrp[h]==0){
+      if (ng==gsize){
+        gsize*=2;
+        *first=mxRealloc(*first,gsize*sizeof(mwIndex));
+        ghash=mxRealloc(ghash,gsize*sizeof(uint64));
+      }
+      (*first)[ng]=i;
+      ghash[ng]=hi;
+      ng++;
+      thash[h]=hi;
+      tgrp[h]=ng;
+      Ix[i]=(double)ng;
+      if (2*ng>tsize){
+        mxFree(thash);
+        mxFree(tgrp);
+        tsize*=2;
+        mask=tsize-1;
+        thash=mxMalloc(tsize*sizeof(uint64));
+        tgrp=mxCalloc(tsize,sizeof(mwIndex));
+        for (j=0; j<ng; j++){
+          h=ghash[j]&mask;
+          while (tgrp[h]!=0) h=(h+1)&mask;
+          thash[h]=ghash[j];
+          tgrp[h]=j+1;
+        }
+      }
+    }
+    else Ix[i]=(double)tgrp[h];
+  }
+  mxFree(thash);
+  mxFree(tgrp);
+  mxFree(ghash);
+  return(ng);
+}
+
+/***************************************************************/
+/* ordering of the groups */
+
+static const uint64 *sortkey;
+static const mwIndex *sortfirst;
+
+static int comparekeys(const void *a, const void *b)
+{
+  uint64 ka=sortkey[*(const mwIndex *)a], kb=sortkey[*(const mwIndex *)b];
+  return(ka<kb ? -1 : (ka>kb ? 1 : 0));
+}
+
+static int comparefirst(const void *a, const void *b)
+{
+  mwIndex fa=sortfirst[*(const mwIndex *)a], fb=sortfirst[*(const mwIndex *)b];
+  return(fa<fb ? -1 : (fa>fb ? 1 : 0));
+}
+
+/* lexicographic order of rows; NaNs sort last, rows with NaNs in the
+   same place are ordered by position */
+static int comparerows(const void *a, const void *b)
+{
+  mwIndex ra=sortfirst[*(const mwIndex *)a], rb=sortfirst[*(const mwIndex *)b], c;
+  double xa, xb;
+  for (c=0; c<ncols; c++){
+    xa=getval(c,ra);
+    xb=getval(c,rb);
+    if (xa<xb) return(-1);
+    if (xa>xb) return(1);
+    if (mxIsNaN(xa) && !mxIsNaN(xb)) return(1);
+    if (mxIsNaN(xb) && !mxIsNaN(xa)) return(-1);
+  }
+  return(ra<rb ? -1 : (ra>rb ? 1 : 0));
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  mwIndex *first, *order, *rank, i, c;
+  mwSignedIndex k;
+  mwSize ng;
+  uint64 *gkey=NULL;
+  double *Ix, *sv;
+  int bits, sorted, packed, radix;
+  size_t es;
+
+  if (nrhs<2) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>3) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>2) mexErrMsgTxt("Too many output arguments.");
+  if (!(mxIsNumeric(prhs[0]) || mxIsLogical(prhs[0])) || mxIsSparse(prhs[0])
+      || mxIsComplex(prhs[0]))
+    mexErrMsgTxt("X must be a real full numeric matrix");
+  if (!mxIsDouble(prhs[1]))
+    mexErrMsgTxt("svars must be a double vector");
+  sorted=1;
+  if (nrhs>2 && !mxIsEmpty(prhs[2])) sorted=mxGetScalar(prhs[2])!=0;
+
+  Xdata=mxGetData(prhs[0]);
+  Xclass=mxGetClassID(prhs[0]);
+  nx=mxGetM(prhs[0]);
+  ncols=mxGetNumberOfElements(prhs[1]);
+  sv=mxGetPr(prhs[1]);
+  colind=mxMalloc((ncols>0 ? ncols : 1)*sizeof(mwIndex));
+  for (c=0; c<ncols; c++){
+    if (sv[c]<1 || sv[c]>mxGetN(prhs[0]) || sv[c]!=floor(sv[c]))
+      mexErrMsgTxt("svars must contain column numbers of X");
+    colind[c]=(mwIndex)sv[c]-1;
+  }
+
+  plhs[0]=mxCreateDoubleMatrix(nx,1,mxREAL);
+  Ix=mxGetPr(plhs[0]);
+
+  colmin=mxMalloc((ncols>0 ? ncols : 1)*sizeof(double));
+  shift=mxMalloc((ncols>0 ? ncols : 1)*sizeof(int));
+  bits=packkeys();
+  packed= bits>=0;
+  // the radix sort is only faster than hashing with several threads
+  radix=0;
+#ifdef _OPENMP
+  radix= packed && nx>=RADIXMIN && omp_get_max_threads()>1;
+#endif
+  if (radix)       ng=radixkeys(bits,Ix,&first,&gkey);
+  else if (packed) ng=hashkeys(Ix,&first,&gkey);
+  else             ng=hashrows(Ix,&first);
+
+  // order of the groups in S; Ix currently holds the group numbers
+  // in order of first occurrence (the radix path is already sorted)
+  order=mxMalloc((ng>0 ? ng : 1)*sizeof(mwIndex));
+  for (i=0; i<ng; i++) order[i]=i;
+  if (radix){
+    if (!sorted){
+      sortfirst=first;
+      qsort(order,ng,sizeof(mwIndex),comparefirst);
+    }
+  }
+  else if (sorted){
+    sortkey=gkey;
+    sortfirst=first;
+    qsort(order,ng,sizeof(mwIndex),packed ? comparekeys : comparerows);
+  }
+  rank=mxMalloc((ng>0 ? ng : 1)*sizeof(mwIndex));
+  for (i=0; i<ng; i++) rank[order[i]]=i+1;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(nx>MINPARALLEL)
+#endif
+  for (k=0; k<(mwSignedIndex)nx; k++) Ix[k]=(double)rank[(mwIndex)Ix[k]-1];
+
+  if (nlhs>1){
+    char *S, *X=(char *)Xdata;
+    plhs[1]=mxCreateNumericMatrix(ng,ncols,Xclass,mxREAL);
+    S=mxGetData(plhs[1]);
+    es=mxGetElementSize(prhs[0]);
+    for (c=0; c<ncols; c++)
+      for (i=0; i<ng; i++)
+        memcpy(S+(c*ng+i)*es,X+(colind[c]*nx+first[order[i]])*es,es);
+  }
+
+  mxFree(rank);
+  mxFree(order);
+  mxFree(first);
+  if (gkey!=NULL) mxFree(gkey);
+  mxFree(shift);
+  mxFree(colmin);
+  mxFree(colind);
+}
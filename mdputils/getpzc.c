@@ -76,7 +76,7 @@ void insertionSort(unsigned int *a, unsigned int *ind, int n){
   for (i=1; i < n; i++) {
     ax = a[i]; ix = ind[i];
     j = i;
-    while ((j >= 0) && (a[j-1] < ax)) {
+    while ((j > 0) && (a[j-1] < ax)) {
       a[j]   = a[j-1];
       ind[j] = ind[j-1];
       j--;
@@ -0,0 +1,187 @@
+#include "mex.h"
+#include <math.h>
+/*
+% gridmatchc Index of the nearest point on a rectangular grid
+% USAGE
+%   ind=gridmatchc(X,x,inttype);
+% INPUTS
+%   X       : m x d matrix or d-element cell array of m-vectors
+%   x       : d-element cell array with element i a sorted n(i)-vector
+%   inttype : 1 to return ind as uint32 (uint64 if prod(n)>=2^32)
+%               [default: 0]
+% OUTPUT
+%   ind : m-vector of index values on {1,...,prod(n)}
+%           if XX=rectgrid(x) then XX(ind,:) is the nearest point
+%           on the grid to X
+%
+% This is the same as gridmatch: each coordinate is matched to the
+% nearest value in x{i} with points exactly half way between two values
+% matched to the larger. Values beyond the ends of x{i} are matched to
+% the end values and NaNs to the first value.
+%
+% The work is done in a single pass through the rows of X. If the values
+% in x{i} are evenly spaced the position is computed directly; otherwise
+% a binary search of the midpoints is used. Rows are processed in
+% parallel when compiled with OpenMP.
+%
+% Used by gridmatch.
+%
+% Coded as a MEX file
+*/
+
+// minimum number of rows for multi-threading
+#define MINPARALLEL 10000
+
+// largest index that can be represented exactly as a double
+#define MAXINDEX 9007199254740992.0
+
+// relative tolerance used to decide if a grid is evenly spaced
+#define EVENTOL 1e-12
+
+/* description of the values in one dimension */
+typedef struct {
+  const double *X;   // coordinate values of the points (stride 1)
+  double *mid;       // the n-1 midpoints x[j]+(x[j+1]-x[j])/2
+  mwSize n;          // number of grid values
+  int even;          // 1 if the grid values are evenly spaced
+  double x0, h;      // first value and spacing (even grids only)
+} griddim;
+
+/* checks for even spacing and forms the midpoints */
+void setdim(griddim *g, const double *x, mwSize n)
+{
+  mwIndex j;
+  double tol;
+  g->n=n;
+  g->mid=mxMalloc((n>1 ? n-1 : 1)*sizeof(double));
+  for (j=0; j+1<n; j++) g->mid[j]=x[j]+(x[j+1]-x[j])/2;
+  g->even=0;
+  if (n>2){
+    g->x0=x[0];
+    g->h=(x[n-1]-x[0])/(double)(n-1);
+    if (g->h>0){
+      tol=EVENTOL*(fabs(x[0])>fabs(x[n-1]) ? fabs(x[0]) : fabs(x[n-1]));
+      if (tol<EVENTOL*g->h) tol=EVENTOL*g->h;
+      g->even=1;
+      for (j=1; j<n; j++){
+        if (fabs(x[j]-(g->x0+(double)j*g->h))>tol){ g->even=0; break; }
+      }
+    }
+  }
+}
+
+/* position (0 to n-1) of the grid value nearest to v */
+static mwIndex getpos(const griddim *g, double v)
+{
+  mwIndex n1=g->n-1, lo, hi, j;
+  double t;
+  if (n1==0 || !(v>=g->mid[0])) return 0;   // also catches NaNs
+  if (v>=g->mid[n1-1]) return n1;
+  if (g->even){
+    // direct guess; the midpoint checks make the result identical to
+    // the search below when rounding puts v on the wrong side of a midpoint
+    t=floor((v-g->x0)/g->h+0.5);
+    j = t<1 ? 1 : (t>(double)(n1-1) ? n1-1 : (mwIndex)t);
+    while (v<g->mid[j-1]) j--;
+    while (v>=g->mid[j])  j++;
+    return j;
+  }
+  // number of midpoints less than or equal to v (mid[lo-1]<=v<mid[hi])
+  lo=1; hi=n1-1;
+  while (lo<hi){
+    j=(lo+hi+1)/2;
+    if (v>=g->mid[j-1]) lo=j;
+    else                hi=j-1;
+  }
+  return lo;
+}
+
+void gridmatchc(const griddim *g, mwSize m, mwSize d, double *ind,
+                unsigned int *ind32, unsigned long long *ind64)
+{
+  mwSignedIndex k;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m>MINPARALLEL)
+#endif
+  for (k=0; k<(mwSignedIndex)m; k++){
+    unsigned long long r=0;
+    mwIndex i;
+    // the last dimension changes fastest
+    for (i=0; i<d; i++) r=r*g[i].n+getpos(g+i,g[i].X[k]);
+    r++;
+    if      (ind32!=NULL) ind32[k]=(unsigned int)r;
+    else if (ind64!=NULL) ind64[k]=r;
+    else                  ind[k]=(double)r;
+  }
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  const mxArray *xi, *Xi;
+  griddim *g;
+  mwSize m, d, i, n;
+  double total;
+  int inttype;
+
+  if (nrhs<2) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>3) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  inttype = nrhs>2 && !mxIsEmpty(prhs[2]) && mxGetScalar(prhs[2])!=0;
+
+  if (mxIsCell(prhs[1])) d=mxGetNumberOfElements(prhs[1]);
+  else                   d=1;
+  if (d==0) mexErrMsgTxt("x must contain at least one vector");
+  if (mxIsCell(prhs[0])){
+    if (mxGetNumberOfElements(prhs[0])!=d)
+      mexErrMsgTxt("X and x must have the same number of elements");
+    Xi=mxGetCell(prhs[0],0);
+    m = Xi==NULL ? 0 : mxGetNumberOfElements(Xi);
+  }
+  else{
+    if (mxGetN(prhs[0])!=d)
+      mexErrMsgTxt("X must have one column for each element of x");
+    m=mxGetM(prhs[0]);
+  }
+
+  g=mxMalloc(d*sizeof(griddim));
+  total=1;
+  for (i=0; i<d; i++){
+    xi = mxIsCell(prhs[1]) ? mxGetCell(prhs[1],i) : prhs[1];
+    Xi = mxIsCell(prhs[0]) ? mxGetCell(prhs[0],i) : prhs[0];
+    if (xi==NULL || Xi==NULL || !mxIsDouble(xi) || !mxIsDouble(Xi) ||
+        mxIsSparse(xi) || mxIsSparse(Xi) || mxIsComplex(xi) || mxIsComplex(Xi))
+      mexErrMsgTxt("Inputs must be real full double arrays");
+    n=mxGetNumberOfElements(xi);
+    if (n==0) mexErrMsgTxt("The elements of x must not be empty");
+    if (mxIsCell(prhs[0])){
+      if (mxGetNumberOfElements(Xi)!=m)
+        mexErrMsgTxt("The elements of X must have the same size");
+      g[i].X=mxGetPr(Xi);
+    }
+    else g[i].X=mxGetPr(Xi)+i*m;
+    setdim(g+i,mxGetPr(xi),n);
+    total*=n;
+  }
+  if (total>MAXINDEX){
+    for (i=0; i<d; i++) mxFree(g[i].mid);
+    mxFree(g);
+    mexErrMsgTxt("Grid is too large");
+  }
+
+  if (!inttype){
+    plhs[0]=mxCreateDoubleMatrix(m,1,mxREAL);
+    gridmatchc(g,m,d,mxGetPr(plhs[0]),NULL,NULL);
+  }
+  else if (total<4294967296.0){
+    plhs[0]=mxCreateNumericMatrix(m,1,mxUINT32_CLASS,mxREAL);
+    gridmatchc(g,m,d,NULL,(unsigned int *)mxGetData(plhs[0]),NULL);
+  }
+  else{
+    plhs[0]=mxCreateNumericMatrix(m,1,mxUINT64_CLASS,mxREAL);
+    gridmatchc(g,m,d,NULL,NULL,(unsigned long long *)mxGetData(plhs[0]));
+  }
+  for (i=0; i<d; i++) mxFree(g[i].mid);
+  mxFree(g);
+}
@@ -0,0 +1,146 @@
+#include "mex.h"
+#include <math.h>
+/*
+% gridrank Index numbers of the points of a rectangular or simplex grid
+% USAGE
+%   ind=gridrank(D,n);       % rectangular grid
+%   ind=gridrank(V,q,p);     % simplex grid
+% INPUTS
+%   D   : m x d matrix of positions; D(k,i) is the position of the
+%           ith coordinate of point k among the n(i) values in
+%           dimension i (1 to n(i))
+%   n   : d-vector of the number of values in each dimension
+%   V   : m x (q-1) or m x q matrix of non-negative integers; the first
+%           q-1 columns must sum to p or less (the last column is ignored)
+%   q   : dimension of the simplex
+%   p   : number of subintervals in each dimension
+% OUTPUT
+%   ind : m-vector of index values (NaN for rows that are not grid points)
+%
+% For a rectangular grid ind is the row of rectgrid(s{1},...,s{d}) with
+% D(:,i) the positions of the values in s{i} (the last dimension changes
+% fastest). For a simplex grid ind is the row of simplexgrid(q,p,p)
+% equal to V (the same as simplexindex(V,q,p)).
+%
+% The work is O(d) per point and no grid is created. Rows are processed
+% in parallel when compiled with OpenMP.
+%
+% Used by implicitgrid; gridunrank is the inverse.
+%
+% Coded as a MEX file
+*/
+
+// minimum number of rows for multi-threading
+#define MINPARALLEL 10000
+
+// largest index that can be represented exactly as a double
+#define MAXINDEX 9007199254740992.0
+
+/* mixed radix index of the rows of D (column major, m x d) */
+void rankrect(const double *D, const double *n, double *ind,
+              mwSize m, mwSize d)
+{
+  mwSignedIndex k;
+  const double nan=mxGetNaN();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m>MINPARALLEL)
+#endif
+  for (k=0; k<(mwSignedIndex)m; k++){
+    double r=0, di;
+    mwIndex i;
+    for (i=0; i<d; i++){
+      di=D[k+i*m];
+      if (di<1 || di>n[i] || di!=floor(di)){ r=nan; break; }
+      r=r*n[i]+(di-1);
+    }
+    ind[k]=r+1;
+  }
+}
+
+/* binomial coefficients B[a+b*(amax+1)]=a choose b for a<=amax, b<=bmax */
+void binomtable(double *B, mwSize amax, mwSize bmax)
+{
+  mwIndex a, b, a1=amax+1;
+  for (a=0; a<=amax; a++){
+    B[a]=1;
+    for (b=1; b<=bmax; b++){
+      if (a==0) B[a+b*a1]=0;
+      else      B[a+b*a1]=B[a-1+(b-1)*a1]+B[a-1+b*a1];
+    }
+  }
+}
+
+/* combinatorial number system index of the rows of V (m x q-1 used) */
+void ranksimplex(const double *V, double *ind, mwSize m, mwSize q, mwSize p,
+                 const double *B)
+{
+  mwSignedIndex k;
+  mwSize q1=q-1, a1=p+q;
+  const double nan=mxGetNaN();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m>MINPARALLEL)
+#endif
+  for (k=0; k<(mwSignedIndex)m; k++){
+    double r=(double)p, s=1, vi;
+    mwIndex i, L;
+    for (i=0; i<q1; i++){
+      vi=V[k+i*m];
+      if (vi<0 || vi>r || vi!=floor(vi)){ s=nan; break; }
+      // number of points with the same first i-1 values and a smaller ith value
+      L=q1-i;
+      s+=B[(mwIndex)r+L+L*a1]-B[(mwIndex)(r-vi)+L+L*a1];
+      r-=vi;
+    }
+    ind[k]=s;
+  }
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  mwSize m, d, q, p, i;
+  double *B, *n;
+  int ii;
+
+  if (nrhs<2) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>3) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  for (ii=0; ii<nrhs; ii++){
+    if (!mxIsDouble(prhs[ii]) || mxIsSparse(prhs[ii]) || mxIsComplex(prhs[ii]))
+      mexErrMsgTxt("Inputs must be real full double arrays");
+  }
+  m=mxGetM(prhs[0]);
+  d=mxGetN(prhs[0]);
+  plhs[0]=mxCreateDoubleMatrix(m,1,mxREAL);
+
+  if (nrhs==2){
+    double total=1;
+    if (mxGetNumberOfElements(prhs[1])!=d)
+      mexErrMsgTxt("n must have one element for each column of D");
+    n=mxGetPr(prhs[1]);
+    for (i=0; i<d; i++){
+      if (n[i]<1) mexErrMsgTxt("n must contain positive integers");
+      total*=n[i];
+    }
+    if (total>MAXINDEX) mexErrMsgTxt("Grid is too large");
+    rankrect(mxGetPr(prhs[0]),n,mxGetPr(plhs[0]),m,d);
+  }
+  else{
+    if (mxGetNumberOfElements(prhs[1])!=1 || mxGetNumberOfElements(prhs[2])!=1)
+      mexErrMsgTxt("q and p must be scalars");
+    q=(mwSize)mxGetScalar(prhs[1]);
+    p=(mwSize)mxGetScalar(prhs[2]);
+    if (q<2) mexErrMsgTxt("q must be at least 2");
+    if (d<q-1 || d>q) mexErrMsgTxt("V must have q-1 or q columns");
+    // the grid has B[p+q-1,q-1] points; no larger coefficient is used
+    B=mxMalloc((p+q)*q*sizeof(double));
+    binomtable(B,p+q-1,q-1);
+    if (B[p+q-1+(q-1)*(p+q)]>MAXINDEX){
+      mxFree(B);
+      mexErrMsgTxt("Grid is too large");
+    }
+    ranksimplex(mxGetPr(prhs[0]),mxGetPr(plhs[0]),m,q,p,B);
+    mxFree(B);
+  }
+}
@@ -0,0 +1,161 @@
+#include "mex.h"
+#include <math.h>
+/*
+% gridunrank Points of a rectangular or simplex grid with given index numbers
+% USAGE
+%   D=gridunrank(ind,n);       % rectangular grid
+%   V=gridunrank(ind,q,p);     % simplex grid
+% INPUTS
+%   ind : m-vector of index values
+%   n   : d-vector of the number of values in each dimension
+%   q   : dimension of the simplex
+%   p   : number of subintervals in each dimension
+% OUTPUT
+%   D   : m x d matrix of positions (1 to n(i) in column i)
+%   V   : m x (q-1) matrix of non-negative integers summing to p or less
+%
+% gridunrank is the inverse of gridrank. For a rectangular grid
+% rectgrid(s{1},...,s{d}) row ind has s{i}(D(:,i)) in column i. For a
+% simplex grid V is equal to row ind of simplexgrid(q,p,p,0).
+% Index values that are not integers between 1 and the number of grid
+% points produce rows of NaNs.
+%
+% The work is O(d) per point for rectangular grids and O(q log p) per
+% point for simplex grids; no grid is created. Rows are processed in
+% parallel when compiled with OpenMP.
+%
+% Used by implicitgrid.
+%
+% Coded as a MEX file
+*/
+
+// minimum number of rows for multi-threading
+#define MINPARALLEL 10000
+
+// largest index that can be represented exactly as a double
+#define MAXINDEX 9007199254740992.0
+
+/* positions of the points of a rectangular grid (D is m x d) */
+void unrankrect(const double *ind, const double *n, double *D,
+                mwSize m, mwSize d, double total)
+{
+  mwSignedIndex k;
+  const double nan=mxGetNaN();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m>MINPARALLEL)
+#endif
+  for (k=0; k<(mwSignedIndex)m; k++){
+    double r=ind[k], q;
+    mwSignedIndex i;
+    if (r<1 || r>total || r!=floor(r)){
+      for (i=0; i<(mwSignedIndex)d; i++) D[k+i*m]=nan;
+      continue;
+    }
+    r-=1;
+    // the last dimension changes fastest
+    for (i=(mwSignedIndex)d-1; i>=0; i--){
+      q=floor(r/n[i]);
+      D[k+i*m]=r-q*n[i]+1;
+      r=q;
+    }
+  }
+}
+
+/* binomial coefficients B[a+b*(amax+1)]=a choose b for a<=amax, b<=bmax */
+void binomtable(double *B, mwSize amax, mwSize bmax)
+{
+  mwIndex a, b, a1=amax+1;
+  for (a=0; a<=amax; a++){
+    B[a]=1;
+    for (b=1; b<=bmax; b++){
+      if (a==0) B[a+b*a1]=0;
+      else      B[a+b*a1]=B[a-1+(b-1)*a1]+B[a-1+b*a1];
+    }
+  }
+}
+
+/* points of a simplex grid (V is m x q-1) */
+void unranksimplex(const double *ind, double *V, mwSize m, mwSize q,
+                   mwSize p, const double *B)
+{
+  mwSignedIndex k;
+  mwSize q1=q-1, a1=p+q;
+  double total=B[p+q1+q1*a1];
+  const double nan=mxGetNaN();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m>MINPARALLEL)
+#endif
+  for (k=0; k<(mwSignedIndex)m; k++){
+    double s=ind[k], c;
+    mwIndex i, L, r, lo, hi, t;
+    if (s<1 || s>total || s!=floor(s)){
+      for (i=0; i<q1; i++) V[k+i*m]=nan;
+      continue;
+    }
+    s-=1;
+    r=p;
+    for (i=0; i<q1; i++){
+      // B[r+L,L]-B[r-t+L,L] points have a value smaller than t in
+      // column i; find the largest t with no more than s such points
+      L=q1-i;
+      c=B[r+L+L*a1];
+      lo=0; hi=r;
+      while (lo<hi){
+        t=(lo+hi+1)/2;
+        if (c-B[r-t+L+L*a1]<=s) lo=t;
+        else                    hi=t-1;
+      }
+      s-=c-B[r-lo+L+L*a1];
+      V[k+i*m]=(double)lo;
+      r-=lo;
+    }
+  }
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  mwSize m, d, q, p, i;
+  double *B, *n, total;
+  int ii;
+
+  if (nrhs<2) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>3) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  for (ii=0; ii<nrhs; ii++){
+    if (!mxIsDouble(prhs[ii]) || mxIsSparse(prhs[ii]) || mxIsComplex(prhs[ii]))
+      mexErrMsgTxt("Inputs must be real full double arrays");
+  }
+  m=mxGetNumberOfElements(prhs[0]);
+
+  if (nrhs==2){
+    d=mxGetNumberOfElements(prhs[1]);
+    n=mxGetPr(prhs[1]);
+    total=1;
+    for (i=0; i<d; i++){
+      if (n[i]<1) mexErrMsgTxt("n must contain positive integers");
+      total*=n[i];
+    }
+    if (total>MAXINDEX) mexErrMsgTxt("Grid is too large");
+    plhs[0]=mxCreateDoubleMatrix(m,d,mxREAL);
+    unrankrect(mxGetPr(prhs[0]),n,mxGetPr(plhs[0]),m,d,total);
+  }
+  else{
+    if (mxGetNumberOfElements(prhs[1])!=1 || mxGetNumberOfElements(prhs[2])!=1)
+      mexErrMsgTxt("q and p must be scalars");
+    q=(mwSize)mxGetScalar(prhs[1]);
+    p=(mwSize)mxGetScalar(prhs[2]);
+    if (q<2) mexErrMsgTxt("q must be at least 2");
+    // the grid has B[p+q-1,q-1] points; no larger coefficient is used
+    B=mxMalloc((p+q)*q*sizeof(double));
+    binomtable(B,p+q-1,q-1);
+    if (B[p+q-1+(q-1)*(p+q)]>MAXINDEX){
+      mxFree(B);
+      mexErrMsgTxt("Grid is too large");
+    }
+    plhs[0]=mxCreateDoubleMatrix(m,q-1,mxREAL);
+    unranksimplex(mxGetPr(prhs[0]),mxGetPr(plhs[0]),m,q,p,B);
+    mxFree(B);
+  }
+}
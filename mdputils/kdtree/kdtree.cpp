@@ -4,479 +4,508 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <float.h>
+#include <algorithm>
 
-int (*KDTree::logmsg)(const char *,...)=printf;
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-KDTree::KDTree()
-{
-  workArr = (int *) NULL;
-  copyPoints = false;
-  points = (float *)NULL;
-	pntsInRange = (int *)0;
-	nodeMem = (struct _Node *)0;
-	nodeMemCnt = 0;
-	nodeMemAlloc = true;
-	intArrMem = (int *)0;
-	intArrMemCnt = 0;
-	verbosity=0;
-  return;
-}				// end of constructor
+// Arrays in the serialized block are aligned on 32 byte boundaries
+#define KDTREE_ALIGN(x) (((x) + 31) & ~((size_t)31))
 
-KDTree::KDTree(float *setpoints, int N, int setndim)
-{
-  KDTree();
-  create(setpoints, N, setndim);
-  return;
-}	 // end of constructor
+template <class T> int (*KDTree<T>::logmsg)(const char *,...)=printf;
+
+template <class T> static int precision_code();
+template <> int precision_code<float>() { return KDTREE_SINGLE; }
+template <> int precision_code<double>() { return KDTREE_DOUBLE; }
 
+template <class T> static T max_value();
+template <> float max_value<float>() { return FLT_MAX; }
+template <> double max_value<double>() { return DBL_MAX; }
 
-// Note: this is copied almost verbatim from the heapsort 
-// wiki page: http://en.wikipedia.org/wiki/Heapsort 
-// 11/9/05
-int KDTree::heapsort(int dim, int *idx, int len)
+
+int kdtree_precision(const void *mem)
 {
-  unsigned int n = len,i=len/2,parent,child;
-  int t;
+  const struct _KDTreeHeader *h = (const struct _KDTreeHeader *)mem;
+  if (h->magic != KDTREE_MAGIC || h->version != KDTREE_VERSION)
+    return 0;
+  return h->precision;
+} // end of kdtree_precision
 
-  for(;;) {
-    if(i>0) {
-      i--;
-      t = idx[i];
-    }
-    else {
-      n--;
-      if(n ==0) return 0;
-      t  = idx[n];
-      idx[n] = idx[0];
-    }
-  
-    parent = i;
-    child = i*2+1;
-		
-    while(child < n) {
-      if((child +1 < n) &&
-				 (points[(idx[child+1])*ndim+dim] > 
-					points[idx[child]*ndim + dim])) {
-				child++;
-      }
-      if(points[idx[child]*ndim+dim] > points[t*ndim+dim]) {
-				idx[parent] = idx[child];
-				parent = child;
-				child = parent*2+1;
-      }
-      else {
-				break;
-      }
-    }
-    idx[parent] = t;
-  } // end of for loop
-  return 0;
-} // end of heapsort
 
-      
-  
-KDTree::~KDTree()
+// Number of leaves needed so that no bucket holds more than
+// bucketSize points (always a power of 2)
+static int get_nleaves(int npoints, int bucketSize)
 {
-  if (workArr)
-    delete[]workArr;
-  if (copyPoints && points) {
-    // Delete the 1-D array of data
-    // Delete the pointer to the points
-    delete[] points;
-  }
-	if(pntsInRange) delete[] pntsInRange;
-	if(nodeMem && nodeMemAlloc) delete[] nodeMem;
+  int nleaves = 1;
+  while ((npoints + nleaves - 1)/nleaves > bucketSize)
+    nleaves *= 2;
+  return nleaves;
+} // end of get_nleaves
+
+// Offsets of the arrays within a serialized tree
+static size_t get_offsets(int npoints, int ndim, int nleaves,
+                          int bucketSize, size_t tsize, size_t *off)
+{
+  size_t len = KDTREE_ALIGN(sizeof(struct _KDTreeHeader));
+  off[0] = len;  len = KDTREE_ALIGN(len + tsize*(nleaves-1));        // keys
+  off[1] = len;  len = KDTREE_ALIGN(len + sizeof(int)*(nleaves-1));  // splitDim
+  off[2] = len;  len = KDTREE_ALIGN(len + sizeof(int)*(nleaves+1));  // leafStart
+  off[3] = len;  len = KDTREE_ALIGN(len + sizeof(int)*npoints);      // perm
+  off[4] = len;  len = KDTREE_ALIGN(len + sizeof(int)*npoints);      // loc
+  off[5] = len;  len = len + tsize*(size_t)nleaves*ndim*bucketSize;  // coords
+  return len;
+} // end of get_offsets
+
+
+template <class T> KDTree<T>::KDTree()
+{
+  ndim = 0;
+  npoints = 0;
+  nleaves = 0;
+  bucketSize = 0;
+  pntsInRange = (int *)0;
+  nPntsInRange = 0;
+  mem = (char *)0;
+  memAlloc = false;
+  verbosity = 0;
+  return;
+}				// end of constructor
+
+template <class T> KDTree<T>::~KDTree()
+{
+  if (pntsInRange) delete[] pntsInRange;
+  if (mem && memAlloc) delete[] mem;
   return;
 }				// end of destructor
 
-int KDTree::get_serialize_length(int snpnts, int sdim)
+
+template <class T>
+size_t KDTree<T>::get_serialize_length(int snpnts, int sdim,
+                                       int setBucketSize)
 {
-	return
-		// The data points to be copied
-		snpnts*sdim*sizeof(float)+
-      // The header information (8 bytes only)
-		sizeof(int)*2+
-      // The tree has twice as many nodes as points
-		(snpnts*2*(sizeof(struct _Node)));
+  size_t off[6];
+  if (setBucketSize < 1) setBucketSize = 1;
+  if (setBucketSize > KDTREE_MAXBUCKET) setBucketSize = KDTREE_MAXBUCKET;
+  int nl = get_nleaves(snpnts, setBucketSize);
+  return get_offsets(snpnts, sdim, nl, (snpnts + nl - 1)/nl,
+                     sizeof(T), off);
 } // end of get_serialize_length
 
 
-KDTree *KDTree::unserialize(void *mem)
+// Set the array pointers from the header of a serialized tree
+template <class T> int KDTree<T>::set_pointers(void *setmem)
 {
+  size_t off[6];
+  struct _KDTreeHeader *h = (struct _KDTreeHeader *)setmem;
+  mem = (char *)setmem;
+  npoints = h->npoints;
+  ndim = h->ndim;
+  nleaves = h->nleaves;
+  bucketSize = h->bucketSize;
+  get_offsets(npoints, ndim, nleaves, bucketSize, sizeof(T), off);
+  keys = (T *)(mem + off[0]);
+  splitDim = (int *)(mem + off[1]);
+  leafStart = (int *)(mem + off[2]);
+  perm = (int *)(mem + off[3]);
+  loc = (int *)(mem + off[4]);
+  coords = (T *)(mem + off[5]);
+  return 0;
+} // end of set_pointers
 
-	char *cmem = (char *)mem;
-	KDTree *kdtree = new KDTree;
-	kdtree->npoints = ((int *)mem)[0];
-	kdtree->ndim = ((int *)mem)[1];
-	kdtree->points = (float *)(cmem+sizeof(int)*2);
-	kdtree->nodeMem = (struct _Node *)		
-		(cmem+sizeof(int)*2+sizeof(float)*kdtree->ndim*kdtree->npoints);
-	kdtree->nodeMemAlloc = false;
-	kdtree->copyPoints = false;
-	return kdtree;
-} // end of unserialize
 
-struct _Node *KDTree::node_alloc()
+template <class T> KDTree<T> *KDTree<T>::unserialize(void *mem)
 {
-	nodeMemCnt++;
-	if(nodeMemCnt > npoints*2)
-		return (struct _Node *)0;
-	return (struct _Node *)(nodeMem+nodeMemCnt-1);
-} // end of node_alloc
-
-int KDTree::create(float *setpoints, int setnpoints, int setndim,
-									 void *mem)
+  if (kdtree_precision(mem) != precision_code<T>())
+    return (KDTree<T> *)0;
+  KDTree<T> *kdtree = new KDTree<T>;
+  kdtree->set_pointers(mem);
+  kdtree->memAlloc = false;
+  return kdtree;
+} // end of unserialize
+
+
+template <class T>
+int KDTree<T>::create(const T *setpoints, int setnpoints, int setndim,
+                      bool colMajor, int setBucketSize)
 {
-	char *cmem = (char *)mem;
-	((int *)mem)[0] = setnpoints;
-	((int *)mem)[1] = setndim;
-	for(int i=0;i<setnpoints*setndim;i++)
-		((float *)mem)[i+2] = setpoints[i];
-	//memcpy(cmem+sizeof(int)*2,setpoints,sizeof(float)*setnpoints*setndim);
-	return
-		create((float *)(cmem+sizeof(int)*2),
-					 setnpoints,setndim,false,
-					 (struct _Node *)
-					 (cmem+sizeof(int)*2+sizeof(float)*setnpoints*setndim));
+  if (setnpoints < 1 || setndim < 1) return -1;
+  size_t len = get_serialize_length(setnpoints, setndim, setBucketSize);
+  char *newmem = new char[len];
+  int ret = create(setpoints, setnpoints, setndim, newmem, colMajor,
+                   setBucketSize);
+  memAlloc = true;
+  return ret;
 } // end of create
 
+
+// Compares two points on a single dimension of the input array
+template <class T> struct _PointLess {
+  const T *pnts;
+  size_t stride, dstride;
+  bool operator()(int a, int b) const {
+    return pnts[a*stride+dstride] < pnts[b*stride+dstride];
+  }
+};
+
 // This function creates a KD tree with the given
 // points, array, and length
-int KDTree::create(float *setpoints, int setnpoints, int setndim,
-									 bool setCopy, struct _Node *setNodeMem)
+template <class T>
+int KDTree<T>::create(const T *setpoints, int setnpoints, int setndim,
+                      void *setmem, bool colMajor, int setBucketSize)
 {
-  ndim = setndim;
-  npoints = setnpoints;
-  typedef int *intptr;
-	
-  // Copy the points from the original array, if necessary
-  copyPoints = setCopy;
-  if (copyPoints) {
-    if(points) delete[] points;
-    points = new float[ndim*npoints];
-    memcpy(points,setpoints,sizeof(float)*ndim*npoints);
-  }
-  // If we are not copying, just set the pointer
-  else
-    points = setpoints;
-
-
-  // Allocate some arrays;
-  if (workArr)
-    delete[]workArr;
-  workArr = new int[npoints];
-
-	if(!setNodeMem) {
-		if(nodeMem) delete[] nodeMem;
-		nodeMem = new struct _Node[npoints*2+1];
-		nodeMemAlloc = true;
-	}
-	else {
-		nodeMem = setNodeMem;
-		nodeMemAlloc = false;
-	}
-	nodeMemCnt = 0;
-
-	// Alocate array used for indexing
-	if(intArrMem) delete[] intArrMem;
-	intArrMem = 
-		new int[(int)((float)(npoints+4)*
-									ceil(log((double)npoints)/log(2.0)))];
-	intArrMemCnt = 0;
-
-  // Create the "sortidx" array by 
-  // sorting the range tree points on each dimension
-  int **sortidx = new intptr[ndim];
-	if(verbosity>1)
-		logmsg("KDTree: Sorting points\n");
-  for (int i = 0; i < ndim; i++) {
-    // Initialize the sortidx array for this
-    // dimension
-    sortidx[i] = new int[npoints];
-
-    // Initialize the "tmp" array for the sort
-    int *tmp = new int[npoints];
-    for (int j = 0; j < npoints; j++)
-      tmp[j] = j;
-
-    // Sort the points on dimension i, putting
-    // indexes in array "tmp"
-    heapsort(i,tmp,npoints);
-
-    // sortidx is actually the inverse of the 
-    // index sorts
-    for (int j = 0; j < npoints; j++)
-      sortidx[i][tmp[j]] = j;
-
-    delete[] tmp;
-  }
-	if(verbosity > 1)
-		logmsg("KDTree: Done sorting points\n");
+  if (mem && memAlloc) delete[] mem;
+  memAlloc = false;
+  if (setnpoints < 1 || setndim < 1) return -1;
+  if (setBucketSize < 1) setBucketSize = 1;
+  if (setBucketSize > KDTREE_MAXBUCKET) setBucketSize = KDTREE_MAXBUCKET;
+
+  int nl = get_nleaves(setnpoints, setBucketSize);
+  struct _KDTreeHeader *h = (struct _KDTreeHeader *)setmem;
+  memset(h, 0, sizeof(struct _KDTreeHeader));
+  h->magic = KDTREE_MAGIC;
+  h->version = KDTREE_VERSION;
+  h->precision = precision_code<T>();
+  h->npoints = setnpoints;
+  h->ndim = setndim;
+  h->nleaves = nl;
+  h->bucketSize = (setnpoints + nl - 1)/nl;
+  set_pointers(setmem);
+
+  if(verbosity>1)
+    logmsg("KDTree: Building tree with %d leaves\n",nleaves);
 
-  // Create an initial list of points that references 
-  // all the points
-  int *pidx = new int[npoints];
   for (int i = 0; i < npoints; i++)
-    pidx[i] = i;
-
-  // Build a KD Tree
-  build_kdtree(sortidx,	// array of sort values
-							 0,	// The current dimension
-							 pidx, npoints);	// The list of points
-  // Delete the sort index
-  for (int i = 0; i < ndim; i++)
-    delete[]sortidx[i];
-  delete[] sortidx;
-
-  // Delete the initial list of points
-  delete[] pidx;
-
-	// Delete the sort arrays
-	delete[] intArrMem;
-
-	// delete the work array
-  if(workArr) {
-    delete[] workArr;
-    workArr = (int *)NULL;
+    perm[i] = i;
+  build(setpoints, colMajor, 0, 0, npoints);
+  leafStart[nleaves] = npoints;
+
+  // Copy the points into the leaf buckets; unused slots are
+  // filled with the last point in the bucket
+  for (int leaf = 0; leaf < nleaves; leaf++) {
+    int cnt = leafStart[leaf+1] - leafStart[leaf];
+    T *c = coords + (size_t)leaf*ndim*bucketSize;
+    for (int j = 0; j < bucketSize; j++) {
+      if (cnt == 0) {
+        for (int i = 0; i < ndim; i++) c[i*bucketSize+j] = 0;
+        continue;
+      }
+      int p = perm[leafStart[leaf] + (j < cnt ? j : cnt-1)];
+      for (int i = 0; i < ndim; i++)
+        c[i*bucketSize+j] = colMajor ?
+          setpoints[(size_t)i*npoints+p] : setpoints[(size_t)p*ndim+i];
+      if (j < cnt) loc[p] = leaf*bucketSize + j;
+    }
   }
 
-	if(verbosity > 1)
-		logmsg("KDTree: Done creating tree\n");
+  if(verbosity > 1)
+    logmsg("KDTree: Done creating tree\n");
   return 0;
-}				// end of create      
+}				// end of create
 
 
-int *KDTree::int_alloc(int len)
-{
-	if(!intArrMem) return (int *)0;
-	int *ret = intArrMem+intArrMemCnt;
-	intArrMemCnt += len;
-	return ret;
-} // end of int_alloc
-
-
-// This function build a node of the kdtree with the
-// points indexed by pidx with length "len"
-// sortidx is a pre-computed array using the heapsort
-// algorithm above
-int KDTree::build_kdtree(int **sortidx, int dim,
-                                   int *pidx, int len)
+// This function builds node nodeIdx of the kdtree with the points
+// in positions lo to hi-1 of perm.  The points are split at the
+// median of the dimension with the largest spread.
+template <class T>
+int KDTree<T>::build(const T *pnts, bool colMajor, int nodeIdx,
+                     int lo, int hi)
 {
-	int ncnt = nodeMemCnt;
-  struct _Node *node = node_alloc();
-
-  if (len == 1) {
-    node->leftIdx = -1;
-    node->rightIdx = -1;
-    node->pntidx = pidx[0];
-    node->key = 0;
-    return ncnt;
-  }
-  
-  // If not, we must make a node
-  int pivot = -1;
-  int lcnt = 0, rcnt = 0;
-	int *larray, *rarray;
-
-  // Find the pivot (index of median point of available
-  // points on current dimension).
-
-	// If heapsorting the current list of points is quicker than
-	// iterating through all the points, just do that instead 
-	// (heapsort if of order n*log(n)
-	// This test could probably use some fine tuning
-	if((double)len*log((double)len) < npoints) {
-		heapsort(dim,pidx,len);
-		larray = pidx;
-		rarray = pidx+len/2;
-		pivot = pidx[len/2];
-		lcnt = len/2;
-		rcnt = len/2 + (len%2==0 ? 0 : 1);
-	}
-	else {
-		// Use the previously calculated sort index
-		// to make this a process linear in npoints
-		// This gets a little confusing, but it works.
-		// Sortidx:: sortidx[dim][idx] = val 
-		// idx = the index to the point
-		// val = the order in the array
-		int *parray = workArr;
-		
-		// Setting parray to -1 indicates we are not using 
-		// the point
-		for (int i = 0; i < npoints; i++)
-			parray[i] = -1;
-		// Populate "parray" with the points that we
-		// are using, indexed in the order they occur
-		// on the current dimension
-		for (int i = 0; i < len; i++)
-			parray[sortidx[dim][pidx[i]]] = pidx[i];
-		int cnt = 0;
-		larray = int_alloc(len/2+1);
-		rarray = int_alloc(len/2+1);
-		
-		// The middle valid value of parray is the pivot,
-		// the left go to a node on the left, the right
-		// go to a node on the right.
-		for (int i = 0; i < npoints; i++) {
-			if (parray[i] == -1)
-				continue;
-			if (cnt == len / 2) {
-				pivot = parray[i];
-				rarray[rcnt++] = parray[i];
-			} else if (cnt > len / 2)
-				rarray[rcnt++] = parray[i];
-			else
-				larray[lcnt++] = parray[i];
-			cnt++;
-			if(cnt>len)
-				break;
-		}
-	}
-
-  // Create the node
-  node->pntidx = -1;
-  node->key = points[pivot*ndim+dim];
-  // Create nodes to the left
-	node->leftIdx = 
-		build_kdtree(sortidx, (dim + 1) % ndim, larray, lcnt);
-	
-	// Create nodes to the right
-	node->rightIdx = 
-		build_kdtree(sortidx, (dim + 1) % ndim, rarray, rcnt);
-
-  return ncnt;
-}				// end of build_kdtree
-
-
-// This function operates a search on a node for points within
-// the specified range.
-// It assumes the current node is at a depth corresponding to 
-// dimension "dim"
-int KDTree::range_search(int nodeIdx, Range * range, int dim)
-{
-  if (nodeIdx < 0)
+  if (nodeIdx >= nleaves-1) {
+    leafStart[nodeIdx-(nleaves-1)] = lo;
     return 0;
-	
-	struct _Node *node = nodeMem+nodeIdx;
-  // If this is a leaf node, check to see if the 
-  // data is in range.  If so, operate on it.
-  if (node->pntidx>=0) {
-    // Return if not in range
+  }
+
+  _PointLess<T> less;
+  less.pnts = pnts;
+  less.stride = colMajor ? 1 : ndim;
+  int dim = 0;
+  if (hi > lo) {
+    T maxspread = -1;
     for (int i = 0; i < ndim; i++) {
-			int idx = node->pntidx*ndim + i;
-      if (points[idx] < range[i][0] || points[idx] > range[i][1])
-				return 0;
+      size_t ds = colMajor ? (size_t)i*npoints : i;
+      T mn = pnts[perm[lo]*less.stride+ds], mx = mn;
+      for (int j = lo+1; j < hi; j++) {
+        T v = pnts[perm[j]*less.stride+ds];
+        if (v < mn) mn = v;
+        if (v > mx) mx = v;
+      }
+      if (mx - mn > maxspread) {
+        maxspread = mx - mn;
+        dim = i;
+      }
     }
-		pntsInRange[nPntsInRange++] = node->pntidx;
-    return 0;
   }
-  // Search left, if necessary
-  if (node->key >= range[dim][0])
-    range_search(node->leftIdx, range, (dim + 1) % ndim);
-  // Search right,if necessary
-  if (node->key <= range[dim][1])
-    range_search(node->rightIdx, range, (dim + 1) % ndim);
-  return 0;
-}				// end of range_search
+  less.dstride = colMajor ? (size_t)dim*npoints : dim;
 
-// This is the public function that will call the
-// function "opFunction" on all points in the array
-// within "range"
-int KDTree::get_points_in_range(Range * range)
-{
-	if(!pntsInRange) 
-		pntsInRange = new int[npoints];
-	nPntsInRange = 0;
+  int mid = lo + (hi-lo)/2;
+  splitDim[nodeIdx] = dim;
+  if (mid < hi) {
+    std::nth_element(perm+lo, perm+mid, perm+hi, less);
+    keys[nodeIdx] = pnts[perm[mid]*less.stride+less.dstride];
+  }
+  else
+    keys[nodeIdx] = 0;
 
-  range_search(0, range, 0);
+  build(pnts, colMajor, 2*nodeIdx+1, lo, mid);
+  build(pnts, colMajor, 2*nodeIdx+2, mid, hi);
   return 0;
-}				// end of operate_on_points
+}				// end of build
 
 
-int KDTree::closest_point(float *pnt, int &idx, bool approx)
+template <class T>
+inline int KDTree<T>::bucket_distsq(const T *pnt, int leaf, T *dist) const
 {
-  int dim = 0;
+  int cnt = leafStart[leaf+1] - leafStart[leaf];
+  const T *c = coords + (size_t)leaf*ndim*bucketSize;
+  for (int j = 0; j < bucketSize; j++)
+    dist[j] = 0;
+  for (int i = 0; i < ndim; i++, c += bucketSize) {
+    T p = pnt[i];
+    for (int j = 0; j < bucketSize; j++) {
+      T d = c[j] - p;
+      dist[j] += d*d;
+    }
+  }
+  return cnt;
+}				// end of bucket_distsq
 
-  // First, iterate along the path to the point, 
-  // and find the one associated with this point
-  // on the line
-	struct _Node *n = nodeMem;
-  idx = -1;
-  for (;;) {
-    // Is this a leaf node
-    if (n->pntidx >= 0) {
-      idx = n->pntidx;
-      break;
+
+// Finds all points inside the range box
+template <class T> int KDTree<T>::get_points_in_range(const T *range)
+{
+  if(!pntsInRange)
+    pntsInRange = new int[npoints];
+  nPntsInRange = 0;
+
+  int stack[KDTREE_MAXDEPTH+1];
+  int stackLen = 0;
+  stack[stackLen++] = 0;
+  while (stackLen > 0) {
+    int nodeIdx = stack[--stackLen];
+    // Descend as long as only one side needs to be searched
+    while (nodeIdx < nleaves-1) {
+      int dim = splitDim[nodeIdx];
+      bool left = keys[nodeIdx] >= range[2*dim];
+      bool right = keys[nodeIdx] <= range[2*dim+1];
+      if (left && right) {
+        stack[stackLen++] = 2*nodeIdx+2;
+        nodeIdx = 2*nodeIdx+1;
+      }
+      else if (left) nodeIdx = 2*nodeIdx+1;
+      else nodeIdx = 2*nodeIdx+2;
+    }
+    int leaf = nodeIdx - (nleaves-1);
+    int cnt = leafStart[leaf+1] - leafStart[leaf];
+    const T *c = coords + (size_t)leaf*ndim*bucketSize;
+    for (int j = 0; j < cnt; j++) {
+      int i;
+      for (i = 0; i < ndim; i++) {
+        T v = c[i*bucketSize+j];
+        if (v < range[2*i] || v > range[2*i+1]) break;
+      }
+      if (i == ndim)
+        pntsInRange[nPntsInRange++] = perm[leafStart[leaf]+j];
     }
-    if (n->key > pnt[dim]) 
-			n = nodeMem + n->leftIdx;
-		else 
-				n = nodeMem + n->rightIdx;;
-    dim = (dim + 1) % ndim;
   }
-  // Are we getting an approximate value?
-  if(approx == true) return 0;
+  return 0;
+}				// end of get_points_in_range
 
-  float ndistsq = distsq(pnt,points+idx*ndim);
-	
-  // Search for possible other nearest neighbors
-  // by examining adjoining nodes whos children may
-  // be closer
-  check_border_distance(0, 0, pnt, ndistsq, idx);
 
+template <class T>
+int KDTree<T>::closest_point(const T *pnt, int &idx, bool approx) const
+{
+  T dist[KDTREE_MAXBUCKET];
+  int stackNode[KDTREE_MAXDEPTH+1];
+  T stackDist[KDTREE_MAXDEPTH+1];
+  int stackLen = 0;
+  T cdistsq = max_value<T>();
+  idx = -1;
+
+  stackNode[stackLen] = 0;
+  stackDist[stackLen++] = 0;
+  while (stackLen > 0) {
+    stackLen--;
+    if (stackDist[stackLen] >= cdistsq) continue;
+    int nodeIdx = stackNode[stackLen];
+
+    // Descend to a leaf, saving the far side of each split.
+    // The far side cannot hold a point closer than the
+    // distance to the splitting plane.
+    while (nodeIdx < nleaves-1) {
+      T diff = pnt[splitDim[nodeIdx]] - keys[nodeIdx];
+      stackDist[stackLen] = diff*diff;
+      if (diff < 0) {
+        stackNode[stackLen++] = 2*nodeIdx+2;
+        nodeIdx = 2*nodeIdx+1;
+      }
+      else {
+        stackNode[stackLen++] = 2*nodeIdx+1;
+        nodeIdx = 2*nodeIdx+2;
+      }
+    }
+    int leaf = nodeIdx - (nleaves-1);
+    int cnt = bucket_distsq(pnt, leaf, dist);
+    for (int j = 0; j < cnt; j++) {
+      if (dist[j] < cdistsq) {
+        cdistsq = dist[j];
+        idx = perm[leafStart[leaf]+j];
+      }
+    }
+    // Are we getting an approximate value?
+    if (approx && idx >= 0) break;
+  }
   return 0;
 }				// end of closest_point
 
-int KDTree::check_border_distance(int nodeIdx, int dim,
-				  float *pnt, float &cdistsq, int &idx)
+
+template <class T> KNNWork<T>::KNNWork(int setk)
+{
+  k = setk;
+  nfound = 0;
+  heapIdx = new int[k];
+  heapDist = new T[k];
+  stackLen = 0;
+  return;
+}				// end of constructor
+
+template <class T> KNNWork<T>::~KNNWork()
 {
-	if(nodeIdx < 0) return 0;
-
-  // Are we at a closer leaf node?  
-  // If so, check the distance
-	struct _Node *node = nodeMem+nodeIdx;
-  if (node->pntidx >= 0) {
-    float dsq = distsq(pnt, points+node->pntidx*ndim);
-    if (dsq < cdistsq) {
-      cdistsq = dsq;
-      idx = node->pntidx;
+  delete[] heapIdx;
+  delete[] heapDist;
+  return;
+}				// end of destructor
+
+
+template <class T>
+int KDTree<T>::k_nearest(const T *pnt, int k, int *idx, T *dsq,
+                         KNNWork<T> *work) const
+{
+  if (k <= 0) return 0;
+  bool ownWork = (work == (KNNWork<T> *)0 || work->k < k);
+  if (ownWork) work = new KNNWork<T>(k);
+
+  T dist[KDTREE_MAXBUCKET];
+  int *hidx = work->heapIdx;
+  T *hdist = work->heapDist;
+  int nfound = 0;
+  int stackLen = 0;
+  work->stackNode[stackLen] = 0;
+  work->stackDist[stackLen++] = 0;
+
+  while (stackLen > 0) {
+    stackLen--;
+    if (nfound == k && work->stackDist[stackLen] >= hdist[0])
+      continue;
+    int nodeIdx = work->stackNode[stackLen];
+
+    // Descend to a leaf, saving the far side of each split
+    while (nodeIdx < nleaves-1) {
+      T diff = pnt[splitDim[nodeIdx]] - keys[nodeIdx];
+      work->stackDist[stackLen] = diff*diff;
+      if (diff < 0) {
+        work->stackNode[stackLen++] = 2*nodeIdx+2;
+        nodeIdx = 2*nodeIdx+1;
+      }
+      else {
+        work->stackNode[stackLen++] = 2*nodeIdx+1;
+        nodeIdx = 2*nodeIdx+2;
+      }
+    }
+
+    int leaf = nodeIdx - (nleaves-1);
+    int cnt = bucket_distsq(pnt, leaf, dist);
+    for (int j = 0; j < cnt; j++) {
+      T d = dist[j];
+      int p = perm[leafStart[leaf]+j];
+      int i, child;
+      if (nfound < k) {
+        // heap is not full - sift the new point up
+        i = nfound++;
+        while (i > 0 && hdist[(i-1)/2] < d) {
+          hdist[i] = hdist[(i-1)/2];
+          hidx[i] = hidx[(i-1)/2];
+          i = (i-1)/2;
+        }
+        hdist[i] = d;
+        hidx[i] = p;
+      }
+      else if (d < hdist[0]) {
+        // replace the farthest candidate and sift down
+        i = 0;
+        for (;;) {
+          child = 2*i+1;
+          if (child >= k) break;
+          if (child+1 < k && hdist[child+1] > hdist[child]) child++;
+          if (hdist[child] <= d) break;
+          hdist[i] = hdist[child];
+          hidx[i] = hidx[child];
+          i = child;
+        }
+        hdist[i] = d;
+        hidx[i] = p;
+      }
     }
-    return 0;
   }
 
-  // The distance squared along the current dimension between the
-  // point and the key
-  float ndistsq = 
-    (node->key - pnt[dim])*(node->key - pnt[dim]);
-
-  // If the distance squared from the key to the current value is 
-  // greater than the nearest distance, we need only look
-  // in one direction.
-  if (ndistsq > cdistsq) {
-    if (node->key > pnt[dim])
-      check_border_distance(node->leftIdx, (dim + 1) % ndim, pnt, cdistsq, idx);
-    else
-      check_border_distance(node->rightIdx, (dim + 1) % ndim, pnt, cdistsq, idx);
+  // Empty the heap into the outputs in order of increasing distance
+  for (int j = k-1; j >= nfound; j--) {
+    idx[j] = -1;
+    dsq[j] = max_value<T>();
   }
-  // If the distance from the key to the current value is 
-  // less than the nearest distance, we still need to look
-  // in both directions.
-  else {
-    check_border_distance(node->leftIdx, (dim + 1) % ndim, pnt, cdistsq, idx);
-    check_border_distance(node->rightIdx, (dim + 1) % ndim, pnt, cdistsq, idx);
+  for (int n = nfound; n > 0; n--) {
+    idx[n-1] = hidx[0];
+    dsq[n-1] = hdist[0];
+    T d = hdist[n-1];
+    int id = hidx[n-1];
+    int i = 0, child;
+    for (;;) {
+      child = 2*i+1;
+      if (child >= n-1) break;
+      if (child+1 < n-1 && hdist[child+1] > hdist[child]) child++;
+      if (hdist[child] <= d) break;
+      hdist[i] = hdist[child];
+      hidx[i] = hidx[child];
+      i = child;
+    }
+    hdist[i] = d;
+    hidx[i] = id;
   }
-  return 0;
-} // end of check_border_distance
+
+  work->nfound = nfound;
+  if (ownWork) delete work;
+  return nfound;
+}				// end of k_nearest
 
 
-inline float KDTree::distsq(float *pnt1, float *pnt2)
+template <class T>
+int KDTree<T>::k_nearest_batch(const T *pnts, int npnts, int k,
+                               int *idx, T *dsq, int nthreads) const
 {
-  float d = 0.0;
-  for (int i = 0; i < ndim; i++)
-    d += (pnt1[i] - pnt2[i]) * (pnt1[i] - pnt2[i]);
-  return d;
-}				// end if distsq
+  if (k <= 0) return 0;
+#ifdef _OPENMP
+  if (nthreads <= 0) nthreads = omp_get_max_threads();
+#pragma omp parallel num_threads(nthreads) if(npnts > 1000)
+#endif
+  {
+    // each thread has its own heap and search stack
+    KNNWork<T> work(k);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,256)
+#endif
+    for (int i = 0; i < npnts; i++)
+      k_nearest(pnts + (size_t)i*ndim, k, idx + (size_t)i*k,
+                dsq + (size_t)i*k, &work);
+  }
+  return 0;
+}				// end of k_nearest_batch
+
+
+template class KNNWork<float>;
+template class KNNWork<double>;
+template class KDTree<float>;
+template class KDTree<double>;
 
 
 #ifdef _TEST_
@@ -501,15 +530,15 @@ int main(int argc, char *argv[])
   int npoints = 150000;
   int ndim = 3;
   double t1,t2;
- 
+
   float *data = new float[npoints*ndim];
   for(int i=0;i<npoints*ndim;i++) {
     data[i] = (float)(rand())/(float)(RAND_MAX);
     data[i] = i;
   }
-  
+
   t1 = gettime();
-  KDTree *tree = new KDTree;
+  KDTree<float> *tree = new KDTree<float>;
   tree->create(data,npoints,ndim);
   t2 = gettime();
 
@@ -519,19 +548,19 @@ int main(int argc, char *argv[])
   int idx = 0;
 
   float pnts[1000][3];
-  for(int i=0;i<1000;i++) 
+  for(int i=0;i<1000;i++)
     for(int j=0;j<3;j++)
        pnts[i][j] = (float)rand()/(float)RAND_MAX;
 
   t1 = gettime();
   for(int i=0;i<1000;i++) {
     tree->closest_point(pnts[i],idx);
-  }  
+  }
   t2 = gettime();
 
   delete tree;
   delete[] data;
-    
+
   return 0;
 }				// end of main
 #endif
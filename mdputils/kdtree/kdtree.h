@@ -1,87 +1,153 @@
 #ifndef _KDTREE_H_
 #define _KDTREE_H_
 
-#pragma pack(1)
-struct _Node {
-  float key;
-  int pntidx;
-	int leftIdx;
-	int rightIdx;
+#include <stddef.h>
+
+// Serialized trees begin with a _KDTreeHeader.  The magic number
+// ("KDT2") distinguishes them from trees written by the original
+// pointer-based version of this class, which must be recreated.
+#define KDTREE_MAGIC   0x3254444b
+#define KDTREE_VERSION 2
+
+// Default and largest number of points held in a leaf bucket
+#define KDTREE_BUCKETSIZE 8
+#define KDTREE_MAXBUCKET  64
+
+// Largest tree depth supported (depth is log2 of the number of leaves)
+#define KDTREE_MAXDEPTH   40
+
+enum KDTreePrecision { KDTREE_SINGLE = 1, KDTREE_DOUBLE = 2 };
+
+struct _KDTreeHeader {
+  int magic;
+  int version;
+  int precision;
+  int npoints;
+  int ndim;
+  int nleaves;
+  int bucketSize;
+  int reserved;
 };
-#pragma pack()
 
+// Returns the precision (KDTREE_SINGLE or KDTREE_DOUBLE) of a
+// serialized tree or 0 if mem does not hold a valid tree
+int kdtree_precision(const void *mem);
 
-typedef float *Range;
-typedef int IRange[2];
 
-class KDTree {
+// Work space for the k-nearest neighbor search.  The search is
+// iterative and keeps its own stack of nodes still to be visited,
+// so a tree can be searched from several threads at once as long
+// as each thread has its own KNNWork.
+template <class T> class KNNWork {
 public:
-  KDTree(float *setpoints, int N, int setndim);
-  KDTree();
-
-   virtual ~ KDTree();
+  KNNWork(int setk);
+  ~KNNWork();
+
+  int k;
+  int nfound;
+  // bounded max-heap of the k best candidates found so far
+  int *heapIdx;
+  T *heapDist;
+
+  // stack of nodes still to be examined; the stack never holds
+  // more entries than the depth of the tree
+  int stackLen;
+  int stackNode[KDTREE_MAXDEPTH+1];
+  T stackDist[KDTREE_MAXDEPTH+1];
+};
 
-  int create(float *setpoints, int setnpoints, int setndim,
-						 bool setCopy = false, 
-						 struct _Node *setNodeMem = (struct _Node *)0);
-	int create(float *setpoints,int setnpoints,int setndim,
-						 void *mem);
 
+// The tree is stored in breadth-first (implicit) order: the children
+// of node i are nodes 2i+1 and 2i+2 so no child indices are stored.
+// Every leaf is at the same depth and holds a bucket of up to
+// bucketSize points.  The coordinates of the points in a bucket are
+// stored dimension by dimension so the distances to all the points
+// in a bucket are computed with unit-stride (vectorizable) loops.
+// All the arrays live in one contiguous block of memory which can be
+// stored in a MATLAB variable and searched in place.
+template <class T> class KDTree {
+public:
+  KDTree();
+  virtual ~KDTree();
+
+  // Build a tree from npoints points with ndim dimensions stored in
+  // setpoints.  Points are in row order (npoints X ndim, C style)
+  // unless colMajor is true (MATLAB style).  The second form builds
+  // the tree in mem, which must hold get_serialize_length() bytes.
+  int create(const T *setpoints, int setnpoints, int setndim,
+             bool colMajor = false,
+             int setBucketSize = KDTREE_BUCKETSIZE);
+  int create(const T *setpoints, int setnpoints, int setndim,
+             void *mem, bool colMajor = false,
+             int setBucketSize = KDTREE_BUCKETSIZE);
 
   int ndim;
   int npoints;
-  float *points;
 
-  // Search for the nearest neighbor to pnt and 
-  // return its index
-  int closest_point(float *pnt, int &idx, bool approx=false);
-
-	int get_points_in_range(Range *range);
-	int nPntsInRange;
-	int *pntsInRange;
-	
-
-  // Return distance squared between points
-  // between points
-  inline float distsq(float *pnt1, float *pnt2);
+  // Coordinate dim of point idx (idx refers to the original order)
+  inline T point(int idx, int dim) const {
+    size_t slot = loc[idx];
+    return coords[((slot/bucketSize)*ndim + dim)*bucketSize
+                  + slot%bucketSize];
+  }
 
-	// The following functions allow all the information in the class
+  // Search for the nearest neighbor to pnt and
+  // return its index
+  int closest_point(const T *pnt, int &idx, bool approx=false) const;
+
+  // Search for the k nearest neighbors to pnt.  On return
+  // idx and dsq (k-vectors) hold the indices and squared distances
+  // of the neighbors in order of increasing distance.  If the tree
+  // has fewer than k points the remaining slots are set to -1.
+  // Returns the number of neighbors found.
+  int k_nearest(const T *pnt, int k, int *idx, T *dsq,
+                KNNWork<T> *work=(KNNWork<T> *)0) const;
+
+  // Perform k_nearest on npnts points stored in row order in pnts
+  // (npnts X ndim).  Results are written in row order to idx and
+  // dsq (npnts X k).  The queries are split across nthreads threads
+  // when compiled with OpenMP (nthreads<=0 uses the default number).
+  int k_nearest_batch(const T *pnts, int npnts, int k, int *idx, T *dsq,
+                      int nthreads=0) const;
+
+  // Find all the points in the box range[2*i] <= x[i] <= range[2*i+1]
+  // The indices are placed in pntsInRange
+  int get_points_in_range(const T *range);
+  int nPntsInRange;
+  int *pntsInRange;
+
+  // The following functions allow all the information in the class
   // to be serialized and unserialized.  This is convenient, for example,
   // for writing the tree to a disk or to a MATLAB variable
-	static int get_serialize_length(int npoints,int ndim);
-						 
-						 
-  static KDTree *unserialize(void *mem);
-	
-	int set_verbosity(int v){verbosity=v;return 0;}
-	
+  static size_t get_serialize_length(int npoints, int ndim,
+                              int setBucketSize = KDTREE_BUCKETSIZE);
+  static KDTree<T> *unserialize(void *mem);
+
+  int set_verbosity(int v){verbosity=v;return 0;}
+
 protected:
 
-  // Do we copy the points or not
-  // if we do, this is where they go
-   bool copyPoints;
-
-  int check_border_distance(int nodeIdx, int dim,
-			    float *pnt, float &dist, int &idx);
-
-	int range_search(int nodeIdx, Range *range, int dim);
-  int heapsort(int dim, int *idx, int len);
-
-  int build_kdtree(int **sortidx, int dim, int *pidx, int len);
-  
-  int *workArr;
-	struct _Node *nodeMem;
-	int nodeMemCnt;
-	bool nodeMemAlloc;
-	struct _Node *node_alloc();
-
-	int *intArrMem;
-	int  intArrMemCnt;
-	int *int_alloc(int len);
-  
-	static int (*logmsg)(const char *,...);
-	int verbosity;
-  
+  int nleaves;
+  int bucketSize;
+
+  T *keys;        // split values of the nleaves-1 interior nodes
+  int *splitDim;  // split dimensions of the interior nodes
+  int *leafStart; // first position of each leaf (nleaves+1)
+  int *perm;      // original index of the point in each position
+  int *loc;       // bucket slot (leaf*bucketSize+j) of each point
+  T *coords;      // bucket coordinates (nleaves X ndim X bucketSize)
+
+  char *mem;
+  bool memAlloc;
+
+  int set_pointers(void *setmem);
+  int build(const T *pnts, bool colMajor, int nodeIdx, int lo, int hi);
+
+  // squared distances from pnt to the points in a leaf bucket
+  inline int bucket_distsq(const T *pnt, int leaf, T *dist) const;
+
+  static int (*logmsg)(const char *,...);
+  int verbosity;
 };
 
 #endif
@@ -9,7 +9,7 @@ MATDIR = C:\\Program Files\\MATLAB\\R2008a
 INCDIR = /I "." /I "../../src" -I "$(MATDIR)/extern/include" -I"../Libs/"
 CPP = cl
 CPPFLAGS = /c /Zp8 /GR /W3 /EHs /D_CRT_SECURE_NO_DEPRECATE /D_SCL_SECURE_NO_DEPRECATE \
-		 /D_SECURE_SCL=0 /DMATLAB_MEX_FILE /nologo /DWIN32
+		 /D_SECURE_SCL=0 /DMATLAB_MEX_FILE /nologo /DWIN32 /openmp
 #CPPFLAGS = /c /Zp8 /MD /GR /W3 /EHs /D_CRT_SECURE_NO_DEPRECATE /D_SCL_SECURE_NO_DEPRECATE \#
 #	#/D_SECURE_SCL=0 /DMATLAB_MEX_FILE /nologo /D "CPP_ACCEPT_EXPORTS" /D_USERDLL /D_WINDLL \
 #	/DUNICODE /D_UNICODE /DWIN32
@@ -39,7 +39,9 @@ CPPFLAGS = $(CPPFLAGS)  /O2 /Oy- /Fo"$(OUTDIR)" /DNDEBUG
 # Rules for making the targets
 TARGETS = $(OUTDIR)kdtree.mexw32 \
 	$(OUTDIR)kdtree_closestpoint.mexw32 \
-	$(OUTDIR)kdtree_range.mexw32
+	$(OUTDIR)kdtree_range.mexw32 \
+	$(OUTDIR)kdtree_knn.mexw32 \
+	$(OUTDIR)kdtree_scatbas.mexw32
 
 all: $(TARGETS)
 	@copy $(OUTDIR:/=\)*.mexw32 $(INSTDIR:/=\)
@@ -85,3 +87,13 @@ $(OUTDIR)kdtree_range.mexw32 : $(OUTDIR)kdtree.obj $(OUTDIR)kdtree_range.obj
 	$(LINK) $(OUTDIR)kdtree.obj $(OUTDIR)kdtree_range.obj \
 	$(LINKFLAGS) /PDB:"$(OUTDIR)kdtree_range.pdb" \
 	/OUT:"$(OUTDIR)kdtree_range.mexw32"
+
+$(OUTDIR)kdtree_knn.mexw32 : $(OUTDIR)kdtree.obj $(OUTDIR)kdtree_knn.obj
+	$(LINK) $(OUTDIR)kdtree.obj $(OUTDIR)kdtree_knn.obj \
+	$(LINKFLAGS) /PDB:"$(OUTDIR)kdtree_knn.pdb" \
+	/OUT:"$(OUTDIR)kdtree_knn.mexw32"
+
+$(OUTDIR)kdtree_scatbas.mexw32 : $(OUTDIR)kdtree.obj $(OUTDIR)kdtree_scatbas.obj
+	$(LINK) $(OUTDIR)kdtree.obj $(OUTDIR)kdtree_scatbas.obj \
+	$(LINKFLAGS) /PDB:"$(OUTDIR)kdtree_scatbas.pdb" \
+	/OUT:"$(OUTDIR)kdtree_scatbas.mexw32"
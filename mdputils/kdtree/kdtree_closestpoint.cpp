@@ -2,48 +2,32 @@
 #include <kdtree.h>
 #include <string.h>
 
-void mexFunction(int nlhs, mxArray * plhs[],
-		 int nrhs, const mxArray * prhs[])
+// Search the tree for the closest point to each row of pin.
+// T is the precision of the tree; the query points may be
+// single or double regardless of the tree precision.
+template <class T>
+static void closest(KDTree<T> *tree, int nlhs, mxArray *plhs[],
+                    const mxArray *pin)
 {
+  int npoints = (int) mxGetM(pin);
+  int ndim = tree->ndim;
 
-  if(mxIsClass(prhs[0],"kdtree")==0) {
-    mexPrintf("First argument must be a kdtree class\n");
-    return;
-  }
-  KDTree *tree = KDTree::unserialize(mxGetPr(mxGetFieldByNumber(prhs[0],0,0)));
-
-  // Verify the point array
-  if (mxGetNumberOfDimensions(prhs[1]) != 2) {
-    mexPrintf("Invalid point array passed in.\n");
-    return;
-  }
-  int npoints = (int) mxGetM(prhs[1]);
-  int ndim = (int) mxGetN(prhs[1]);
-  if (ndim != tree->ndim) {
-    mexPrintf("Points have wrong number of dimensions.\n");
-    mexPrintf("Tree dimension = %d\n",tree->ndim);
-    mexPrintf("Input array dimension = %d\n",ndim);
-    delete tree;
-    return;
-  }
   // Check the format of the input
   bool isDouble = false;
-  mxClassID id = mxGetClassID(prhs[1]);
+  mxClassID id = mxGetClassID(pin);
   double *dPtr = (double *)0;
   float  *sPtr = (float *)0;
   if (id == mxDOUBLE_CLASS) {
-    dPtr = (double *) mxGetPr(prhs[1]);
+    dPtr = (double *) mxGetPr(pin);
     isDouble = true;
   } else if (id == mxSINGLE_CLASS) {
-    sPtr = (float *) mxGetPr(prhs[1]);
+    sPtr = (float *) mxGetData(pin);
     isDouble = false;
   } else {
     mexPrintf("Input points must be either single or double\n");
-    delete tree;
     return;
   }
 
-
   // Create an output array of indices
   plhs[0] = mxCreateNumericMatrix(npoints, 1, mxDOUBLE_CLASS, mxREAL);
   double *idxptr = (double *) mxGetPr(plhs[0]);
@@ -59,23 +43,20 @@ void mexFunction(int nlhs, mxArray * plhs[],
     } else {
       plhs[1] =
 	  mxCreateNumericMatrix(npoints, ndim, mxSINGLE_CLASS, mxREAL);
-      fpntptr = (float *) mxGetPr(plhs[1]);
+      fpntptr = (float *) mxGetData(plhs[1]);
     }
   }
   // Allocate the point to check
-  float *curPoint = new float[ndim];
+  T *curPoint = new T[ndim];
   for (int i = 0; i < npoints; i++) {
     // Extract the point in the correct format
+    // MATLAB stores the transpose of the normal order
     if (isDouble) {
-      for (int j = 0; j < ndim; j++) {
-        // i*ndims+j
-        // j*npoints + i;
-        // MATLAB stores the transpose of the normal order
-         curPoint[j] = (float) dPtr[j * npoints + i];
-      }
+      for (int j = 0; j < ndim; j++)
+        curPoint[j] = (T) dPtr[(size_t)j * npoints + i];
     } else {
       for (int j = 0; j < ndim; j++) 
-        curPoint[j] = sPtr[j * npoints + i];
+        curPoint[j] = (T) sPtr[(size_t)j * npoints + i];
     }
 
     // Check the point
@@ -89,23 +70,65 @@ void mexFunction(int nlhs, mxArray * plhs[],
     idxptr[i] = (double) (idx + 1);
 
     // Then, the actual point -- if requested
-    if (nlhs > 1) {
-      if (isDouble) {
-          for (int j = 0; j < ndim; j++)
-            dpntptr[j * npoints + i] = tree->points[idx*tree->ndim+j];
-      } 
-      else {
-        for (int j = 0; j < ndim; j++)
-          fpntptr[j * npoints + i] = tree->points[idx*tree->ndim+j];
-      }
+    if (dpntptr) {
+      for (int j = 0; j < ndim; j++)
+        dpntptr[(size_t)j * npoints + i] = (double) tree->point(idx,j);
+    } 
+    else if (fpntptr) {
+      for (int j = 0; j < ndim; j++)
+        fpntptr[(size_t)j * npoints + i] = (float) tree->point(idx,j);
     }
   }
   // Deallocate the point to check
-  delete curPoint;
-  
-  // Get rid of the tree
-  // (This doesn't delete the serialized data)
-  delete tree;
+  delete[] curPoint;
+} // end of closest
+
+void mexFunction(int nlhs, mxArray * plhs[],
+		 int nrhs, const mxArray * prhs[])
+{
+
+  if (nrhs < 2) {
+    mexPrintf("Must pass in a tree and a list of points\n");
+    return;
+  }
+  if(mxIsClass(prhs[0],"kdtree")==0) {
+    mexPrintf("First argument must be a kdtree class\n");
+    return;
+  }
+  void *mem = mxGetData(mxGetFieldByNumber(prhs[0],0,0));
+  int precision = kdtree_precision(mem);
+  if (precision == 0) {
+    mexPrintf("Tree was created by an older version of kdtree;"
+              " recreate the tree\n");
+    return;
+  }
+
+  // Verify the point array
+  if (mxGetNumberOfDimensions(prhs[1]) != 2) {
+    mexPrintf("Invalid point array passed in.\n");
+    return;
+  }
+  int ndim = (int) mxGetN(prhs[1]);
+  int treedim = ((_KDTreeHeader *)mem)->ndim;
+  if (ndim != treedim) {
+    mexPrintf("Points have wrong number of dimensions.\n");
+    mexPrintf("Tree dimension = %d\n",treedim);
+    mexPrintf("Input array dimension = %d\n",ndim);
+    return;
+  }
+
+  // Get the tree; this doesn't copy the serialized data
+  // so deleting the tree leaves the MATLAB variable intact
+  if (precision == KDTREE_DOUBLE) {
+    KDTree<double> *tree = KDTree<double>::unserialize(mem);
+    closest(tree, nlhs, plhs, prhs[1]);
+    delete tree;
+  }
+  else {
+    KDTree<float> *tree = KDTree<float>::unserialize(mem);
+    closest(tree, nlhs, plhs, prhs[1]);
+    delete tree;
+  }
   return;
   
 } // end of kdtree_closestpoint
@@ -57,27 +57,41 @@ void mexFunction(int nlhs, mxArray * plhs[],
   // Extract info from the input array    
   int npoints = (int) mxGetM(prhs[0]);
   int ndim = (int) mxGetN(prhs[0]);
+  if (npoints < 1 || ndim < 1) {
+    mexPrintf("Input array must contain at least one point.\n");
+    return;
+  }
+  int bucketSize = KDTREE_BUCKETSIZE;
+  if (nrhs > 1)
+    bucketSize = (int) mxGetScalar(prhs[1]);
 
-  // First, taking the transpose
-  mxArray *prhst;
-  mexCallMATLAB(1, &prhst, 1, (mxArray **) prhs, "transpose");
-
-  // Convert to single precision if input is not
-  // already
-  if (!mxIsSingle(prhs[0])) {
-    mxArray *ptmp;
-    mexCallMATLAB(1, &ptmp, 1, &prhst, "single");
-    mxDestroyArray(prhst);
-    prhst = ptmp;
+  // Create the tree in a MATLAB variable
+  // The tree is built directly from MATLAB's column order storage.
+  // Single precision input gives a single precision tree; anything
+  // else is stored in double precision.
+  mxArray *tmp;
+  if (mxIsSingle(prhs[0])) {
+    KDTree<float> *tree = new KDTree<float>;
+    tmp = mxCreateNumericMatrix(
+            KDTree<float>::get_serialize_length(npoints,ndim,bucketSize),
+            1,mxUINT8_CLASS,mxREAL);
+    tree->create((float *)mxGetData(prhs[0]),npoints,ndim,mxGetData(tmp),
+                 true,bucketSize);
+    delete tree;
+  }
+  else {
+    mxArray *pdbl = (mxArray *)prhs[0];
+    if (!mxIsDouble(prhs[0]))
+      mexCallMATLAB(1, &pdbl, 1, (mxArray **) prhs, "double");
+    KDTree<double> *tree = new KDTree<double>;
+    tmp = mxCreateNumericMatrix(
+            KDTree<double>::get_serialize_length(npoints,ndim,bucketSize),
+            1,mxUINT8_CLASS,mxREAL);
+    tree->create(mxGetPr(pdbl),npoints,ndim,mxGetData(tmp),
+                 true,bucketSize);
+    delete tree;
+    if (pdbl != prhs[0]) mxDestroyArray(pdbl);
   }
-  
-  // Create the tree
-  KDTree *tree = new KDTree;
-	mxArray *tmp = mxCreateNumericMatrix(tree->get_serialize_length(npoints,ndim),
-																			 1,mxUINT8_CLASS,mxREAL);
-	// Create the tree
-	tree->create((float *)mxGetPr(prhst),npoints,ndim,mxGetPr(tmp));
-	mxDestroyArray(prhst);
  
   // Copy the serialized tree data to a new class
   plhs[0] = mxCreateStructMatrix(1,1,1,fieldNames);
@@ -85,10 +99,6 @@ void mexFunction(int nlhs, mxArray * plhs[],
  
   // Make the structure variable a class 
   make_class(&plhs[0],plhs[0]);
- 
-	// Delete our current incarnation of the tree
-	// (all the relevant data is stored in our serialized tpr variable)
-  delete tree;
   
   return;
 }				// end of mexFunction
@@ -0,0 +1,123 @@
+#include <mex.h>
+#include <kdtree.h>
+#include <string.h>
+#include <math.h>
+
+// Run the k nearest neighbor searches for the rows of pin.
+// T is the precision of the tree.
+template <class T>
+static void knn(KDTree<T> *tree, int nlhs, mxArray *plhs[],
+                const mxArray *pin, int k, int nthreads)
+{
+  int npoints = (int) mxGetM(pin);
+  int ndim = tree->ndim;
+
+  // Copy the points into row order in the tree precision
+  // MATLAB stores the transpose of the normal order
+  T *pnts = new T[(size_t)npoints*ndim];
+  mxClassID id = mxGetClassID(pin);
+  if (id == mxDOUBLE_CLASS) {
+    double *dPtr = (double *) mxGetPr(pin);
+    for (int i = 0; i < npoints; i++)
+      for (int j = 0; j < ndim; j++)
+        pnts[(size_t)i*ndim+j] = (T) dPtr[(size_t)j*npoints+i];
+  } else if (id == mxSINGLE_CLASS) {
+    float *sPtr = (float *) mxGetData(pin);
+    for (int i = 0; i < npoints; i++)
+      for (int j = 0; j < ndim; j++)
+        pnts[(size_t)i*ndim+j] = (T) sPtr[(size_t)j*npoints+i];
+  } else {
+    mexPrintf("Input points must be either single or double\n");
+    delete[] pnts;
+    return;
+  }
+
+  // Run the searches
+  int *idx = new int[(size_t)npoints*k];
+  T *dsq = new T[(size_t)npoints*k];
+  tree->k_nearest_batch(pnts, npoints, k, idx, dsq, nthreads);
+
+  // Create the outputs (npoints X k)
+  // adding 1 to the indices since MATLAB arrays are referenced to 1
+  // unused slots (k > number of tree points) are returned as 0 and inf
+  plhs[0] = mxCreateNumericMatrix(npoints, k, mxDOUBLE_CLASS, mxREAL);
+  double *idxptr = (double *) mxGetPr(plhs[0]);
+  double *distptr = (double *) 0;
+  if (nlhs > 1) {
+    plhs[1] = mxCreateNumericMatrix(npoints, k, mxDOUBLE_CLASS, mxREAL);
+    distptr = (double *) mxGetPr(plhs[1]);
+  }
+  for (int i = 0; i < npoints; i++) {
+    for (int j = 0; j < k; j++) {
+      size_t ij = (size_t)i*k+j;
+      idxptr[(size_t)j*npoints+i] = (double) (idx[ij] + 1);
+      if (distptr) {
+        if (idx[ij] < 0)
+          distptr[(size_t)j*npoints+i] = mxGetInf();
+        else
+          distptr[(size_t)j*npoints+i] = sqrt((double) dsq[ij]);
+      }
+    }
+  }
+
+  delete[] pnts;
+  delete[] idx;
+  delete[] dsq;
+} // end of knn
+
+void mexFunction(int nlhs, mxArray * plhs[],
+		 int nrhs, const mxArray * prhs[])
+{
+
+  if (nrhs < 3) {
+    mexPrintf("Must pass in a tree, a list of points and k\n");
+    return;
+  }
+  if(mxIsClass(prhs[0],"kdtree")==0) {
+    mexPrintf("First argument must be a kdtree class\n");
+    return;
+  }
+  void *mem = mxGetData(mxGetFieldByNumber(prhs[0],0,0));
+  int precision = kdtree_precision(mem);
+  if (precision == 0) {
+    mexPrintf("Tree was created by an older version of kdtree;"
+              " recreate the tree\n");
+    return;
+  }
+
+  // Verify the point array
+  if (mxGetNumberOfDimensions(prhs[1]) != 2) {
+    mexPrintf("Invalid point array passed in.\n");
+    return;
+  }
+  int ndim = (int) mxGetN(prhs[1]);
+  int treedim = ((_KDTreeHeader *)mem)->ndim;
+  if (ndim != treedim) {
+    mexPrintf("Points have wrong number of dimensions.\n");
+    mexPrintf("Tree dimension = %d\n",treedim);
+    mexPrintf("Input array dimension = %d\n",ndim);
+    return;
+  }
+  int k = (int) mxGetScalar(prhs[2]);
+  if (k < 1) {
+    mexPrintf("k must be a positive integer\n");
+    return;
+  }
+  int nthreads = 0;
+  if (nrhs > 3)
+    nthreads = (int) mxGetScalar(prhs[3]);
+
+  // Get the tree; this doesn't copy the serialized data
+  if (precision == KDTREE_DOUBLE) {
+    KDTree<double> *tree = KDTree<double>::unserialize(mem);
+    knn(tree, nlhs, plhs, prhs[1], k, nthreads);
+    delete tree;
+  }
+  else {
+    KDTree<float> *tree = KDTree<float>::unserialize(mem);
+    knn(tree, nlhs, plhs, prhs[1], k, nthreads);
+    delete tree;
+  }
+  return;
+
+} // end of kdtree_knn
@@ -5,51 +5,13 @@
 #include <string.h>
 
 
-void mexFunction(int nlhs, mxArray * plhs[], int nrhs,
-		 const mxArray * prhs[])
+// Find the points in each of the nRanges ranges stored in prange.
+// T is the precision of the tree.
+template <class T>
+static void range_search(KDTree<T> *tree, int nlhs, mxArray *plhs[],
+                         const mxArray *prange, int nRanges)
 {
-
-  int rangeDim;
-  int nRanges = 1;
-	KDTree *tree;
-
-  if (nrhs < 2) {
-    mexPrintf("Must pass in a tree and a list of ranges\n");
-    return;
-  }
-  
-  if(mxIsClass(prhs[0],"kdtree")==0) {
-    mexPrintf("First argument must be a kdtree class\n");
-    return;
-  }
-  tree = KDTree::unserialize(mxGetPr(mxGetFieldByNumber(prhs[0],0,0)));
-    
-  // Verify the point array
-  rangeDim = mxGetNumberOfDimensions(prhs[1]);
-  if(rangeDim < 2 || rangeDim > 3) {
-    mexPrintf("Invalid point array passed in.\n");
-    delete tree;
-    return;
-  }
-  if(rangeDim ==2) {
-    if ((int)mxGetM(prhs[1]) != tree->ndim || (int)mxGetN(prhs[1]) != 2) {
-      mexPrintf("Range input must have size (ndim , 2)\n");
-      delete tree;
-      return;
-    }
-    nRanges = 1;
-  }
-  else {
-    int dims[3];
-    memcpy(dims,mxGetDimensions(prhs[1]),sizeof(int)*3);
-    if(dims[1] != tree->ndim || dims[2] != 2) {
-      mexPrintf("Multple range input must have size (N,ndim,2)\n");
-      delete tree;
-      return;
-    }
-    nRanges = dims[0];
-  }
-  
+  int ndim = tree->ndim;
 
   // Create a cell array of outputs for the 
   // different input ranges, if there are more
@@ -60,15 +22,9 @@ void mexFunction(int nlhs, mxArray * plhs[], int nrhs,
       plhs[1] = mxCreateCellMatrix(nRanges,1);
   }
 
-
-  // Allocate memory for the ranges that will
-  // be passed into the tree iter function
-  Range *ranges = new Range[tree->ndim];
-  float *rdata = new float[tree->ndim*2];
-
-  // Set pointers for the array of ranges
-  for(int i=0;i<tree->ndim;i++) 
-    ranges[i] = rdata+i*2;
+  // Ranges passed to the tree are stored as lo,hi pairs
+  // for each dimension
+  T *rdata = new T[ndim*2];
 	
   // Iterate through all possible ranges
   for(int n=0;n<nRanges;n++) {    
@@ -77,33 +33,30 @@ void mexFunction(int nlhs, mxArray * plhs[], int nrhs,
     // of ranges -- the indexing is such that the data is in 
     // the "transposed" order from what one would normally 
     // expect in C -- hence the funny indexing
-    if (mxIsSingle(prhs[1])) {
-      float *tmp = (float *) mxGetPr(prhs[1]);
-      for(int i=0;i<tree->ndim;i++) {
-				rdata[i]  =  tmp[0*nRanges*tree->ndim + i*nRanges + n];
-				rdata[i+1] = tmp[1*nRanges*tree->ndim + i*nRanges + n];
+    if (mxIsSingle(prange)) {
+      float *tmp = (float *) mxGetData(prange);
+      for(int i=0;i<ndim;i++) {
+        rdata[2*i]   = (T) tmp[0*nRanges*ndim + i*nRanges + n];
+        rdata[2*i+1] = (T) tmp[1*nRanges*ndim + i*nRanges + n];
       }
     }
     // The input can be double precision too
-    else if (mxIsDouble(prhs[1])) {
-      double *tmp = (double *) mxGetPr(prhs[1]);
-      for(int i=0;i<tree->ndim;i++) {
-				rdata[2*i] = (float)
-					tmp[0*nRanges*tree->ndim + i*nRanges + n];
-				rdata[2*i+1] = (float)
-					tmp[1*nRanges*tree->ndim + i*nRanges + n];
+    else if (mxIsDouble(prange)) {
+      double *tmp = (double *) mxGetPr(prange);
+      for(int i=0;i<ndim;i++) {
+        rdata[2*i]   = (T) tmp[0*nRanges*ndim + i*nRanges + n];
+        rdata[2*i+1] = (T) tmp[1*nRanges*ndim + i*nRanges + n];
       }
     }
     // Input must be single or double precision
     else {
       mexPrintf("Input ranges must be single or double precision");
-      delete tree;
-      return;
+      break;
     }
 	 
     // Find the points within the input range
     // This part actually does all the work
-		tree->get_points_in_range(ranges);
+    tree->get_points_in_range(rdata);
 
     // Set the output array -- defaults to double format
     double *outPtr = (double *)0;
@@ -112,19 +65,19 @@ void mexFunction(int nlhs, mxArray * plhs[], int nrhs,
     mxOut = mxCreateDoubleMatrix(1,tree->nPntsInRange, mxREAL);
     outPtr = (double *) mxGetPr(mxOut);
     if(nlhs > 1) {
-      mxOut2 = mxCreateDoubleMatrix(tree->nPntsInRange,tree->ndim,mxREAL);
+      mxOut2 = mxCreateDoubleMatrix(tree->nPntsInRange,ndim,mxREAL);
       outPtr2 = (double *)mxGetPr(mxOut2);
     }
     // Populate the MATLAB arrays
     for (int i = 0; i < tree->nPntsInRange; i++) {
       outPtr[i] = (double) tree->pntsInRange[i] + 1;
       if(outPtr2) {
-				for (int j = 0; j < tree->ndim; j++) {
-					// Take the transpose because MATLAB stores data in 
-					// column major format
-					outPtr2[j * tree->nPntsInRange + i] = 
-						(double) tree->points[tree->pntsInRange[i] * tree->ndim + j];
-				}
+        for (int j = 0; j < ndim; j++) {
+          // Take the transpose because MATLAB stores data in 
+          // column major format
+          outPtr2[(size_t)j * tree->nPntsInRange + i] = 
+            (double) tree->point(tree->pntsInRange[i], j);
+        }
       }
     }
 		
@@ -133,24 +86,80 @@ void mexFunction(int nlhs, mxArray * plhs[], int nrhs,
     if(nRanges == 1) {
       plhs[0] = mxOut;
       if(nlhs > 1)
-				plhs[1] = mxOut2;
+        plhs[1] = mxOut2;
     }
     // Populate the cell array if there are more than one
     // set of input ranges
     else {
       mxSetCell(plhs[0],n,mxOut);
       if(nlhs > 1)
-				mxSetCell(plhs[1],n,mxOut2);
+        mxSetCell(plhs[1],n,mxOut2);
     }
 		
   } // end of iterating over ranges
-	
-  // Free old memory
-  if(tree)
-    delete tree;
 
-  delete[] ranges;
   delete[] rdata;
+} // end of range_search
+
+
+void mexFunction(int nlhs, mxArray * plhs[], int nrhs,
+		 const mxArray * prhs[])
+{
+
+  int rangeDim;
+  int nRanges = 1;
+
+  if (nrhs < 2) {
+    mexPrintf("Must pass in a tree and a list of ranges\n");
+    return;
+  }
+  
+  if(mxIsClass(prhs[0],"kdtree")==0) {
+    mexPrintf("First argument must be a kdtree class\n");
+    return;
+  }
+  void *mem = mxGetData(mxGetFieldByNumber(prhs[0],0,0));
+  int precision = kdtree_precision(mem);
+  if (precision == 0) {
+    mexPrintf("Tree was created by an older version of kdtree;"
+              " recreate the tree\n");
+    return;
+  }
+  int ndim = ((_KDTreeHeader *)mem)->ndim;
+    
+  // Verify the point array
+  rangeDim = (int) mxGetNumberOfDimensions(prhs[1]);
+  if(rangeDim < 2 || rangeDim > 3) {
+    mexPrintf("Invalid point array passed in.\n");
+    return;
+  }
+  if(rangeDim ==2) {
+    if ((int)mxGetM(prhs[1]) != ndim || (int)mxGetN(prhs[1]) != 2) {
+      mexPrintf("Range input must have size (ndim , 2)\n");
+      return;
+    }
+    nRanges = 1;
+  }
+  else {
+    const mwSize *dims = mxGetDimensions(prhs[1]);
+    if((int)dims[1] != ndim || dims[2] != 2) {
+      mexPrintf("Multple range input must have size (N,ndim,2)\n");
+      return;
+    }
+    nRanges = (int) dims[0];
+  }
+
+  // Get the tree; this doesn't copy the serialized data
+  if (precision == KDTREE_DOUBLE) {
+    KDTree<double> *tree = KDTree<double>::unserialize(mem);
+    range_search(tree, nlhs, plhs, prhs[1], nRanges);
+    delete tree;
+  }
+  else {
+    KDTree<float> *tree = KDTree<float>::unserialize(mem);
+    range_search(tree, nlhs, plhs, prhs[1], nRanges);
+    delete tree;
+  }
 
   // All done (whew!)
   return;
@@ -0,0 +1,154 @@
+#include <mex.h>
+#include <kdtree.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Form the (ntree X npoints) sparse inverse distance interpolation
+// matrix for the rows of pin using the k nearest tree points.
+// T is the precision of the tree.
+template <class T>
+static void scatbas(KDTree<T> *tree, mxArray *plhs[], const mxArray *pin,
+                    int k, double power, int nthreads)
+{
+  int npoints = (int) mxGetM(pin);
+  int ndim = tree->ndim;
+  if (k > tree->npoints) k = tree->npoints;
+
+  // Copy the points into row order in the tree precision
+  // MATLAB stores the transpose of the normal order
+  T *pnts = new T[(size_t)npoints*ndim];
+  mxClassID id = mxGetClassID(pin);
+  if (id == mxDOUBLE_CLASS) {
+    double *dPtr = (double *) mxGetPr(pin);
+    for (int i = 0; i < npoints; i++)
+      for (int j = 0; j < ndim; j++)
+        pnts[(size_t)i*ndim+j] = (T) dPtr[(size_t)j*npoints+i];
+  } else if (id == mxSINGLE_CLASS) {
+    float *sPtr = (float *) mxGetData(pin);
+    for (int i = 0; i < npoints; i++)
+      for (int j = 0; j < ndim; j++)
+        pnts[(size_t)i*ndim+j] = (T) sPtr[(size_t)j*npoints+i];
+  } else {
+    mexPrintf("Input points must be either single or double\n");
+    delete[] pnts;
+    return;
+  }
+
+  // Run the searches
+  int *idx = new int[(size_t)npoints*k];
+  T *dsq = new T[(size_t)npoints*k];
+  tree->k_nearest_batch(pnts, npoints, k, idx, dsq, nthreads);
+  delete[] pnts;
+
+  // Column pointers: a point that coincides with a tree point
+  // gets a single unit weight, all others get k weights
+  plhs[0] = mxCreateSparse(tree->npoints, npoints, 
+                           (mwSize)npoints*k > 0 ? (mwSize)npoints*k : 1,
+                           mxREAL);
+  mwIndex *jc = mxGetJc(plhs[0]);
+  jc[0] = 0;
+  for (int i = 0; i < npoints; i++)
+    jc[i+1] = jc[i] + (dsq[(size_t)i*k] == 0 ? 1 : k);
+
+  mwIndex *ir = mxGetIr(plhs[0]);
+  double *pr = mxGetPr(plhs[0]);
+  double halfpower = 0.5*power;
+#ifdef _OPENMP
+  if (nthreads <= 0) nthreads = omp_get_max_threads();
+#pragma omp parallel for num_threads(nthreads) schedule(static) \
+    if(npoints > 1000)
+#endif
+  for (int i = 0; i < npoints; i++) {
+    int *ii = idx + (size_t)i*k;
+    T *di = dsq + (size_t)i*k;
+    mwIndex start = jc[i];
+    if (di[0] == 0) {
+      ir[start] = ii[0];
+      pr[start] = 1.0;
+      continue;
+    }
+    double sum = 0;
+    for (int j = 0; j < k; j++) {
+      double w = pow((double) di[j], -halfpower);
+      // insertion sort on the row index (MATLAB requires sorted rows)
+      mwIndex m = start + j;
+      while (m > start && ir[m-1] > (mwIndex) ii[j]) {
+        ir[m] = ir[m-1];
+        pr[m] = pr[m-1];
+        m--;
+      }
+      ir[m] = ii[j];
+      pr[m] = w;
+      sum += w;
+    }
+    for (int j = 0; j < k; j++)
+      pr[start+j] /= sum;
+  }
+
+  delete[] idx;
+  delete[] dsq;
+} // end of scatbas
+
+void mexFunction(int nlhs, mxArray * plhs[],
+		 int nrhs, const mxArray * prhs[])
+{
+
+  if (nrhs < 3) {
+    mexPrintf("Must pass in a tree, a list of points and k\n");
+    return;
+  }
+  if(mxIsClass(prhs[0],"kdtree")==0) {
+    mexPrintf("First argument must be a kdtree class\n");
+    return;
+  }
+  void *mem = mxGetData(mxGetFieldByNumber(prhs[0],0,0));
+  int precision = kdtree_precision(mem);
+  if (precision == 0) {
+    mexPrintf("Tree was created by an older version of kdtree;"
+              " recreate the tree\n");
+    return;
+  }
+
+  // Verify the point array
+  if (mxGetNumberOfDimensions(prhs[1]) != 2) {
+    mexPrintf("Invalid point array passed in.\n");
+    return;
+  }
+  int ndim = (int) mxGetN(prhs[1]);
+  int treedim = ((_KDTreeHeader *)mem)->ndim;
+  if (ndim != treedim) {
+    mexPrintf("Points have wrong number of dimensions.\n");
+    mexPrintf("Tree dimension = %d\n",treedim);
+    mexPrintf("Input array dimension = %d\n",ndim);
+    return;
+  }
+  int k = (int) mxGetScalar(prhs[2]);
+  if (k < 1) {
+    mexPrintf("k must be a positive integer\n");
+    return;
+  }
+  double power = 2;
+  if (nrhs > 3 && !mxIsEmpty(prhs[3]))
+    power = mxGetScalar(prhs[3]);
+  int nthreads = 0;
+  if (nrhs > 4)
+    nthreads = (int) mxGetScalar(prhs[4]);
+
+  // Get the tree; this doesn't copy the serialized data
+  if (precision == KDTREE_DOUBLE) {
+    KDTree<double> *tree = KDTree<double>::unserialize(mem);
+    scatbas(tree, plhs, prhs[1], k, power, nthreads);
+    delete tree;
+  }
+  else {
+    KDTree<float> *tree = KDTree<float>::unserialize(mem);
+    scatbas(tree, plhs, prhs[1], k, power, nthreads);
+    delete tree;
+  }
+  return;
+
+} // end of kdtree_scatbas
@@ -0,0 +1,47 @@
+% FUNCTION B = kdtree_scatbas(kdtree, pin, k, power, nthreads)
+%
+% DESCRIPTION:
+%
+%  For a previously created kdtree (see kdtree_create), this function
+%  returns a sparse inverse distance interpolation matrix for the
+%  points in "pin" using the k points in the tree nearest to each
+%  point. The searches and weight computations for the different
+%  points in "pin" are spread across multiple threads.
+%
+% INPUTS:
+%
+%   kdtree   :  A KD Tree previously created with kdtree_create
+%
+%   pin      :  An array (Nxndim) of points.  Note that "ndim" must 
+%               be equal to the dimension of the array that the
+%               "kdtree" was created with.
+%
+%   k        :  The number of neighbors used for each point
+%
+%   power    :  Optional power of the distance used in the weights
+%               (default: 2)
+%
+%   nthreads :  Optional number of threads to use (default: all
+%               available processors)
+%
+% OUTPUTS:
+%
+%   B      :    An (ntree x N) sparse matrix, where "ntree" is the number
+%               of points in the tree. Column i has non-zero values in the
+%               rows of the k points closest to pin(i,:) equal to
+%                 1/dist^power / sum(1/dist^power)
+%               If pin(i,:) coincides with a tree point the column has a
+%               single 1 in the row of that point. Columns sum to 1.
+%
+% Example: 
+% 
+%    % Create a list of 1000 random points in 3d space
+%    r = rand(1000,3);
+% 
+%    % Create a tree from this list
+%    tree = kdtree(r);
+% 
+%    % Interpolate the function values v (defined at the points in r)
+%    % at 100 random points using the 4 nearest points
+%    B = kdtree_scatbas(tree,rand(100,3),4);
+%    vi = B'*v;
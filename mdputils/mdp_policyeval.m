@@ -0,0 +1,115 @@
+% mdp_policyeval Solves the policy evaluation equations used by mdpsolve
+% USAGE
+%   [v,info]=mdp_policyeval(A,r,v0,tol,solver,precond,maxit);
+% INPUTS
+%   A       : ns x ns sparse or full matrix (I-d*pstar in row stochastic form)
+%               or a function handle that returns A*v for an ns-vector v
+%   r       : ns-vector of rewards associated with the current policy
+%   v0      : starting value for iterative solvers (warm start)
+%   tol     : relative residual tolerance for iterative solvers
+%   solver  : 'direct', 'bicgstab' or 'gmres' (default: 'bicgstab')
+%   precond : 'ilu0', 'jacobi' or 'none' (default: 'ilu0')
+%   maxit   : maximum number of iterations for iterative solvers
+%               (default: min(ns,500))
+% OUTPUTS
+%   v       : ns-vector solving A*v=r
+%   info    : structure with fields
+%               solver : solver actually used
+%               iter   : number of iterations (0 for direct)
+%               relres : relative residual
+%               flag   : flag returned by the iterative solver
+%                          (0 if converged; -1 if a direct solve was used
+%                          after the iterative solver failed)
+%
+% The iterative solvers are warm-started from v0, which in policy iteration
+% is the value of the previous policy. Only matrix vector products with A
+% are needed, so no factorization (and no fill-in) occurs. ILU(0) uses
+% the sparsity pattern of A; if it fails Jacobi preconditioning is used.
+% If the iterative solver fails to converge A\r is used when A is a matrix.
+
+% MDPSOLVE: MATLAB tools for solving Markov Decision Problems
+% Copyright (c) 2026, Paul L. Fackler (paul_fackler@ncsu.edu)
+% All rights reserved.
+% 
+% Redistribution and use in source and binary forms, with or without  
+% modification, are permitted provided that the following conditions are met:
+% 
+%    * Redistributions of source code must retain the above copyright notice, 
+%        this list of conditions and the following disclaimer.
+%    * Redistributions in binary form must reproduce the above copyright notice, 
+%        this list of conditions and the following disclaimer in the 
+%        documentation and/or other materials provided with the distribution.
+%    * Neither the name of the North Carolina State University nor of Paul L. 
+%        Fackler may be used to endorse or promote products derived from this 
+%        software without specific prior written permission.
+% 
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+% FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+% DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+% SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+% CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+% OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+% OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+% 
+% For more information, see the Open Source Initiative OSI site:
+%   http://www.opensource.org/licenses/bsd-license.php
+
+function [v,info]=mdp_policyeval(A,r,v0,tol,solver,precond,maxit)
+ns=length(r);
+if nargin<3 || isempty(v0),      v0=zeros(ns,1);    end
+if nargin<4 || isempty(tol),     tol=1e-10;         end
+if nargin<5 || isempty(solver),  solver='bicgstab'; end
+if nargin<6 || isempty(precond), precond='ilu0';    end
+if nargin<7 || isempty(maxit),   maxit=min(ns,500); end
+r=r(:);
+info=struct('solver',solver,'iter',0,'relres',0,'flag',0);
+
+ismat=isnumeric(A);
+if strcmp(solver,'direct')
+  if ~ismat
+    error('A must be a matrix to use the direct solver')
+  end
+  v=A\r;
+  return
+end
+
+% set up the preconditioner
+M1=[]; M2=[];
+if ismat && issparse(A)
+  switch precond
+    case 'ilu0'
+      try
+        [M1,M2]=ilu(A,struct('type','nofill'));
+      catch
+        precond='jacobi';
+      end
+  end
+  if strcmp(precond,'jacobi')
+    dA=full(diag(A));
+    dA(dA==0)=1;
+    M1=spdiags(dA,0,ns,ns);
+  end
+end
+
+warnstate=warning('off','MATLAB:bicgstab:tooSmallTolerance');
+switch solver
+  case 'gmres'
+    restart=min(ns,30);
+    [v,flag,relres,iter]=gmres(A,r,restart,tol,ceil(maxit/restart),M1,M2,v0(:));
+    iter=(iter(1)-1)*restart+iter(end);
+  otherwise
+    [v,flag,relres,iter]=bicgstab(A,r,tol,maxit,M1,M2,v0(:));
+end
+warning(warnstate);
+info.iter=iter;
+info.relres=relres;
+info.flag=flag;
+% use a direct solve if the iterative solver failed
+if flag~=0 && ismat
+  v=A\r;
+  info.flag=-1;
+  info.solver='direct';
+end
@@ -0,0 +1,278 @@
+#include "mex.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+/*
+% mdpcheckpoint Writes and reads solver checkpoint files
+% USAGE
+%   mdpcheckpoint(filename,state);   % write (asynchronously)
+%   state=mdpcheckpoint(filename);   % read
+%   mdpcheckpoint;                   % wait for a pending write to finish
+% INPUTS
+%   filename : name of the checkpoint file
+%   state    : structure whose fields are real double arrays
+% OUTPUT
+%   state    : structure read from the file (empty if the file does not
+%                exist)
+%
+% The fields of state are copied and the function returns immediately;
+% the file is written by a background thread so the solver is not
+% stalled by the disk. The data are first written to filename.tmp which
+% is then renamed so an interrupted write never damages the previous
+% checkpoint. A new write or a read first waits for a pending write.
+% Errors in a background write are reported as a warning on the next
+% call.
+%
+% File layout (native byte order):
+%   'MDPC', int32 version, int32 number of fields, int32 0
+%   for each field: char name[32], int64 rows, int64 columns, doubles
+%
+% Used by mdpsolve_Inf and mdpsolve_Inf_stage (see the checkpoint and
+% resume options of mdpsolve)
+%
+% Coded as a MEX file
+*/
+
+#define CHECKPOINT_MAGIC   0x4350444d   /* "MDPC" */
+#define CHECKPOINT_VERSION 1
+#define NAMELEN 32
+
+struct cpfield {
+  char name[NAMELEN];
+  long long rows, cols;
+  double *data;
+};
+
+/* a checkpoint waiting to be written by the background thread;
+   uses malloc rather than mxMalloc because it outlives the MEX call */
+static struct {
+  char *filename;
+  int nfields;
+  struct cpfield *fields;
+  int status;        /* 0 ok, 1 write failed */
+  int active;        /* a thread has been started and not joined */
+#ifdef _WIN32
+  HANDLE thread;
+#else
+  pthread_t thread;
+#endif
+} pending;
+
+static void freepending(void)
+{
+  int i;
+  for (i=0; i<pending.nfields; i++) free(pending.fields[i].data);
+  free(pending.fields);
+  free(pending.filename);
+  pending.fields=NULL;
+  pending.filename=NULL;
+  pending.nfields=0;
+}
+
+/* writes the pending checkpoint; returns 0 on success */
+static int writecheckpoint(void)
+{
+  FILE *fid;
+  char *tmpname;
+  int i, hdr[4], err=0;
+  tmpname=malloc(strlen(pending.filename)+5);
+  if (tmpname==NULL) return(1);
+  strcpy(tmpname,pending.filename);
+  strcat(tmpname,".tmp");
+  fid=fopen(tmpname,"wb");
+  if (fid==NULL){ free(tmpname); return(1); }
+  hdr[0]=CHECKPOINT_MAGIC; hdr[1]=CHECKPOINT_VERSION;
+  hdr[2]=pending.nfields;  hdr[3]=0;
+  if (fwrite(hdr,sizeof(int),4,fid)!=4) err=1;
+  for (i=0; i<pending.nfields && !err; i++){
+    struct cpfield *f=pending.fields+i;
+    size_t n=(size_t)(f->rows*f->cols);
+    if (fwrite(f->name,1,NAMELEN,fid)!=NAMELEN ||
+        fwrite(&f->rows,sizeof(long long),1,fid)!=1 ||
+        fwrite(&f->cols,sizeof(long long),1,fid)!=1 ||
+        fwrite(f->data,sizeof(double),n,fid)!=n) err=1;
+  }
+  if (fclose(fid)) err=1;
+  if (!err){
+#ifdef _WIN32
+    if (!MoveFileExA(tmpname,pending.filename,MOVEFILE_REPLACE_EXISTING)) err=1;
+#else
+    if (rename(tmpname,pending.filename)) err=1;
+#endif
+  }
+  if (err) remove(tmpname);
+  free(tmpname);
+  return(err);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI writethread(LPVOID arg)
+#else
+static void *writethread(void *arg)
+#endif
+{
+  (void)arg;
+  pending.status=writecheckpoint();
+  return(0);
+}
+
+/* waits for the background write to finish */
+static void waitpending(void)
+{
+  if (!pending.active) return;
+#ifdef _WIN32
+  WaitForSingleObject(pending.thread,INFINITE);
+  CloseHandle(pending.thread);
+#else
+  pthread_join(pending.thread,NULL);
+#endif
+  pending.active=0;
+  freepending();
+  mexUnlock();
+  if (pending.status){
+    pending.status=0;
+    mexWarnMsgTxt("Unable to write the checkpoint file");
+  }
+}
+
+static void atexitfunction(void)
+{
+  waitpending();
+}
+
+/* copies the fields of state and starts the background write */
+static void startwrite(const mxArray *filename, const mxArray *state)
+{
+  int i, nf;
+  char *fname;
+  nf=mxGetNumberOfFields(state);
+  for (i=0; i<nf; i++){
+    const mxArray *x=mxGetFieldByNumber(state,0,i);
+    if (x==NULL || !mxIsDouble(x) || mxIsSparse(x) || mxIsComplex(x))
+      mexErrMsgTxt("fields of state must be real full double arrays");
+    if (strlen(mxGetFieldNameByNumber(state,i))>=NAMELEN)
+      mexErrMsgTxt("field names of state must have fewer than 32 characters");
+  }
+  fname=mxArrayToString(filename);
+  pending.filename=malloc(strlen(fname)+1);
+  pending.fields=calloc(nf>0 ? nf : 1,sizeof(struct cpfield));
+  if (pending.filename==NULL || pending.fields==NULL){
+    freepending();
+    mexErrMsgTxt("Out of memory");
+  }
+  strcpy(pending.filename,fname);
+  mxFree(fname);
+  for (i=0; i<nf; i++){
+    const mxArray *x=mxGetFieldByNumber(state,0,i);
+    struct cpfield *f=pending.fields+i;
+    size_t n=mxGetNumberOfElements(x);
+    memset(f->name,0,NAMELEN);
+    strcpy(f->name,mxGetFieldNameByNumber(state,i));
+    f->rows=(long long)mxGetM(x);
+    f->cols=(long long)(n>0 ? n/mxGetM(x) : mxGetN(x));
+    f->data=malloc(n>0 ? n*sizeof(double) : 1);
+    pending.nfields=i+1;
+    if (f->data==NULL){
+      freepending();
+      mexErrMsgTxt("Out of memory");
+    }
+    memcpy(f->data,mxGetPr(x),n*sizeof(double));
+  }
+  pending.status=0;
+  // keep the MEX file in memory until the thread has been joined
+  mexLock();
+  pending.active=1;
+#ifdef _WIN32
+  pending.thread=CreateThread(NULL,0,writethread,NULL,0,NULL);
+  if (pending.thread==NULL){
+#else
+  if (pthread_create(&pending.thread,NULL,writethread,NULL)){
+#endif
+    // write in the foreground if no thread can be created
+    pending.active=0;
+    mexUnlock();
+    pending.status=writecheckpoint();
+    freepending();
+    if (pending.status){
+      pending.status=0;
+      mexWarnMsgTxt("Unable to write the checkpoint file");
+    }
+  }
+}
+
+/* reads a checkpoint file; returns an empty matrix if it does not exist */
+static mxArray *readcheckpoint(const mxArray *filename)
+{
+  FILE *fid;
+  char *fname, (*names)[NAMELEN];
+  const char **fnames;
+  int hdr[4], i;
+  long long dims[2];
+  mxArray *state, **vals;
+
+  fname=mxArrayToString(filename);
+  fid=fopen(fname,"rb");
+  mxFree(fname);
+  if (fid==NULL) return(mxCreateDoubleMatrix(0,0,mxREAL));
+  if (fread(hdr,sizeof(int),4,fid)!=4 || hdr[0]!=CHECKPOINT_MAGIC
+      || hdr[1]!=CHECKPOINT_VERSION || hdr[2]<0){
+    fclose(fid);
+    mexErrMsgTxt("Not a valid checkpoint file");
+  }
+  names=mxMalloc((hdr[2]>0 ? hdr[2] : 1)*NAMELEN);
+  fnames=mxMalloc((hdr[2]>0 ? hdr[2] : 1)*sizeof(char *));
+  vals=mxMalloc((hdr[2]>0 ? hdr[2] : 1)*sizeof(mxArray *));
+  for (i=0; i<hdr[2]; i++){
+    size_t n;
+    if (fread(names[i],1,NAMELEN,fid)!=NAMELEN ||
+        fread(dims,sizeof(long long),2,fid)!=2 || dims[0]<0 || dims[1]<0){
+      fclose(fid);
+      mexErrMsgTxt("Checkpoint file is damaged");
+    }
+    names[i][NAMELEN-1]=0;
+    fnames[i]=names[i];
+    vals[i]=mxCreateDoubleMatrix((mwSize)dims[0],(mwSize)dims[1],mxREAL);
+    n=(size_t)(dims[0]*dims[1]);
+    if (fread(mxGetPr(vals[i]),sizeof(double),n,fid)!=n){
+      fclose(fid);
+      mexErrMsgTxt("Checkpoint file is damaged");
+    }
+  }
+  fclose(fid);
+  state=mxCreateStructMatrix(1,1,hdr[2],fnames);
+  for (i=0; i<hdr[2]; i++) mxSetFieldByNumber(state,0,i,vals[i]);
+  mxFree(names);
+  mxFree(fnames);
+  mxFree(vals);
+  return(state);
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  static int registered=0;
+  if (!registered){
+    mexAtExit(atexitfunction);
+    registered=1;
+  }
+  if (nrhs>2) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  waitpending();
+  if (nrhs==0) return;
+  if (!mxIsChar(prhs[0])) mexErrMsgTxt("filename must be a string");
+  if (nrhs==1){
+    plhs[0]=readcheckpoint(prhs[0]);
+  }
+  else{
+    if (nlhs>0) mexErrMsgTxt("No output is created when writing");
+    if (!mxIsStruct(prhs[1]) || mxGetNumberOfElements(prhs[1])!=1)
+      mexErrMsgTxt("state must be a structure");
+    startwrite(prhs[0],prhs[1]);
+  }
+}
@@ -0,0 +1,127 @@
+% mdpload Loads a model saved with mdpsave
+% USAGE
+%   model=mdpload(filename,stream);
+% INPUTS
+%   filename : name of a file created by mdpsave
+%   stream   : 0 to create P as a sparse matrix, 1 to leave P in the file
+%                and read it with pfilemult at each use [default: 0]
+% OUTPUT
+%   model    : model structure (see mdpsolve)
+%
+% The file is opened with memmapfile so the arrays are read directly from
+% the operating system's page cache; several MATLAB sessions using the
+% same model share one copy of the file in memory and after the first
+% use the model loads without reading the disk.
+%
+% With stream=1, model.P is the function handle @(v) pfilemult(filename,v)
+% and model.EV=1. The transition matrix is then never held in MATLAB
+% memory (see pfilemult). This can be used with function iteration and
+% finite horizon problems.
+
+% MDPSOLVE: MATLAB tools for solving Markov Decision Problems
+% Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
+% All rights reserved.
+%
+% Redistribution and use in source and binary forms, with or without
+% modification, are permitted provided that the following conditions are met:
+%
+%    * Redistributions of source code must retain the above copyright notice,
+%        this list of conditions and the following disclaimer.
+%    * Redistributions in binary form must reproduce the above copyright notice,
+%        this list of conditions and the following disclaimer in the
+%        documentation and/or other materials provided with the distribution.
+%    * Neither the name of the North Carolina State University nor of Paul L.
+%        Fackler may be used to endorse or promote products derived from this
+%        software without specific prior written permission.
+%
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+% FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+% DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+% SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+% CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+% OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+% OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+%
+% For more information, see the Open Source Initiative OSI site:
+%   http://www.opensource.org/licenses/bsd-license.php
+
+function model=mdpload(filename,stream)
+if nargin<2 || isempty(stream), stream=0; end
+
+% read the header and the directory
+fid=fopen(filename,'r');
+if fid<0, error(['Cannot open ' filename]); end
+magic=char(fread(fid,4,'uint8')');
+if ~strcmp(magic,'MDPM')
+  fclose(fid);
+  error([filename ' was not created by mdpsave'])
+end
+hdr=fread(fid,3,'int32');
+if hdr(1)~=1
+  fclose(fid);
+  error(['Unsupported file version in ' filename])
+end
+narr=hdr(2);
+fread(fid,1,'int64');
+names=cell(1,narr); types=zeros(1,narr);
+rows=zeros(1,narr); cols=zeros(1,narr); offsets=zeros(1,narr);
+for i=1:narr
+  name=fread(fid,32,'uint8')';
+  names{i}=char(name(1:find([name 0]==0,1)-1));
+  t=fread(fid,2,'int32');
+  types(i)=t(1);
+  t=fread(fid,3,'int64');
+  rows(i)=t(1); cols(i)=t(2); offsets(i)=t(3);
+end
+fclose(fid);
+
+% map the arrays; gaps between the arrays are mapped as padding
+typestr={'double','int64','uint32'};
+typebytes=[8 8 4];
+[~,order]=sort(offsets);
+format=cell(0,3);
+pos=[];
+for i=order
+  if types(i)==0, continue; end
+  if ~stream || ~strncmp(names{i},'P.',2)
+    if isempty(pos)
+      pos=offsets(i);
+      start=pos;
+    elseif offsets(i)>pos
+      format(end+1,:)={'uint8',[1 offsets(i)-pos],sprintf('pad%d',i)}; %#ok<AGROW>
+    end
+    format(end+1,:)={typestr{types(i)},[rows(i) cols(i)],strrep(names{i},'.','_')}; %#ok<AGROW>
+    pos=offsets(i)+rows(i)*cols(i)*typebytes(types(i));
+  end
+end
+model=struct();
+if ~isempty(format)
+  m=memmapfile(filename,'Offset',start,'Format',format,'Repeat',1);
+  data=m.Data;
+else
+  data=struct();
+end
+for i=1:narr
+  if types(i)~=1 || strncmp(names{i},'P.',2), continue; end
+  model.(names{i})=data.(names{i});
+end
+
+% the transition matrix
+k=find(types==0 & strcmp(names,'P'));
+if ~isempty(k)
+  ns=rows(k); nx=cols(k);
+  if stream
+    model.P=@(v) pfilemult(filename,v);
+    model.EV=1;
+  else
+    jc=double(data.P_jc);
+    nnzP=jc(end);
+    % column index of each non-zero
+    jj=cumsum(accumarray(jc(1:nx)+1,1,[nnzP+1 1]));
+    model.P=sparse(double(data.P_ir)+1,jj(1:nnzP),data.P_pr,ns,nx);
+  end
+  model.colstoch=1;
+end
@@ -0,0 +1,150 @@
+% mdpsave Saves a model in a binary file that can be memory mapped
+% USAGE
+%   mdpsave(filename,model);
+% INPUTS
+%   filename : name of the file to create
+%   model    : model structure (see mdpsolve)
+%
+% The numeric fields R (or reward), d (or discount), P (or transprob),
+% Ix, Iexpand, ns, nx, T, vterm and colstoch are saved. P is saved in
+% compressed sparse column form in its column stochastic (ns x nx)
+% orientation. Use mdpload to read the model:
+%   model=mdpload(filename);
+% Unlike a MAT file the arrays are stored uncompressed so loading is
+% limited only by the disk (or the page cache if the file has been read
+% recently).
+%
+% File layout (native byte order):
+%   header    : 'MDPM', int32 version, int32 number of arrays, int32 0,
+%               int64 file size
+%   directory : one 64 byte entry for each array
+%                 char name[32], int32 type, int32 0, int64 rows,
+%                 int64 columns, int64 offset
+%               type is 0 for the P descriptor (rows=ns, columns=nx),
+%               1 for double, 2 for int64 and 3 for uint32
+%   arrays    : each begins on a 64 byte boundary
+% P is stored as the arrays P.jc (int64, nx+1 column pointers),
+% P.ir (0-based row indices, uint32 if ns<2^32 and int64 otherwise)
+% and P.pr (double values). This is the layout read by pfilemult.
+
+% MDPSOLVE: MATLAB tools for solving Markov Decision Problems
+% Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
+% All rights reserved.
+%
+% Redistribution and use in source and binary forms, with or without
+% modification, are permitted provided that the following conditions are met:
+%
+%    * Redistributions of source code must retain the above copyright notice,
+%        this list of conditions and the following disclaimer.
+%    * Redistributions in binary form must reproduce the above copyright notice,
+%        this list of conditions and the following disclaimer in the
+%        documentation and/or other materials provided with the distribution.
+%    * Neither the name of the North Carolina State University nor of Paul L.
+%        Fackler may be used to endorse or promote products derived from this
+%        software without specific prior written permission.
+%
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+% FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+% DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+% SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+% CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+% OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+% OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+%
+% For more information, see the Open Source Initiative OSI site:
+%   http://www.opensource.org/licenses/bsd-license.php
+
+function mdpsave(filename,model)
+if ~isstruct(model), error('model must be a structure variable'); end
+% fields saved and alternative names
+fnames={'R','reward'; 'd','discount'; 'Ix',''; 'Iexpand',''; 'ns',''; ...
+        'nx',''; 'T',''; 'vterm',''; 'colstoch',''};
+names={}; data={};
+for i=1:size(fnames,1)
+  x=[];
+  if isfield(model,fnames{i,1}),                           x=model.(fnames{i,1});
+  elseif ~isempty(fnames{i,2}) && isfield(model,fnames{i,2}), x=model.(fnames{i,2});
+  end
+  if isempty(x), continue; end
+  if ~isnumeric(x) && ~islogical(x)
+    error([fnames{i,1} ' must be numeric to be saved with mdpsave'])
+  end
+  names{end+1}=fnames{i,1}; %#ok<AGROW>
+  data{end+1}=double(full(x)); %#ok<AGROW>
+end
+
+% transition matrix in column stochastic form
+P=[];
+if isfield(model,'P'),             P=model.P;
+elseif isfield(model,'transprob'), P=model.transprob;
+end
+if ~isempty(P)
+  if ~isnumeric(P), error('P must be numeric to be saved with mdpsave'); end
+  if isfield(model,'colstoch') && ~isempty(model.colstoch)
+    colstoch=model.colstoch;
+  else
+    colstoch=all(abs(full(sum(P,1))-1)<1e-8);
+  end
+  if ~colstoch, P=P'; end
+  if ~issparse(P), P=sparse(P); end
+  [ns,nx]=size(P);
+  [ir,jj,pr]=find(P);
+  clear jj
+  jc=[0 cumsum(full(sum(spones(P),1)))];
+  clear P
+  names(end+1:end+4)={'P','P.jc','P.ir','P.pr'};
+  data(end+1:end+4)={[ns nx],jc(:),ir-1,pr};
+  k=find(strcmp(names,'colstoch'));
+  if isempty(k), names{end+1}='colstoch'; data{end+1}=1;
+  else           data{k}=1;
+  end
+end
+
+% build the directory
+narr=length(names);
+types=ones(1,narr);
+rows=zeros(1,narr); cols=zeros(1,narr); offsets=zeros(1,narr);
+pos=ceil((24+64*narr)/64)*64;
+for i=1:narr
+  switch names{i}
+  case 'P'
+    types(i)=0; rows(i)=data{i}(1); cols(i)=data{i}(2);
+    continue
+  case 'P.jc'
+    types(i)=2;
+  case 'P.ir'
+    if rows(strcmp(names,'P'))<2^32, types(i)=3; else types(i)=2; end
+  end
+  [rows(i),cols(i)]=size(data{i});
+  offsets(i)=pos;
+  pos=ceil((pos+numel(data{i})*typebytes(types(i)))/64)*64;
+end
+
+fid=fopen(filename,'w');
+if fid<0, error(['Cannot open ' filename]); end
+fwrite(fid,'MDPM','uint8');
+fwrite(fid,[1 narr 0],'int32');
+fwrite(fid,pos,'int64');
+for i=1:narr
+  name=zeros(1,32);
+  name(1:length(names{i}))=double(names{i});
+  fwrite(fid,name,'uint8');
+  fwrite(fid,[types(i) 0],'int32');
+  fwrite(fid,[rows(i) cols(i) offsets(i)],'int64');
+end
+typestr={'double','int64','uint32'};
+for i=1:narr
+  if types(i)==0, continue; end
+  fwrite(fid,zeros(1,offsets(i)-ftell(fid)),'uint8');
+  fwrite(fid,data{i},typestr{types(i)});
+  data{i}=[];
+end
+fwrite(fid,zeros(1,pos-ftell(fid)),'uint8');
+fclose(fid);
+
+function b=typebytes(type)
+b=[8 8 4];
+b=b(type);
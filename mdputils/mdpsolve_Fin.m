@@ -1,7 +1,18 @@
 % mdpsolve_Fin  Solves discrete-state/action finite horizon dynamic program
 % USAGE
 %   results = mdpsolve_Fin(R, P, d, ns, nx, Ix, Iexpand, colstoch, EV, ...
-%                           Xindexed,expandP, T, v, keepall, print);
+%                           Xindexed,expandP, T, v, keepall, print, infopts);
+%
+% infopts is an optional structure with the fields
+%   keepfile  : name of a file to which the value function and strategy of
+%                 each period are written when keepall=1 [default: '']
+%   keepdelta : 0/1 store only the strategy entries that differ from those
+%                 of the following period [default: 0]
+% With keepfile the results for every period are not held in memory:
+% results.v and results.Ixopt contain those of period 1 and the others
+% are obtained with mdpkeepread. Each period is written as it is computed.
+% Strategies are stored using the smallest integer type (uint8, uint16 or
+% uint32) that holds the number of actions (or nx if Ix is used).
 %
 % Called by mdpsolve
 
@@ -36,9 +47,17 @@
 %   http://www.opensource.org/licenses/bsd-license.php
 
 function results = mdpsolve_Fin( ...
-   R, P, d, ns, nx, Ix, Iexpand, colstoch, EV,Xindexed,expandP, T, v, keepall, print)
+   R, P, d, ns, nx, Ix, Iexpand, colstoch, EV,Xindexed,expandP, T, v, keepall, print, infopts)
 
-  if keepall
+  if nargin<16 || isempty(infopts), infopts=struct(); end
+  keepfile=''; keepdelta=false;
+  if isfield(infopts,'keepfile'),  keepfile=infopts.keepfile;   end
+  if isfield(infopts,'keepdelta'), keepdelta=infopts.keepdelta; end
+  if ~keepall, keepfile=''; end
+  fid=[]; ptype=''; xprev=[];
+  if ~isempty(keepfile)
+    keepopen;
+  elseif keepall
     vv=zeros(ns,T);
     xx=zeros(ns,T);
   end
@@ -57,16 +76,21 @@ function results = mdpsolve_Fin( ...
     % this should never happen if P is proper and R is bounded
     if ~all(abs(v)<inf) % NaNs or infinities in value function
       results.errors={{35,iter}};
+      if ~isempty(fid), fclose(fid); end
       return
     end
-    if keepall
+    if ~isempty(keepfile)
+      keepwrite(v,x);
+    elseif keepall
       vv(:,iter)=v;
       xx(:,iter)=x;
     end
   end
   % end of iteration loop
   
-  if keepall
+  if ~isempty(keepfile)
+    fclose(fid);
+  elseif keepall
     v=vv; x=xx;
   end
     
@@ -78,6 +102,44 @@ function results = mdpsolve_Fin( ...
   results=struct('v',v,'Ixopt',x);
     
 
+% opens the keepfile and writes the header
+% the periods are written in the order computed (T first) as records
+% containing v (ns doubles) and the strategy padded to a multiple of 8 bytes
+function keepopen
+  if Xindexed, xmax=nx; else xmax=nx/ns; end
+  if     xmax<2^8,  ptype='uint8';  pcode=1;
+  elseif xmax<2^16, ptype='uint16'; pcode=2;
+  elseif xmax<2^32, ptype='uint32'; pcode=3;
+  else              ptype='double'; pcode=4;
+  end
+  fid=fopen(keepfile,'w');
+  if fid<0, error(['Cannot open ' keepfile]); end
+  fwrite(fid,'MDPK','uint8');
+  fwrite(fid,[1 pcode keepdelta+2*Xindexed],'int32');
+  fwrite(fid,[ns T],'int64');
+  fwrite(fid,zeros(1,32),'uint8');
+  xprev=zeros(ns,1);
+end
+
+% writes the value function and strategy of one period
+function keepwrite(v,x)
+  fwrite(fid,v,'double');
+  if keepdelta
+    % changes from the strategy of the following period
+    ind=find(x~=xprev);
+    fwrite(fid,length(ind),'int64');
+    if ns<2^32, fwrite(fid,ind,'uint32');
+    else        fwrite(fid,ind,'double');
+    end
+    fwrite(fid,x(ind),ptype);
+    xprev=x;
+  else
+    fwrite(fid,x,ptype);
+  end
+  pad=mod(-ftell(fid),8);
+  if pad>0, fwrite(fid,zeros(1,pad),'uint8'); end
+end
+
 % gets the maximized value function and associated strategy   
 function [vnew,xnew] = valmax(v)
   if EV
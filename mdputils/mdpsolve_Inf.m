@@ -1,7 +1,60 @@
 % mdpsolve_Inf Solves discrete-state/action infinite horizon dynamic program
 % USAGE
 %  results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
-%         Xindexed,expandP,v,algorithm,relval,maxit,tol,nochangelim,print);
+%         Xindexed,expandP,v,algorithm,relval,maxit,tol,nochangelim,print,vknown,infopts);
+%
+% infopts is an optional structure with additional solver options:
+%   pesolver : policy evaluation solver: 'auto', 'direct', 'bicgstab' or 'gmres'
+%                'auto' uses a direct solve if ns<=pedirectmax or P is full
+%                and bicgstab otherwise [default: 'auto']
+%   precond  : preconditioner for iterative policy evaluation: 
+%                'ilu0', 'jacobi' or 'none' [default: 'ilu0']
+%   petol    : relative residual tolerance for the final policy evaluation
+%                [default: 1e-10]
+%   pedirectmax : largest ns for which 'auto' uses a direct solve 
+%                [default: 10000]
+%   adaptmpi : 0/1 choose the number of modified policy iteration sweeps 
+%                adaptively (modpol is then the maximum) [default: 0]
+%   smwmax   : largest number of states whose actions may differ from those
+%                of the last factorized policy before the direct solver 
+%                refactorizes (0 refactorizes at every iteration) [default: 20]
+%   checkpoint    : name of a checkpoint file ('' for none) [default: '']
+%   checkpointint : minimum time in seconds between checkpoints [default: 300]
+%   resume   : 0/1 continue from the state saved in the checkpoint file 
+%                [default: 0]
+%   profile  : 0/1 record performance information for each iteration in
+%                results.profile [default: 0]
+%   profilefile : name of a .csv or .json file to which the profile is 
+%                written [default: '']
+% Iterative policy evaluation is warm-started from the previous value 
+% function and uses a tolerance proportional to the last change in the
+% value function (inexact policy iteration); the tolerance is tightened
+% to petol once the policy no longer changes.
+% The direct policy evaluation solver keeps the LU factorization of the 
+% system matrix. When only a few states change their actions the new 
+% system differs from the factorized one in a few rows and it is solved
+% with the Sherman-Morrison-Woodbury formula using the existing factors.
+% With adaptmpi=1 the number of modified policy iteration sweeps after each
+% maximization step is chosen so the sweeps reduce the evaluation error by
+% a factor theta, using the contraction rate rho observed in earlier sweeps:
+%   sweeps = ceil(log(theta)/log(rho)),  theta = teval/tmax (in [0.01,0.5])
+% where tmax and teval are the measured times of a maximization step and
+% of an evaluation sweep. The number of sweeps used at each iteration is
+% returned in results.MPIdepth.
+% When a checkpoint file is named the iteration state (v, x, iter and the 
+% iteration counters) is written to it with mdpcheckpoint at most every 
+% checkpointint seconds and when the iterations end. The file is written
+% by a background thread so the iterations continue while it is written.
+% With profile=1, results.profile has the following fields, each with one
+% element for each iteration:
+%   texp     : time computing the expected future values (P'*v)
+%   tmax     : time adding rewards and maximizing
+%   teval    : time in policy evaluation (solves or MPI sweeps)
+%   tcheck   : time in convergence checks
+%   nnz      : number of non-zeros of P and of the policy transition 
+%                matrix used in the iteration
+%   bytes    : estimated bytes of the main arrays created in the iteration
+%   nchanged : number of states whose action changed
 %
 % Called by mdpsolve
 
@@ -36,8 +89,25 @@
 %   http://www.opensource.org/licenses/bsd-license.php
 
 function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
-         Xindexed,expandP,v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,vknown)
+         Xindexed,expandP,v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,vknown,infopts)
   warnings={};
+  if nargin<22 || isempty(infopts), infopts=struct(); end
+  pesolver='auto'; precond='ilu0'; petol=1e-10; pedirectmax=10000;
+  if isfield(infopts,'pesolver'),    pesolver=lower(infopts.pesolver);  end
+  if isfield(infopts,'precond'),     precond=lower(infopts.precond);    end
+  if isfield(infopts,'petol'),       petol=infopts.petol;               end
+  if isfield(infopts,'pedirectmax'), pedirectmax=infopts.pedirectmax;   end
+  smwmax=20; adaptmpi=false;
+  if isfield(infopts,'smwmax'),      smwmax=infopts.smwmax;             end
+  if isfield(infopts,'adaptmpi'),    adaptmpi=infopts.adaptmpi;         end
+  checkpoint=''; checkpointint=300; resume=false;
+  if isfield(infopts,'checkpoint'),    checkpoint=infopts.checkpoint;       end
+  if isfield(infopts,'checkpointint'), checkpointint=infopts.checkpointint; end
+  if isfield(infopts,'resume'),        resume=infopts.resume;               end
+  profile=false; profilefile='';
+  if isfield(infopts,'profile'),       profile=infopts.profile;             end
+  if isfield(infopts,'profilefile'),   profilefile=infopts.profilefile;     end
+  if ~isempty(profilefile), profile=true; end
   nochangemin=5;   % safety feature to prevent early convergence with function iteration
   
   if isempty(vknown)
@@ -51,6 +121,12 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
   if algorithm =='p'
     policyit=true;
     spi=speye(ns);
+    % choose between direct and iterative policy evaluation
+    if strcmp(pesolver,'auto')
+      if ns<=pedirectmax || ~issparse(P), pesolver='direct';
+      else                                pesolver='bicgstab';
+      end
+    end
   else
     policyit=false;
   end
@@ -69,7 +145,12 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
     tol=tol*(1-max(d))/max(d);
   end
   % relative value method
-  if relval>=1 && policyit
+  % algorithm 'i' always uses an iterative policy evaluation solver
+  if algorithm=='i'
+    if strcmp(pesolver,'auto') || strcmp(pesolver,'direct'), pesolver='bicgstab'; end
+    if ~EV, spi=speye(ns); end
+  end
+  if relval>=1 && (policyit || (algorithm=='i' && ~EV))
     if colstoch
       spi=spi+sparse(relval,1:ns,1,ns,ns);
     else
@@ -109,7 +190,6 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
     end
     EVitsol=getfunc(P,d,colstoch);
     itsol=true;
-    warning('off','MATLAB:bicgstabl:tooSmallTolerance');
   else
      itsol=false;
   end
@@ -122,20 +202,52 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
   R=R(:);                      % normalize so R is a column vector
   numnochange=0;
   done=false;
+  change=inf;
+  PEiter=0;                    % counts iterations used in iterative policy evaluation
+  Mfac=[];                     % cached factorization used by the direct solver
+  pstar=[];
+  prof=struct('texp',[],'tmax',[],'teval',[],'tcheck',[],'nnz',[],'bytes',[],'nchanged',[]);
+  proftexp=0; proftmax=0;      % times recorded by valmax
+  MPIdepth=[];                 % number of MPI sweeps at each iteration
+  tmax=[]; teval=[];           % measured times of maximization and evaluation sweeps
+  teval0=[];                   % timer for the evaluation sweeps
+  rho=min(max(d),0.999);       % estimated contraction rate of evaluation sweeps
+  dk1=0; dk=0;                 % first and latest changes in the evaluation sweeps
   iter=0;
   nu=[];
+  % continue from a checkpoint
+  if resume && ~isempty(checkpoint)
+    state=mdpcheckpoint(checkpoint);
+    if isstruct(state) && all(isfield(state,{'v','x','iter','MPI','PEiter','numnochange','change'})) ...
+        && numel(state.v)==ns && numel(state.x)==ns
+      v=state.v; x=state.x; iter=state.iter; MPI=state.MPI; PEiter=state.PEiter;
+      numnochange=state.numnochange; change=state.change;
+    elseif isstruct(state)
+      warnings{end+1}={54};
+    end
+    clear state
+  end
+  tcheck=tic;
 % %%%%%%% MAIN ITERATION LOOP %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
   while iter<maxit     
     iter=iter+1; 
     % update policy 
+    tmax0=tic;
     [vnew,xnew] = valmax(v); 
+    if profile, prof0=tic; MPI0=MPI; PEiter0=PEiter; end
     % update value if policy iteration is used
     if policyit 
       [pstar,rstar] = valpol(xnew);
-      if colstoch 
-        vnew = (rstar'/(spi-mxv(pstar,d)))';  % update value
+      if strcmp(pesolver,'direct') && smwmax>0
+        vnew = smwupdate(pstar,rstar,xnew);
+      elseif strcmp(pesolver,'direct')
+        if colstoch 
+          vnew = (rstar'/(spi-mxv(pstar,d)))';  % update value
+        else
+          vnew = (spi-vxm(d,pstar))\rstar;      % update value
+        end
       else
-        vnew = (spi-vxm(d,pstar))\rstar;      % update value
+        vnew = peupdate(pstar,rstar,all(xnew==x));
       end
       if constrained, vnew(iknown)=vknown; end
     elseif itsol
@@ -146,16 +258,12 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
           ind=ns*xnew+(1-ns:0)';
         end
         rstar=R(ind); rstar=rstar(:);
-        [vnew,ISflag] = ...
-          bicgstabl(@(V) EVitsol(V,ind),rstar,[],[],[],[],v);  % update value
-      elseif colstoch 
-         [pstar,rstar] = valpol(xnew);
-         [vnew,ISflag] = ...
-            bicgstabl(@(V)EVitsol(V,pstar),rstar,[],[],[],[],v);  % update value
+        [vnew,peinfo] = mdp_policyeval(@(V) EVitsol(V,ind),rstar,v, ...
+                          petolerance(all(xnew==x)),pesolver,'none');  % update value
+        PEiter=PEiter+peinfo.iter;
       else
         [pstar,rstar] = valpol(xnew);
-        [vnew,ISflag] = ...
-          bicgstabl(@(V)EVitsol(V,pstar),rstar,[],[],[],[],v);  % update value
+        vnew = peupdate(pstar,rstar,all(xnew==x));
       end
       if constrained, vnew(iknown)=vknown; end
     % modified policy iteration
@@ -167,7 +275,8 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
           ind=ns*xnew+(1-ns:0)';
         end
         rstar=R(ind); rstar=rstar(:)';
-        for k=1:modpol
+        nsweep=mpistart(toc(tmax0));
+        for k=1:nsweep
           vv=vnew;
           if relval>=1, nu=vnew(relval); vnew=vnew-nu; end
           if nargin(P)==1
@@ -179,31 +288,38 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
           end
           if constrained, vnew(iknown)=vknown; end
           MPI=MPI+1;
-          if max(abs(vnew-vv)./max(1,abs(vv)))<1e-12, break; end
+          mpichange(k,max(abs(vnew-vv)./max(1,abs(vv))));
+          if dk<1e-12, break; end
         end
+        mpiend(k);
       else
         [pstar,rstar] = valpol(xnew);
+        nsweep=mpistart(toc(tmax0));
         if colstoch 
-          for k=1:modpol
+          for k=1:nsweep
             vv=vnew;
             if relval>=1, nu=vnew(relval); vnew=vnew-nu; end
             vnew = rstar+d.*(vnew'*pstar)';     % update value
             if constrained, vnew(iknown)=vknown; end
             MPI=MPI+1;
-            if max(abs(vnew-vv)./max(1,abs(vv)))<1e-12, break; end
+            mpichange(k,max(abs(vnew-vv)./max(1,abs(vv))));
+            if dk<1e-12, break; end
           end
         else
-          for k=1:modpol
+          for k=1:nsweep
             vv=vnew;
             if relval>=1, nu=vnew(relval); vnew=vnew-nu; end
             vnew = rstar+d.*(pstar*vnew);      % update value
             if constrained, vnew(iknown)=vknown; end
             MPI=MPI+1;
-            if max(abs(vnew-vv)./max(1,abs(vv)))<1e-12,  break; end
+            mpichange(k,max(abs(vnew-vv)./max(1,abs(vv))));
+            if dk<1e-12,  break; end
           end
         end
+        mpiend(k);
       end
     end
+    if profile, profteval=toc(prof0); prof0=tic; end
     if ~all(abs(vnew)<inf)      % NaNs or infinities in value function
       results.errors={{35,iter}};
       return
@@ -229,6 +345,7 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
         done=true; 
       end 
     end
+    if profile, profrecord(toc(prof0),profteval,xnew,MPI-MPI0+PEiter-PEiter0); end
     if print>1
       if relval>=1
         fprintf ('%5i %10.1e %10.1e %5i %10.4f\n',iter,change,span,numnochange,nu) % print progress
@@ -238,9 +355,15 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
     end
     v=vnew;
     x=xnew;
+    if ~isempty(checkpoint) && (done || toc(tcheck)>=checkpointint)
+      mdpcheckpoint(checkpoint,struct('v',v,'x',x,'iter',iter,'MPI',MPI,'PEiter',PEiter, ...
+                    'numnochange',numnochange,'change',change));
+      tcheck=tic;
+    end
     if done, break; end
   end
   % end of iteration loop
+  if ~isempty(checkpoint), mdpcheckpoint; end   % wait for the last checkpoint
   if iter>=maxit
     % Failure to converge 
     warnings{end+1}={53,maxit};
@@ -264,15 +387,20 @@ function results = mdpsolve_Inf(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
     
   % collect problem information into results structure
   results=struct('v',v,'AR',nu,'Ixopt',x,'pstar',pstar,'iter',iter,'MPI',MPI,'change',change,...
-                 'numnochange',numnochange);
+                 'numnochange',numnochange,'PEiter',PEiter,'MPIdepth',MPIdepth);
   results.warnings=warnings;
   % return the algorithm used
   if relval>=1, results.algorithm=[algorithm 'rv']; 
   else      results.algorithm=algorithm; 
   end
+  if profile
+    results.profile=prof;
+    if ~isempty(profilefile), profwrite(prof,profilefile); end
+  end
     
 % gets the maximized value function
 function [vnew,xnew] = valmax(v)
+  if profile, t0=tic; end
   if EV
     vnew=P(v);
     vnew=vnew(:);
@@ -282,12 +410,133 @@ function [vnew,xnew] = valmax(v)
     end
     if expandP,  vnew=vnew(Iexpand);  end
   end
+  if profile, proftexp=toc(t0); t0=tic; end
   vnew=R+d.*vnew;
   if Xindexed
     [vnew,xnew]=indexmax(vnew,Ix,ns);  % use mex version for greater speed
   else
     [vnew,xnew]=max(reshape(vnew,ns,na),[],2);
   end
+  if profile, proftmax=toc(t0); end
+end
+
+% records the profile information for one iteration
+% npass is the number of iterative passes through the policy 
+% transition matrix (MPI sweeps or iterative solver iterations)
+function profrecord(tcheckk,tevalk,xnew,npass)
+  if EV,              nnzP=0;
+  elseif issparse(P), nnzP=nnz(P);
+  else                nnzP=numel(P);
+  end
+  nnzpol=0;
+  bytes=8*nx+16*ns;                 % expected values and maximization
+  if ~isempty(pstar) && isnumeric(pstar)
+    if issparse(pstar), npol=nnz(pstar); else npol=numel(pstar); end
+    if policyit && strcmp(pesolver,'direct'), npass=npass+1; end
+    nnzpol=npol*npass;
+    bytes=bytes+16*npol+8*ns;       % policy transition matrix and reward
+  end
+  prof.texp(iter,1)=proftexp;
+  prof.tmax(iter,1)=proftmax;
+  prof.teval(iter,1)=tevalk;
+  prof.tcheck(iter,1)=tcheckk;
+  prof.nnz(iter,1)=nnzP+nnzpol;
+  prof.bytes(iter,1)=bytes;
+  prof.nchanged(iter,1)=sum(xnew~=x);
+end
+
+% start the evaluation sweeps: record the time of the maximization step
+% and return the number of sweeps to perform
+function nsweep = mpistart(tmaxk)
+  if isempty(tmax), tmax=tmaxk; else tmax=(tmax+tmaxk)/2; end
+  if ~adaptmpi
+    nsweep=modpol;
+  elseif isempty(teval)
+    nsweep=min(modpol,5);     % short first pass to measure the sweep time
+  else
+    theta=min(0.5,max(0.01,teval/max(tmax,eps)));
+    nsweep=min(modpol,max(1,ceil(log(theta)/log(rho))));
+  end
+  dk1=0;
+  teval0=tic;
+end
+
+% record the change in the value function on evaluation sweep k
+function mpichange(k,change_k)
+  dk=change_k;
+  if k==1, dk1=dk; end
+end
+
+% end the evaluation sweeps after k sweeps: update the sweep time and 
+% contraction rate estimates
+function mpiend(k)
+  tevalk=toc(teval0)/k;
+  if isempty(teval), teval=tevalk; else teval=(teval+tevalk)/2; end
+  if k>1 && dk1>0 && dk>0
+    rhok=min((dk/dk1)^(1/(k-1)),0.999);
+    rho=(rho+rhok)/2;
+  end
+  MPIdepth(iter,1)=k;
+end
+
+% iterative policy evaluation warm-started from the current value
+function vnew = peupdate(pstar,rstar,nochange)
+  if colstoch, A=(spi-mxv(pstar,d))';
+  else         A=spi-vxm(d,pstar);
+  end
+  [vnew,peinfo] = mdp_policyeval(A,rstar,v,petolerance(nochange),pesolver,precond);
+  PEiter=PEiter+peinfo.iter;
+end
+
+% direct policy evaluation reusing the factorization of an earlier policy
+% M is the system matrix in row form (M*v=rstar). If the policy xnew 
+% differs from the factorized policy in k<=smwmax states, M differs from 
+% the factorized matrix M0 only in those k rows, M=M0+E*W' with E=I(:,changed),
+% and the Sherman-Morrison-Woodbury formula gives
+%   inv(M)*r = y - Z*inv(I+W'*Z)*W'*y,  y=inv(M0)*r, Z=inv(M0)*E
+function vnew = smwupdate(pstar,rstar,xnew)
+  if colstoch, M=(spi-mxv(pstar,d))';
+  else         M=spi-vxm(d,pstar);
+  end
+  if ~isempty(Mfac)
+    changed=find(xnew~=Mfac.x);
+    nchg=length(changed);
+  end
+  if isempty(Mfac) || nchg>smwmax
+    % factorize the current system
+    Mfac.x=xnew;
+    Mfac.M=M;
+    if issparse(M)
+      [Mfac.L,Mfac.U,Mfac.P,Mfac.Q]=lu(M);
+    else
+      [Mfac.L,Mfac.U,Mfac.P]=lu(M);
+      Mfac.Q=[];
+    end
+    vnew=lusolve(rstar);
+  elseif nchg==0
+    vnew=lusolve(rstar);
+  else
+    Wt=M(changed,:)-Mfac.M(changed,:);
+    y=lusolve(rstar);
+    Z=lusolve(full(sparse(changed,1:nchg,1,ns,nchg)));
+    vnew=y-Z*((eye(nchg)+Wt*Z)\(Wt*y));
+  end
+end
+
+% solve using the cached LU factors
+function sol = lusolve(b)
+  sol=Mfac.U\(Mfac.L\(Mfac.P*b));
+  if ~isempty(Mfac.Q), sol=Mfac.Q*sol; end
+end
+
+% tolerance for iterative policy evaluation
+% loose while the policy is changing, petol once it has settled
+function tolk = petolerance(nochange)
+  if nochange
+    tolk=petol;
+  else
+    tolk=max(petol,min(1e-3,0.1*change/max(1,max(abs(v)))));
+  end
 end
 
 function [pstar,rstar] = valpol(x)
@@ -309,6 +558,30 @@ end
 
 end
 
+% writes the profile to a CSV or JSON file (chosen by the extension)
+function profwrite(prof,filename)
+  fnames=fieldnames(prof);
+  n=length(prof.texp);
+  fid=fopen(filename,'w');
+  if fid<0, warning(['Cannot open ' filename]); return; end
+  [~,~,ext]=fileparts(filename);
+  if strcmpi(ext,'.json')
+    s=sprintf('%d,',1:n);
+    fprintf(fid,'{\n  "iter": [%s]',s(1:end-1));
+    for i=1:length(fnames)
+      s=sprintf('%.6g,',prof.(fnames{i}));
+      fprintf(fid,',\n  "%s": [%s]',fnames{i},s(1:end-1));
+    end
+    fprintf(fid,'\n}\n');
+  else
+    fprintf(fid,'iter%s\n',sprintf(',%s',fnames{:}));
+    data=zeros(n,length(fnames));
+    for i=1:length(fnames), data(:,i)=prof.(fnames{i}); end
+    fprintf(fid,['%d' repmat(',%.6g',1,length(fnames)) '\n'],[(1:n)' data]');
+  end
+  fclose(fid);
+end
+
 function f=getfunc(P,d,colstoch)
     if isa(P,'function_handle')
       if nargin(P)==1
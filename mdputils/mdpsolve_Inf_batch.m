@@ -0,0 +1,255 @@
+% mdpsolve_Inf_batch Solves a batch of infinite horizon dynamic programs that share P
+% USAGE
+%  results = mdpsolve_Inf_batch(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
+%         Xindexed,expandP,v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,vknown,infopts);
+%
+% The arguments are the same as those of mdpsolve_Inf except that
+%   R : nx x K matrix; column k is the reward of problem k
+%   d : scalar, nx-vector or 1 x K vector (one discount factor per problem)
+% The K problems share the transition matrix P and the index vectors.
+% The expected future value of every problem is computed at once with a
+% sparse matrix times matrix product (P*V with V ns x K) so P is read once
+% per iteration rather than once per problem. Problems are dropped from
+% the batch as they converge. The policy evaluation step (the direct solve
+% for policy iteration or the modified policy iteration sweeps) uses the
+% ns x ns matrix of each problem's current policy and is done separately
+% for each problem.
+%
+% Models that use EV, relval, vanish, vknown, undiscounted problems,
+% algorithm 'i' or an iterative policy evaluation solver are solved one
+% problem at a time with mdpsolve_Inf. adaptmpi and smwmax are only used
+% in that case.
+%
+% The results fields v and Ixopt are ns x K and iter, change and
+% numnochange are 1 x K. pstar is not returned.
+%
+% Called by mdpsolve
+
+% MDPSOLVE: MATLAB tools for solving Markov Decision Problems
+% Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
+% All rights reserved.
+%
+% Redistribution and use in source and binary forms, with or without
+% modification, are permitted provided that the following conditions are met:
+%
+%    * Redistributions of source code must retain the above copyright notice,
+%        this list of conditions and the following disclaimer.
+%    * Redistributions in binary form must reproduce the above copyright notice,
+%        this list of conditions and the following disclaimer in the
+%        documentation and/or other materials provided with the distribution.
+%    * Neither the name of the North Carolina State University nor of Paul L.
+%        Fackler may be used to endorse or promote products derived from this
+%        software without specific prior written permission.
+%
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+% FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+% DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+% SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+% CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+% OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+% OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+%
+% For more information, see the Open Source Initiative OSI site:
+%   http://www.opensource.org/licenses/bsd-license.php
+
+function results = mdpsolve_Inf_batch(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV, ...
+         Xindexed,expandP,v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,vknown,infopts)
+  if nargin<22 || isempty(infopts), infopts=struct(); end
+  K=size(R,2);
+  % d holds one discount factor for each problem
+  dbatch = K>1 && size(d,1)==1 && size(d,2)==K;
+
+  pesolver='auto'; pedirectmax=10000;
+  if isfield(infopts,'pesolver'),    pesolver=lower(infopts.pesolver);  end
+  if isfield(infopts,'pedirectmax'), pedirectmax=infopts.pedirectmax;   end
+  if strcmp(pesolver,'auto')
+    if ns<=pedirectmax || ~issparse(P), pesolver='direct'; end
+  end
+
+  % features not handled by the batched iterations: solve one at a time
+  if any(EV) || relval>0 || vanish>0 || any(d(:)==1) || ~isempty(vknown) ...
+      || algorithm=='i' || (algorithm=='p' && ~strcmp(pesolver,'direct'))
+    results=solveeach;
+    return
+  end
+
+  nochangemin=5;   % safety feature to prevent early convergence with function iteration
+  policyit = algorithm=='p';
+  if print>1
+    if policyit
+      disp(['Solve ' num2str(K) ' Bellman equations using policy iteration']);
+    else
+      disp(['Solve ' num2str(K) ' Bellman equations using function iteration']);
+    end
+  end
+
+  % convergence tolerance for each problem
+  if dbatch
+    tolk=tol*(1-d)./d;
+  else
+    tolk=repmat(tol*(1-max(d))/max(d),1,K);
+  end
+  na=nx/ns;
+  MPI=0;
+  V=repmat(v(:),1,K);
+  X=zeros(ns,K);
+  iterk=zeros(1,K);
+  change=inf(1,K);
+  numnochange=zeros(1,K);
+  active=1:K;                  % problems that have not converged
+  iter=0;
+% %%%%%%% MAIN ITERATION LOOP %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+  while iter<maxit && ~isempty(active)
+    iter=iter+1;
+    iterk(active)=iter;
+    [Vnew,Xnew] = valmax(V(:,active),active);
+    done=false(1,length(active));
+    for j=1:length(active)
+      k=active(j);
+      vnew=Vnew(:,j);
+      xnew=Xnew(:,j);
+      % update value if policy iteration is used
+      if policyit
+        [pstar,rstar,dstar] = valpol(xnew,k);
+        if colstoch
+          vnew = (rstar'/(speye(ns)-mxv(pstar,dstar)))';  % update value
+        else
+          vnew = (speye(ns)-vxm(dstar,pstar))\rstar;      % update value
+        end
+      % modified policy iteration
+      elseif modpol>0
+        [pstar,rstar,dstar] = valpol(xnew,k);
+        for it=1:modpol
+          vv=vnew;
+          if colstoch
+            vnew = rstar+dstar.*(vnew'*pstar)';   % update value
+          else
+            vnew = rstar+dstar.*(pstar*vnew);     % update value
+          end
+          MPI=MPI+1;
+          if max(abs(vnew-vv)./max(1,abs(vv)))<1e-12, break; end
+        end
+      end
+      if ~all(abs(vnew)<inf)      % NaNs or infinities in value function
+        results.errors={{35,iter}};
+        return
+      end
+      % check if policy has changed
+      xnochange=all(xnew==X(:,k));
+      if xnochange, numnochange(k)=numnochange(k)+1;
+      else          numnochange(k)=0;
+      end
+      change(k)=max(abs(vnew-V(:,k)));
+      % check for convergence
+      if policyit
+        done(j)=xnochange;
+      else
+        done(j)=(change(k)<=tolk(k) && numnochange(k)>=nochangemin) ...
+                 || numnochange(k)==nochangelim;
+      end
+      V(:,k)=vnew;
+      X(:,k)=xnew;
+    end
+    if print>1
+      fprintf ('%5i %10.1e %5i\n',iter,max(change(active)),length(active)) % print progress
+    end
+    active(done)=[];
+  end
+  % end of iteration loop
+  warnings={};
+  if ~isempty(active)
+    % Failure to converge
+    warnings{end+1}={53,maxit};
+  end
+  % for problems with R ns x na need to transform a to x
+  if ~Xindexed
+    X=bsxfun(@plus,ns*X,(1-ns:0)');
+  end
+  % collect problem information into results structure
+  results=struct('v',V,'AR',[],'Ixopt',X,'pstar',[],'iter',iterk,'MPI',MPI,'change',change,...
+                 'numnochange',numnochange,'PEiter',0,'MPIdepth',[]);
+  results.warnings=warnings;
+  results.algorithm=algorithm;
+
+% gets the maximized value functions of the problems in cols
+% the expected future values for all of the problems are obtained
+% with a single pass through P
+function [Vnew,Xnew] = valmax(Va,cols)
+  nc=length(cols);
+  if colstoch, Vnew=(Va'*P)';
+  else         Vnew=P*Va;
+  end
+  if expandP,  Vnew=Vnew(Iexpand,:);  end
+  if dbatch,             Vnew=mxv(Vnew,d(cols));
+  elseif numel(d)==1,    Vnew=d*Vnew;
+  else                   Vnew=vxm(d,Vnew);
+  end
+  Vnew=R(:,cols)+Vnew;
+  if Xindexed
+    Vm=zeros(ns,nc);
+    Xnew=zeros(ns,nc);
+    for jj=1:nc
+      [Vm(:,jj),Xnew(:,jj)]=indexmax(Vnew(:,jj),Ix,ns);  % use mex version for greater speed
+    end
+    Vnew=Vm;
+  else
+    [Vnew,Xnew]=max(reshape(Vnew,ns,na,nc),[],2);
+    Vnew=reshape(Vnew,ns,nc);
+    Xnew=reshape(Xnew,ns,nc);
+  end
+end
+
+% transition matrix, reward and discount of policy x for problem k
+function [pstar,rstar,dstar] = valpol(x,k)
+  if Xindexed
+    ind=x;
+  else
+    ind=ns*x+(1-ns:0)';
+  end
+  rstar=R(ind,k);
+  if dbatch,          dstar=d(k);
+  elseif numel(d)==1, dstar=d;
+  else                dstar=d(ind);
+  end
+  if expandP
+    ind=Iexpand(ind);
+  end
+  if colstoch
+    pstar=P(:,ind);
+  else
+    pstar=P(ind,:);
+  end
+end
+
+% solves the problems one at a time with mdpsolve_Inf
+function results = solveeach
+  for kk=1:K
+    if dbatch, dk=d(kk); else dk=d; end
+    resk = mdpsolve_Inf(R(:,kk),P,dk,ns,nx,Ix,Iexpand,colstoch,EV,Xindexed,expandP, ...
+            v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,vknown,infopts);
+    if isfield(resk,'errors') && ~isempty(resk.errors)
+      results=resk;
+      return
+    end
+    if kk==1
+      results=resk;
+      results.pstar=[];
+      results.MPIdepth=[];
+    else
+      results.v(:,kk)=resk.v;
+      results.Ixopt(:,kk)=resk.Ixopt;
+      if ~isempty(resk.AR), results.AR(1,kk)=resk.AR; end
+      results.iter(1,kk)=resk.iter;
+      results.change(1,kk)=resk.change;
+      results.numnochange(1,kk)=resk.numnochange;
+      results.MPI=results.MPI+resk.MPI;
+      results.PEiter=results.PEiter+resk.PEiter;
+      results.warnings=[results.warnings resk.warnings];
+    end
+  end
+end
+
+end
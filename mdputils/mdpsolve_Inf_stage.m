@@ -1,7 +1,11 @@
 % mdpsolve_Inf_stage Solves discrete-state/action infinite horizon dynamic program with stages
 % USAGE
 %  results = mdpsolve_Inf_stage(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexed,expandP, ...
-%         nstage,nrep,v,algorithm,relval,vanish,maxit,tol,nochangelim,print);
+%         nstage,nrep,v,algorithm,relval,vanish,maxit,tol,nochangelim,print,checks,infopts);
+%
+% infopts is an optional structure with the fields checkpoint, checkpointint
+% and resume (see mdpsolve_Inf). The checkpoint holds the value functions
+% and strategies of every stage and replication.
 %
 % Called by mdpsolve
 
@@ -36,13 +40,18 @@
 %   http://www.opensource.org/licenses/bsd-license.php
 
 function results = mdpsolve_Inf_stage(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexed,expandP, ...
-         nstage,nrep,v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,checks)
+         nstage,nrep,v,algorithm,modpol,relval,vanish,maxit,tol,nochangelim,print,checks,infopts)
        
        % let relval be a real number on [0 1] to obtain the vanishing discount approach
        % or an integer between 1 and ns to use the relative value approach with 
        % relval indicating which state to replace
        
   nochangemin=5;
+  if nargin<24 || isempty(infopts), infopts=struct(); end
+  checkpoint=''; checkpointint=300; resume=false;
+  if isfield(infopts,'checkpoint'),    checkpoint=infopts.checkpoint;       end
+  if isfield(infopts,'checkpointint'), checkpointint=infopts.checkpointint; end
+  if isfield(infopts,'resume'),        resume=infopts.resume;               end
       
   if isempty(v) 
     vnew=zeros(ns,1); 
@@ -122,6 +131,33 @@ function results = mdpsolve_Inf_stage(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexe
   iter=0;
   nu=-inf;
   W={}; % cell array for warnings
+  % continue from a checkpoint
+  if resume && ~isempty(checkpoint)
+    state=mdpcheckpoint(checkpoint);
+    if isstruct(state) && all(isfield(state,{'vnew','iter','numnochange','nu'})) ...
+        && numel(state.vnew)==numel(vnew)
+      ok=true;
+      for i=1:nstage
+        Vi=sprintf('V%d',i); Xi=sprintf('X%d',i);
+        if ~isfield(state,Vi) || ~isfield(state,Xi) || ~isequal(size(state.(Vi)),size(V{i}))
+          ok=false;
+        end
+      end
+    else
+      ok=false;
+    end
+    if ok
+      for i=1:nstage
+        V{i}=state.(sprintf('V%d',i));
+        X{i}=state.(sprintf('X%d',i));
+      end
+      vnew=state.vnew; iter=state.iter; numnochange=state.numnochange; nu=state.nu;
+    elseif isstruct(state)
+      W{end+1}={54};
+    end
+    clear state
+  end
+  tcheck=tic;
 % %%%%%%% MAIN ITERATION LOOP %%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
   while iter<maxit 
     iter=iter+1; 
@@ -214,9 +250,20 @@ function results = mdpsolve_Inf_stage(R,P,d,ns,nx,Ix,Iexpand,colstoch,EV,Xindexe
       end 
     end   
     %V{1}(:,1)=vnew; 
+    if ~isempty(checkpoint) && (done || toc(tcheck)>=checkpointint)
+      state=struct('vnew',vnew,'iter',iter,'numnochange',numnochange,'nu',nu);
+      for i=1:nstage
+        state.(sprintf('V%d',i))=V{i};
+        state.(sprintf('X%d',i))=X{i};
+      end
+      mdpcheckpoint(checkpoint,state);
+      clear state
+      tcheck=tic;
+    end
     if done, break; end
   end
   % end of iteration loop
+  if ~isempty(checkpoint), mdpcheckpoint; end   % wait for the last checkpoint
     
   % for non-discounted problems adjust the value function to
   % output the average reward function
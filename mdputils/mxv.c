@@ -1,58 +1,112 @@
 #include "mex.h"
 #include <math.h>
+#include <string.h>
 /*
 % mxv Computes A*diag(b) (matrix times vector)
 % USAGE
-%   C=mxv(A,b);
+%   C=mxv(A,b,overwrite);
 % INPUTS
-%   A : mxn matrix (full or sparse)
-%   b : full n-vector (or scalar)
+%   A         : mxn matrix (full or sparse)
+%   b         : full n-vector (or scalar)
+%   overwrite : 1 to compute the result in the memory used by A
+%                 [default: 0]
 % OUTPUT
-%   C   : mxn matrix 
+%   C   : mxn matrix
 %
-% Note: not implemented for complex matrices or matrices 
+% Note: not implemented for complex matrices or matrices
 % with data type other than double. b must be full but
 % A can be sparse or full.
+%
+% The overwrite option is only honored if the MEX file is compiled
+% with MDP_INPLACE defined and A is not shared with another MATLAB
+% variable; otherwise a new array is created. Use it in the form
+% A=mxv(A,b,1).
+%
+% Columns are processed in parallel when compiled with OpenMP.
 
 % Copyright (c) 2010, Paul L. Fackler, NCSU
 % paul_fackler@ncsu.edu
 */
 
+#ifdef MDP_INPLACE
+// undocumented MATLAB API function
+extern bool mxIsSharedArray(const mxArray *pa);
+#define canoverwrite(A) (!mxIsSharedArray(A))
+#else
+#define canoverwrite(A) false
+#endif
+
+// minimum number of elements for multi-threading
+#define MINPARALLEL 100000
 
-/* A times diag(b) - full A */
-void axdbf(double *A, double *b, mwSize m, mwSize n)
+/* C = A times diag(b) - full A (C can be A) */
+void axdbf(const double *A, const double *b, double *C, mwSize m, mwSize n)
 {
-  double *Ajend,*Aend, bval;
-  Ajend=A;
-  Aend=A+m*n;
-  while(A<Aend){
-    bval=*b++;
-    Ajend += m;
-    while(A<Ajend) *A++ *= bval;
+  mwSignedIndex j;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m*n>MINPARALLEL)
+#endif
+  for (j=0; j<(mwSignedIndex)n; j++){
+    const double *Aj=A+j*m;
+    double *Cj=C+j*m, bval=b[j];
+    mwIndex i;
+    for (i=0; i<m; i++) Cj[i] = Aj[i]*bval;
   }
 }
 
-/* A times diag(b) - sparse A */
-void axdbs(double *A, double *b, mwIndex *Aj, mwSize nnz)
+/* C = A times diag(b) - sparse A (C can be A) */
+void axdbs(const double *A, const double *b, const mwIndex *Aj, double *C,
+           mwSize n)
 {
-  double *Aptr, *Anext, *Aend, bval;
-  Aptr=A;
-  Aend=A+nnz;
-  while (Aptr<Aend){
-    bval=*b++;
-    Anext = A+ *(++Aj);
-    while (Aptr<Anext) *Aptr++ *= bval;
+  mwSignedIndex j;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(Aj[n]>MINPARALLEL)
+#endif
+  for (j=0; j<(mwSignedIndex)n; j++){
+    double bval=b[j];
+    mwIndex k, kend=Aj[j+1];
+    for (k=Aj[j]; k<kend; k++) C[k] = A[k]*bval;
   }
 }
 
+/* C = A times b - scalar b (C can be A) */
+void axbs(const double *A, double b, double *C, mwSize nnz)
+{
+  mwSignedIndex i;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(nnz>MINPARALLEL)
+#endif
+  for (i=0; i<(mwSignedIndex)nnz; i++) C[i] = A[i]*b;
+}
+
+/* creates an output array with the same structure as A
+   (the values are not copied) or returns A itself if it can be
+   overwritten */
+mxArray *getoutput(const mxArray *A, bool overwrite)
+{
+  mxArray *C;
+  mwSize m, n, nnz;
+  if (overwrite && canoverwrite(A)) return((mxArray *)A);
+  m=mxGetM(A);
+  n=mxGetN(A);
+  if (mxIsSparse(A)){
+    nnz=mxGetJc(A)[n];
+    C=mxCreateSparse(m,n,nnz>0 ? nnz : 1,mxREAL);
+    memcpy(mxGetIr(C),mxGetIr(A),nnz*sizeof(mwIndex));
+    memcpy(mxGetJc(C),mxGetJc(A),(n+1)*sizeof(mwIndex));
+  }
+  else
+    C=mxCreateNumericArray(mxGetNumberOfDimensions(A),mxGetDimensions(A),
+                           mxDOUBLE_CLASS,mxREAL);
+  return(C);
+}
 
 
 void mexFunction(
     int nlhs, mxArray *plhs[],
     int nrhs, const mxArray *prhs[])
-{  double *A, *B, b;
+{  double *A, *B, *C, b;
    mwSize m, n, nb;
-   mwIndex i;
    bool overwrite;
 
    if (nrhs<2)
@@ -61,44 +115,36 @@ void mexFunction(
       mexErrMsgTxt("At most three parameters can be passed");
    if (nlhs>1)
       mexErrMsgTxt("Only one output is created");
-   if (!mxIsDouble(prhs[0]) &&  !mxIsSparse(prhs[0]))
-      mexErrMsgTxt("First input must be numeric"); 
+   if (!mxIsDouble(prhs[0]))
+      mexErrMsgTxt("First input must be double");
    if (!mxIsDouble(prhs[1]) ||  mxIsSparse(prhs[1]))
       mexErrMsgTxt("Second input must be a full vector");
    if (mxIsComplex(prhs[0]) || mxIsComplex(prhs[1]))
       mexErrMsgTxt("Inputs must be real");
-   
+
    overwrite=false;
-   if (nrhs>2 && *mxGetPr(prhs[2])!=0)  overwrite=true;
-   
-   m=mxGetM(prhs[0]); 
+   if (nrhs>2 && mxGetScalar(prhs[2])!=0)  overwrite=true;
+
+   m=mxGetM(prhs[0]);
    n=mxGetN(prhs[0]);
    nb=mxGetNumberOfElements(prhs[1]);
+   A=mxGetPr(prhs[0]);
    if (nb==1){  /* b is scalar */
        b=*mxGetPr(prhs[1]);
-       if (overwrite) plhs[0]=prhs[0];
-       else           plhs[0]=mxDuplicateArray(prhs[0]);
-       A=mxGetPr(plhs[0]);
-       if (mxIsSparse(plhs[0])){
-         mwIndex *Aj;
-         Aj=mxGetJc(plhs[0]);
-         m=Aj[n];
-       }
-       else m *= n;
-       for (i=0; i<m; i++) A[i]*=b;   
+       plhs[0]=getoutput(prhs[0],overwrite);
+       C=mxGetPr(plhs[0]);
+       if (mxIsSparse(prhs[0])) m=mxGetJc(prhs[0])[n];
+       else                     m=mxGetNumberOfElements(prhs[0]);
+       axbs(A,b,C,m);
    }
    else if (nb==n){ /* b has the right number of elements */
      B=mxGetPr(prhs[1]);
-     if (overwrite) plhs[0]=prhs[0];
-     else           plhs[0]=mxDuplicateArray(prhs[0]);
-     A=mxGetPr(plhs[0]);
-     if (mxIsSparse(plhs[0])){
-       mwIndex *Aj;
-       Aj=mxGetJc(plhs[0]);
-       axdbs(A,B,Aj,Aj[n]);
-     }
+     plhs[0]=getoutput(prhs[0],overwrite);
+     C=mxGetPr(plhs[0]);
+     if (mxIsSparse(prhs[0]))
+       axdbs(A,B,mxGetJc(prhs[0]),C,n);
      else
-       axdbf(A,B,m,n);
+       axdbf(A,B,C,m,n);
    }
    else
       mexErrMsgTxt("Inputs are not conformable");
@@ -0,0 +1,305 @@
+#define _FILE_OFFSET_BITS 64
+#include "mex.h"
+#include <stdio.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+/*
+% pfilemult Expected values using a transition matrix stored in a file
+% USAGE
+%   EV=pfilemult(filename,V,blocksize);
+% INPUTS
+%   filename  : name of a file created by pfilewrite holding the
+%                 ns x nx column stochastic matrix P or a model file
+%                 created by mdpsave
+%   V         : ns x K matrix of values
+%   blocksize : size (in MB) of the blocks of P read from the file
+%                 [default: 64]
+% OUTPUT
+%   EV        : nx x K matrix equal to P'*V
+%
+% P is never held in memory. The file is read in blocks of columns with
+% large sequential reads. When compiled with OpenMP one thread reads the
+% next block while the other threads compute with the current one, so
+% for large P the time is close to the time needed to read the file.
+% Memory use is two blocks plus the nx+1 column pointers.
+%
+% To use a stored P with mdpsolve use the EV option:
+%   model.P=@(v) pfilemult(filename,v); model.EV=1;
+%
+% Coded as a MEX file
+*/
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+#define PFILE_MAGIC   0x5050444d   /* "MDPP" */
+#define PFILE_VERSION 1
+#define MODEL_MAGIC   0x4d50444d   /* "MDPM" (mdpsave) */
+
+struct pfileheader {
+  int magic;
+  int version;
+  int idxbytes;    /* 4 or 8 bytes per row index */
+  int reserved;
+  long long m;     /* number of rows (ns) */
+  long long n;     /* number of columns (nx) */
+  long long nnz;
+  long long jcoffset;  /* file positions of the arrays */
+  long long iroffset;
+  long long proffset;
+};
+
+/* directory entry of a model file */
+struct modelentry {
+  char name[32];
+  int type;        /* 0: P descriptor, 1: double, 2: int64, 3: uint32 */
+  int reserved;
+  long long rows;
+  long long cols;
+  long long offset;
+};
+
+/* buffers for one block of columns */
+struct pblock {
+  mwIndex c0, c1;  /* columns c0 to c1-1 */
+  void *ir;
+  double *pr;
+};
+
+/* reads the row indices and values of columns c0 to c1-1 into b;
+   returns 0 on success (1 if the read fails or a row index is not
+   less than the number of rows) */
+static int readblock(FILE *fid, const struct pfileheader *h,
+                     const long long *jc, struct pblock *b,
+                     mwIndex c0, mwIndex c1)
+{
+  long long k0=jc[c0], nk=jc[c1]-jc[c0], k;
+  b->c0=c0;
+  b->c1=c1;
+  if (nk==0) return(0);
+  if (fseek64(fid,h->iroffset+k0*h->idxbytes,SEEK_SET)) return(1);
+  if (fread(b->ir,h->idxbytes,(size_t)nk,fid)!=(size_t)nk) return(1);
+  if (fseek64(fid,h->proffset+k0*sizeof(double),SEEK_SET)) return(1);
+  if (fread(b->pr,sizeof(double),(size_t)nk,fid)!=(size_t)nk) return(1);
+  // the row indices are used to index V so they must be checked
+  if (h->idxbytes==4){
+    const unsigned int *ir=(const unsigned int *)b->ir;
+    for (k=0; k<nk; k++) if ((long long)ir[k]>=h->m) return(1);
+  }
+  else{
+    const long long *ir=(const long long *)b->ir;
+    for (k=0; k<nk; k++) if (ir[k]<0 || ir[k]>=h->m) return(1);
+  }
+  return(0);
+}
+
+/* fills in h from the directory of a model file created by mdpsave;
+   the file position must follow the magic number; returns 0 on success */
+static int readmodelheader(FILE *fid, struct pfileheader *h)
+{
+  struct modelentry e;
+  int hdr[3], i, found=0;
+  long long filesize;
+  if (fread(hdr,sizeof(int),3,fid)!=3 || hdr[0]!=1) return(1);
+  if (fread(&filesize,sizeof(long long),1,fid)!=1) return(1);
+  h->version=PFILE_VERSION;
+  for (i=0; i<hdr[1]; i++){
+    if (fread(&e,sizeof(e),1,fid)!=1) return(1);
+    e.name[31]=0;
+    if (strcmp(e.name,"P")==0 && e.type==0){
+      h->m=e.rows; h->n=e.cols; found|=1;
+    }
+    else if (strcmp(e.name,"P.jc")==0){
+      h->jcoffset=e.offset; found|=2;
+    }
+    else if (strcmp(e.name,"P.ir")==0){
+      h->iroffset=e.offset; h->nnz=e.rows*e.cols; found|=4;
+      h->idxbytes = e.type==3 ? 4 : 8;
+    }
+    else if (strcmp(e.name,"P.pr")==0){
+      h->proffset=e.offset; found|=8;
+    }
+  }
+  return(found!=15);
+}
+
+/* EV(j,:) = P(:,j)'*V for columns c0 to c1-1 of the block */
+static void multblock(const struct pfileheader *h, const long long *jc,
+                      const struct pblock *b, mwIndex c0, mwIndex c1,
+                      const double *V, double *EV, mwSize K)
+{
+  mwIndex j, kk, m=(mwIndex)h->m, n=(mwIndex)h->n;
+  long long k, kb=jc[b->c0];
+  const double *pr=b->pr;
+  double s;
+  if (h->idxbytes==4){
+    const unsigned int *ir=(const unsigned int *)b->ir;
+    for (j=c0; j<c1; j++){
+      for (kk=0; kk<K; kk++){
+        const double *Vk=V+kk*m;
+        s=0;
+        for (k=jc[j]; k<jc[j+1]; k++) s+=pr[k-kb]*Vk[ir[k-kb]];
+        EV[j+kk*n]=s;
+      }
+    }
+  }
+  else{
+    const long long *ir=(const long long *)b->ir;
+    for (j=c0; j<c1; j++){
+      for (kk=0; kk<K; kk++){
+        const double *Vk=V+kk*m;
+        s=0;
+        for (k=jc[j]; k<jc[j+1]; k++) s+=pr[k-kb]*Vk[ir[k-kb]];
+        EV[j+kk*n]=s;
+      }
+    }
+  }
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  char *filename;
+  FILE *fid;
+  struct pfileheader h;
+  struct pblock blk[2];
+  long long *jc, target, maxnnz;
+  mwIndex *cut, nblock, b, j, n;
+  mwSize K;
+  double *V, *EV, blocksize;
+  int nthreads, ioerr;
+
+  if (nrhs<2) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>3) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  if (!mxIsChar(prhs[0]))
+    mexErrMsgTxt("filename must be a string");
+  if (!mxIsDouble(prhs[1]) || mxIsSparse(prhs[1]) || mxIsComplex(prhs[1]))
+    mexErrMsgTxt("V must be a real full double matrix");
+  blocksize=64;
+  if (nrhs>2 && !mxIsEmpty(prhs[2])) blocksize=mxGetScalar(prhs[2]);
+  if (blocksize<=0) mexErrMsgTxt("blocksize must be positive");
+
+  filename=mxArrayToString(prhs[0]);
+  fid=fopen(filename,"rb");
+  mxFree(filename);
+  if (fid==NULL) mexErrMsgTxt("Cannot open file");
+  if (fread(&h.magic,sizeof(int),1,fid)!=1) h.magic=0;
+  if (h.magic==MODEL_MAGIC){
+    if (readmodelheader(fid,&h)){
+      fclose(fid);
+      mexErrMsgTxt("File does not contain a transition matrix");
+    }
+  }
+  else if (h.magic!=PFILE_MAGIC ||
+      fread(&h.version,sizeof(h)-sizeof(int),1,fid)!=1){
+    fclose(fid);
+    mexErrMsgTxt("File was not created by pfilewrite or mdpsave");
+  }
+  if (h.version!=PFILE_VERSION || (h.idxbytes!=4 && h.idxbytes!=8)){
+    fclose(fid);
+    mexErrMsgTxt("Unsupported file version");
+  }
+  if ((long long)mxGetM(prhs[1])!=h.m){
+    fclose(fid);
+    mexErrMsgTxt("V must have ns rows (the number of rows of P)");
+  }
+  n=(mwIndex)h.n;
+  K=mxGetN(prhs[1]);
+  V=mxGetPr(prhs[1]);
+
+  // column pointers
+  jc=mxMalloc((n+1)*sizeof(long long));
+  if (fseek64(fid,h.jcoffset,SEEK_SET) || fread(jc,sizeof(long long),n+1,fid)!=n+1 || jc[n]!=h.nnz){
+    fclose(fid);
+    mexErrMsgTxt("Error reading file");
+  }
+  // the column pointers determine the sizes of the reads
+  for (j=0; j<n && jc[0]==0 && jc[j+1]>=jc[j]; j++);
+  if (j<n || jc[0]!=0){
+    fclose(fid);
+    mexErrMsgTxt("Error reading file");
+  }
+
+  // divide the columns into blocks with about target non-zeros
+  target=(long long)(blocksize*1048576/(h.idxbytes+sizeof(double)));
+  if (target<1) target=1;
+  cut=mxMalloc((n+1)*sizeof(mwIndex));
+  cut[0]=0;
+  nblock=0;
+  maxnnz=1;
+  for (j=1; j<=n; j++){
+    if (jc[j]-jc[cut[nblock]]>=target || j==n){
+      nblock++;
+      cut[nblock]=j;
+      if (jc[j]-jc[cut[nblock-1]]>maxnnz) maxnnz=jc[j]-jc[cut[nblock-1]];
+    }
+  }
+  blk[0].ir=mxMalloc((size_t)maxnnz*h.idxbytes);
+  blk[0].pr=mxMalloc((size_t)maxnnz*sizeof(double));
+  blk[1].ir=nblock>1 ? mxMalloc((size_t)maxnnz*h.idxbytes) : NULL;
+  blk[1].pr=nblock>1 ? mxMalloc((size_t)maxnnz*sizeof(double)) : NULL;
+
+  plhs[0]=mxCreateDoubleMatrix(n,K,mxREAL);
+  EV=mxGetPr(plhs[0]);
+
+#ifdef _OPENMP
+  nthreads=omp_get_max_threads();
+#else
+  nthreads=1;
+#endif
+
+  ioerr=0;
+  if (nblock>0) ioerr=readblock(fid,&h,jc,&blk[0],cut[0],cut[1]);
+  for (b=0; b<nblock && !ioerr; b++){
+    struct pblock *cur=&blk[b%2], *next=&blk[(b+1)%2];
+    int readnext=(b+1<nblock);
+    if (nthreads<2){
+      multblock(&h,jc,cur,cur->c0,cur->c1,V,EV,K);
+      if (readnext) ioerr=readblock(fid,&h,jc,next,cut[b+1],cut[b+2]);
+    }
+    else{
+      // thread 0 reads the next block, the others work on the current one
+      // (the team can be smaller than requested so its size is used)
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+      {
+      int tid=0, nw=0, w;
+      mwIndex ncol=cur->c1-cur->c0, w0, w1;
+#ifdef _OPENMP
+      tid=omp_get_thread_num();
+      nw=omp_get_num_threads()-1;
+#endif
+      if (tid==0){
+        if (readnext && readblock(fid,&h,jc,next,cut[b+1],cut[b+2])) ioerr=1;
+        // a team of one reads and then multiplies
+        if (nw==0) multblock(&h,jc,cur,cur->c0,cur->c1,V,EV,K);
+      }
+      else{
+        w=tid-1;
+        w0=cur->c0+(ncol*w)/nw;
+        w1=cur->c0+(ncol*(w+1))/nw;
+        multblock(&h,jc,cur,w0,w1,V,EV,K);
+      }
+      }
+    }
+  }
+
+  fclose(fid);
+  mxFree(jc);
+  mxFree(cut);
+  mxFree(blk[0].ir);
+  mxFree(blk[0].pr);
+  if (blk[1].ir!=NULL){
+    mxFree(blk[1].ir);
+    mxFree(blk[1].pr);
+  }
+  if (ioerr) mexErrMsgTxt("Error reading file");
+}
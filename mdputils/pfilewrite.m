@@ -0,0 +1,121 @@
+% pfilewrite Writes a transition matrix to a file for use with pfilemult
+% USAGE
+%   pfilewrite(filename,P,colstoch);
+% INPUTS
+%   filename : name of the file to create
+%   P        : transition matrix or a cell array of blocks of P
+%   colstoch : 1 if P is ns x nx (column stochastic), 0 if P is nx x ns
+%                [default: 1]
+%
+% If P is a cell array each element is a block of columns of P (or of
+% rows if colstoch=0) or a function handle with no arguments that returns
+% the block (e.g., created with saveget). Only one block is held in
+% memory at a time so files can be created for matrices too large to
+% hold in memory.
+%
+% The file holds P in compressed sparse column form (column stochastic
+% orientation) and is read with pfilemult:
+%   EV=pfilemult(filename,V);    % EV=P'*V
+% It can be used with mdpsolve with the EV option:
+%   model.P=@(v) pfilemult(filename,v); model.EV=1;
+%
+% File layout (native byte order):
+%   header: 'MDPP', int32 version, int32 index bytes (4 or 8), int32 0,
+%           int64 ns, nx, nnz and the offsets of the 3 arrays below
+%   row indices (0-based, uint32 if ns<2^32 or int64), values (double),
+%   column pointers (int64, nx+1)
+
+% MDPSOLVE: MATLAB tools for solving Markov Decision Problems
+% Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
+% All rights reserved.
+%
+% Redistribution and use in source and binary forms, with or without
+% modification, are permitted provided that the following conditions are met:
+%
+%    * Redistributions of source code must retain the above copyright notice,
+%        this list of conditions and the following disclaimer.
+%    * Redistributions in binary form must reproduce the above copyright notice,
+%        this list of conditions and the following disclaimer in the
+%        documentation and/or other materials provided with the distribution.
+%    * Neither the name of the North Carolina State University nor of Paul L.
+%        Fackler may be used to endorse or promote products derived from this
+%        software without specific prior written permission.
+%
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+% FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+% DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+% SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+% CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+% OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+% OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+%
+% For more information, see the Open Source Initiative OSI site:
+%   http://www.opensource.org/licenses/bsd-license.php
+
+function pfilewrite(filename,P,colstoch)
+if nargin<3 || isempty(colstoch), colstoch=1; end
+if ~iscell(P), P={P}; end
+hbytes=64;    % size of the header
+
+% the row indices are written to the file and the values to a
+% temporary file which is appended when all the blocks are done
+fid=fopen(filename,'w');
+if fid<0, error(['Cannot open ' filename]); end
+tmpname=[tempname '.dat'];
+fidv=fopen(tmpname,'w+');
+if fidv<0, fclose(fid); error('Cannot open temporary file'); end
+fwrite(fid,zeros(1,hbytes),'uint8');   % header is written last
+
+ns=[];
+jc=zeros(1,0);
+nnzP=0;
+for i=1:numel(P)
+  Pi=P{i};
+  if isa(Pi,'function_handle'), Pi=Pi(); end
+  if ~colstoch, Pi=Pi'; end
+  if ~issparse(Pi), Pi=sparse(Pi); end
+  if isempty(ns)
+    ns=size(Pi,1);
+    if ns<2^32, itype='uint32'; ibytes=4;
+    else        itype='int64';  ibytes=8;
+    end
+  elseif size(Pi,1)~=ns
+    fclose(fid); fclose(fidv); delete(tmpname);
+    error('The blocks of P are not compatible')
+  end
+  [ir,jj,pr]=find(Pi);
+  fwrite(fid,ir-1,itype);
+  fwrite(fidv,pr,'double');
+  jc=[jc nnzP+cumsum(full(sum(spones(Pi),1)))]; %#ok<AGROW>
+  nnzP=nnzP+length(pr);
+  clear Pi ir jj pr
+end
+if isempty(ns)
+  fclose(fid); fclose(fidv); delete(tmpname);
+  error('P is empty')
+end
+nx=length(jc);
+
+% append the values and the column pointers
+iroffset=hbytes;
+proffset=hbytes+nnzP*ibytes;
+frewind(fidv);
+while true
+  x=fread(fidv,2^20,'double');
+  if isempty(x), break; end
+  fwrite(fid,x,'double');
+end
+fclose(fidv);
+delete(tmpname);
+jcoffset=proffset+nnzP*8;
+fwrite(fid,[0 jc],'int64');
+
+% write the header
+frewind(fid);
+fwrite(fid,'MDPP','uint8');
+fwrite(fid,[1 ibytes 0],'int32');
+fwrite(fid,[ns nx nnzP jcoffset iroffset proffset],'int64');
+fclose(fid);
@@ -32,6 +32,10 @@
 %   In this example Xa and Xb are identical 18x3 matrices (so all(all(Xa==Xb)) is true).
 %     
 % Note: maintains lexicographic ordering.
+%
+% For grids too large to hold in memory use
+%   G=implicitgrid('rect',x1,x2,...);
+% which computes rows and columns as they are needed (see implicitgrid).
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
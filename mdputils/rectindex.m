@@ -10,6 +10,10 @@
 % Defining 
 %   SS=rectgrid(s); ind=rectindex(S,s);
 %   SS(ind,:) is equal to S
+%
+% s can also be an implicitgrid object of type 'rect'; then
+%   ind=rank(s,S)
+% is returned and the grid is not formed.
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
@@ -42,6 +46,10 @@
 %   http://www.opensource.org/licenses/bsd-license.php
 
 function ind=rectindex(S,s)
+if isa(s,'implicitgrid')
+  ind=rank(s,S);
+  return
+end
 if isnumeric(s)
   s={s};
 end
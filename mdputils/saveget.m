@@ -14,6 +14,9 @@
 % This function leaves randomly named MAT files on you hard disk. These can
 % (should) be erased after you finish you session (a way to do automatic cleanup
 % would be nice).
+%
+% To store a whole model use mdpsave and mdpload, which use an uncompressed
+% memory mapped file rather than a MAT file.
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
@@ -0,0 +1,120 @@
+% scatbas Interpolation basis matrix for scattered grid points
+% USAGE
+%   B=scatbas(S,s,k,method,power);
+% INPUTS
+%   S      : Nxd matrix of evaluation points
+%   s      : nxd matrix of grid points, a kdtree created from the grid
+%              points or a structure with fields:
+%                grid   : nxd matrix of grid points
+%                tree   : kdtree created from grid [optional]
+%                k      : number of neighbors [optional]
+%                method : interpolation method [optional]
+%                power  : distance power [optional]
+%                tri    : Delaunay triangulation of grid [optional]
+%              fields in s override the other inputs
+%   k      : number of nearest grid points used for each evaluation point
+%              (default: d+1)
+%   method : 'idw' for inverse distance weighting [default]
+%            'simplex' for barycentric weights on the Delaunay 
+%               triangulation of the grid (evaluation points outside 
+%               the convex hull of the grid use inverse distance weights)
+%   power  : power of the distance used by inverse distance weighting 
+%              (default: 2)
+% OUTPUT
+%   B      : nxN sparse matrix of basis values
+%
+% If f is an 1xn vector of function values at the n grid points then 
+% f*B is a 1xN vector of interpolated values of the function evaluated
+% at S. Values of B are non-negative and columns of B sum to 1 so B
+% can be used directly as a transition probability matrix.
+%
+% The nearest neighbor searches and weights are computed by the kdtree
+% MEX function kdtree_scatbas, which uses multiple threads when compiled 
+% with OpenMP. When the grid is used repeatedly (e.g., in g2P) pass 
+% the tree in s to avoid rebuilding it.
+%
+% If s is a matrix with a single column it is treated as a vector of 
+% grid points for a single variable.
+
+% MDPSOLVE: MATLAB tools for solving Markov Decision Problems
+% Copyright (c) 2026, Paul L. Fackler (paul_fackler@ncsu.edu)
+% All rights reserved.
+% 
+% Redistribution and use in source and binary forms, with or without  
+% modification, are permitted provided that the following conditions are met:
+% 
+%    * Redistributions of source code must retain the above copyright notice, 
+%        this list of conditions and the following disclaimer.
+%    * Redistributions in binary form must reproduce the above copyright notice, 
+%        this list of conditions and the following disclaimer in the 
+%        documentation and/or other materials provided with the distribution.
+%    * Neither the name of the North Carolina State University nor of Paul L. 
+%        Fackler may be used to endorse or promote products derived from this 
+%        software without specific prior written permission.
+% 
+% THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+% AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+% IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+% ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+% FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+% DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+% SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+% CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, 
+% OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+% OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+% 
+% For more information, see the Open Source Initiative OSI site:
+%   http://www.opensource.org/licenses/bsd-license.php
+
+function B=scatbas(S,s,k,method,power)
+if nargin<3, k=[];           end
+if nargin<4 || isempty(method), method='idw'; end
+if nargin<5 || isempty(power),  power=2;      end
+grid=[]; tree=[]; tri=[];
+if isstruct(s)
+  if isfield(s,'grid'),   grid=s.grid;     end
+  if isfield(s,'tree'),   tree=s.tree;     end
+  if isfield(s,'tri'),    tri=s.tri;       end
+  if isfield(s,'k'),      k=s.k;           end
+  if isfield(s,'method'), method=s.method; end
+  if isfield(s,'power'),  power=s.power;   end
+elseif isa(s,'kdtree')
+  tree=s;
+else
+  grid=s;
+end
+d=size(S,2);
+if isempty(k), k=d+1; end
+if isempty(tree)
+  if isempty(grid)
+    error('s must contain the grid points or a kdtree')
+  end
+  if size(grid,2)~=d
+    error('s and S are incompatible')
+  end
+  tree=kdtree(grid);
+end
+
+switch lower(method)
+  case 'idw'
+    B=kdtree_scatbas(tree,S,k,power);
+  case 'simplex'
+    if isempty(grid)
+      error('the grid points must be passed to use the simplex method')
+    end
+    if isempty(tri), tri=delaunayn(grid); end
+    [t,lambda]=tsearchn(grid,tri,S);
+    in=~isnan(t);
+    N=size(S,1);
+    ii=find(in);
+    B=sparse(tri(t(in),:),ii*ones(1,d+1),lambda(in,:),size(grid,1),N);
+    % points outside of the convex hull of the grid
+    if any(~in)
+      ii=find(~in);
+      Bout=kdtree_scatbas(tree,S(ii,:),k,power);
+      [i,j,v]=find(Bout);
+      B=B+sparse(i,ii(j),v,size(grid,1),N);
+    end
+  otherwise
+    error('method must be ''idw'' or ''simplex''')
+end
@@ -22,6 +22,10 @@
 %
 % If C=p the grid values can be returned as unsigned integers. This saves space
 % but limits the usefulness of the grid for doing arithmetic. 
+%
+% For grids too large to hold in memory use
+%   G=implicitgrid('simplex',q,p,C,getall);
+% which computes rows and columns as they are needed (see implicitgrid).
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
@@ -14,6 +14,10 @@
 %             obtain tab using the second syntax and pass it on subsequent calls.
 % OUTPUT
 %   index : mx1 vector of index values
+%
+% q can also be an implicitgrid object of type 'simplex':
+%   index=simplexindex(v,G);
+% This uses the MEX function gridrank.
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)
@@ -46,6 +50,10 @@
 %   http://www.opensource.org/licenses/bsd-license.php
 
 function index=simplexindex(v,q,p,C,tab)
+if nargin==2 && isa(q,'implicitgrid')
+  index=rank(q,v);
+  return
+end
 if nargin<3, error('3 inputs are required'); end
 p1=p+1;
 q1=q-1;
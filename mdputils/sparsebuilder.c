@@ -0,0 +1,264 @@
+#include "mex.h"
+#include <string.h>
+/*
+% sparsebuilder Builds a large sparse matrix a block of columns at a time
+% USAGE
+%   h=sparsebuilder('create',m,n,nzmax);
+%   sparsebuilder('add',h,M,startcol);
+%   P=sparsebuilder('finish',h);
+%   sparsebuilder('clear',h);   % or sparsebuilder('clear') for all builders
+% INPUTS
+%   m, n     : number of rows and columns of the matrix being built
+%   nzmax    : initial number of non-zeros to allocate  [default: n]
+%   h        : handle returned by 'create'
+%   M        : m x q matrix (sparse or full double)
+%   startcol : column of P that holds the first column of M
+% OUTPUT
+%   h        : handle of the new builder
+%   P        : m x n sparse matrix
+%
+% This replaces the pattern
+%   P=sparse([],[],[],m,n);
+%   for ...
+%     P=add2sparse(P,M,startcol,factor,true);
+%   end
+% with
+%   h=sparsebuilder('create',m,n);
+%   for ...
+%     sparsebuilder('add',h,M,startcol);
+%   end
+%   P=sparsebuilder('finish',h);
+% Blocks must be added in increasing column order; columns that are
+% skipped are empty. When the space allocated is not large enough it is
+% (at least) doubled so the total work is O(nnz(P)). The columns of a
+% full M are written in parallel (when compiled with OpenMP) with each
+% column copied to the range reserved for it. 'finish' hands the memory
+% to P without copying it and deletes the builder.
+%
+% Builders are not saved with MATLAB variables; a builder that is not
+% finished (e.g., because of an error) should be removed with 'clear';
+% the simplest way is to follow 'create' with
+%   c=onCleanup(@() sparsebuilder('clear',h));
+% Handles are never reused and clearing a builder that has been finished
+% (or already cleared) does nothing. All builders are removed when the
+% MEX file is cleared.
+%
+% Coded as a MEX file
+*/
+
+// minimum number of elements of M for multi-threading
+#define MINPARALLEL 100000
+
+typedef struct {
+  double id;        // handle (0 for an unused slot)
+  mwSize m, n;      // size of the matrix
+  mwSize nzmax;     // space allocated for pr and ir
+  mwSize ncol;      // number of columns completed
+  double *pr;
+  mwIndex *ir, *jc;
+} builder;
+
+static builder *builders=NULL;
+static mwSize nbuilders=0;
+static double lastid=0;
+
+static void freebuilder(builder *b)
+{
+  if (b->jc!=NULL){
+    mxFree(b->pr);
+    mxFree(b->ir);
+    mxFree(b->jc);
+  }
+  memset(b,0,sizeof(builder));
+}
+
+static void freeall(void)
+{
+  mwSize i;
+  for (i=0; i<nbuilders; i++) freebuilder(builders+i);
+  if (builders!=NULL) mxFree(builders);
+  builders=NULL;
+  nbuilders=0;
+}
+
+static void *persistentalloc(void *p, mwSize n, size_t size)
+{
+  p = p==NULL ? mxMalloc(n*size) : mxRealloc(p,n*size);
+  mexMakeMemoryPersistent(p);
+  return p;
+}
+
+/* the builder with handle h or NULL if there is none */
+static builder *findhandle(const mxArray *h)
+{
+  double hh;
+  mwSize i;
+  if (!mxIsDouble(h) || mxGetNumberOfElements(h)!=1)
+    mexErrMsgTxt("Invalid sparse builder handle");
+  hh=mxGetScalar(h);
+  for (i=0; i<nbuilders; i++)
+    if (builders[i].jc!=NULL && builders[i].id==hh) return builders+i;
+  return NULL;
+}
+
+static builder *gethandle(const mxArray *h)
+{
+  builder *b=findhandle(h);
+  if (b==NULL) mexErrMsgTxt("Invalid sparse builder handle");
+  return b;
+}
+
+/* makes sure there is space for nnz non-zeros */
+static void reserve(builder *b, mwSize nnz)
+{
+  mwSize newmax;
+  double maxnnz=(double)b->m*(double)b->n;
+  if (nnz<=b->nzmax) return;
+  newmax = 2*b->nzmax>nnz ? 2*b->nzmax : nnz;
+  if ((double)newmax>maxnnz) newmax=(mwSize)maxnnz;
+  if (newmax<nnz) newmax=nnz;
+  b->pr=persistentalloc(b->pr,newmax,sizeof(double));
+  b->ir=persistentalloc(b->ir,newmax,sizeof(mwIndex));
+  b->nzmax=newmax;
+}
+
+/* copies the non-zeros of full M into columns c0,... of the builder */
+static void addfull(builder *b, const double *M, mwSize q, mwSize c0)
+{
+  mwSize m=b->m;
+  mwIndex *jc=b->jc+c0, j;
+  mwSignedIndex jj;
+  // count the non-zeros in each column
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m*q>MINPARALLEL)
+#endif
+  for (jj=0; jj<(mwSignedIndex)q; jj++){
+    const double *Mj=M+jj*m;
+    mwIndex i, c=0;
+    for (i=0; i<m; i++) if (Mj[i]!=0) c++;
+    jc[jj+1]=c;
+  }
+  for (j=0; j<q; j++) jc[j+1]+=jc[j];
+  reserve(b,jc[q]);
+  // each column is written to its own reserved range
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m*q>MINPARALLEL)
+#endif
+  for (jj=0; jj<(mwSignedIndex)q; jj++){
+    const double *Mj=M+jj*m;
+    double *pr=b->pr+jc[jj];
+    mwIndex *ir=b->ir+jc[jj], i, k=0;
+    for (i=0; i<m; i++){
+      if (Mj[i]!=0){ pr[k]=Mj[i]; ir[k++]=i; }
+    }
+  }
+}
+
+/* copies sparse M into columns c0,... of the builder */
+static void addsparse(builder *b, const mxArray *M, mwSize q, mwSize c0)
+{
+  const mwIndex *jcM=mxGetJc(M);
+  mwIndex *jc=b->jc+c0, j, k0=jc[0];
+  mwSize nnz=jcM[q];
+  reserve(b,k0+nnz);
+  memcpy(b->pr+k0,mxGetPr(M),nnz*sizeof(double));
+  memcpy(b->ir+k0,mxGetIr(M),nnz*sizeof(mwIndex));
+  for (j=1; j<=q; j++) jc[j]=k0+jcM[j];
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  static int registered=0;
+  char cmd[8];
+  builder *b;
+  mwSize i, q, c0;
+  double startcol, nzmax;
+
+  if (!registered){
+    mexAtExit(freeall);
+    registered=1;
+  }
+  if (nrhs<1 || !mxIsChar(prhs[0]) || mxGetString(prhs[0],cmd,sizeof(cmd))!=0)
+    mexErrMsgTxt("The first input must be 'create', 'add', 'finish' or 'clear'");
+
+  if (strcmp(cmd,"create")==0){
+    if (nrhs<3 || nrhs>4) mexErrMsgTxt("Use h=sparsebuilder('create',m,n,nzmax)");
+    if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+    // use a free slot or add one
+    for (i=0; i<nbuilders; i++) if (builders[i].jc==NULL) break;
+    if (i==nbuilders){
+      builders=persistentalloc(builders,nbuilders+1,sizeof(builder));
+      memset(builders+nbuilders,0,sizeof(builder));
+      nbuilders++;
+    }
+    b=builders+i;
+    b->m=(mwSize)mxGetScalar(prhs[1]);
+    b->n=(mwSize)mxGetScalar(prhs[2]);
+    nzmax = nrhs>3 && !mxIsEmpty(prhs[3]) ? mxGetScalar(prhs[3]) : (double)b->n;
+    if ((double)b->m*(double)b->n<nzmax) nzmax=(double)b->m*(double)b->n;
+    if (nzmax<1) nzmax=1;
+    b->nzmax=(mwSize)nzmax;
+    b->ncol=0;
+    b->pr=persistentalloc(NULL,b->nzmax,sizeof(double));
+    b->ir=persistentalloc(NULL,b->nzmax,sizeof(mwIndex));
+    b->jc=persistentalloc(NULL,b->n+1,sizeof(mwIndex));
+    b->jc[0]=0;
+    b->id=++lastid;
+    plhs[0]=mxCreateDoubleScalar(b->id);
+  }
+  else if (strcmp(cmd,"add")==0){
+    if (nrhs!=4) mexErrMsgTxt("Use sparsebuilder('add',h,M,startcol)");
+    b=gethandle(prhs[1]);
+    if (!mxIsDouble(prhs[2]) || mxIsComplex(prhs[2]))
+      mexErrMsgTxt("M must be a real double matrix");
+    if (mxGetM(prhs[2])!=b->m)
+      mexErrMsgTxt("M must have the same number of rows as the matrix being built");
+    q=mxGetN(prhs[2]);
+    startcol=mxGetScalar(prhs[3]);
+    if (startcol<(double)b->ncol+1)
+      mexErrMsgTxt("Blocks must be added in increasing column order");
+    if (startcol-1+(double)q>(double)b->n)
+      mexErrMsgTxt("M will not fit into the matrix being built");
+    c0=(mwSize)startcol-1;
+    // skipped columns are empty
+    for (i=b->ncol; i<c0; i++) b->jc[i+1]=b->jc[i];
+    if (mxIsSparse(prhs[2])) addsparse(b,prhs[2],q,c0);
+    else                     addfull(b,mxGetPr(prhs[2]),q,c0);
+    b->ncol=c0+q;
+  }
+  else if (strcmp(cmd,"finish")==0){
+    if (nrhs!=2) mexErrMsgTxt("Use P=sparsebuilder('finish',h)");
+    if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+    b=gethandle(prhs[1]);
+    for (i=b->ncol; i<b->n; i++) b->jc[i+1]=b->jc[i];
+    // trim the memory to the number of non-zeros and give it to P
+    if (b->jc[b->n]>0 && b->jc[b->n]<b->nzmax){
+      b->nzmax=b->jc[b->n];
+      b->pr=persistentalloc(b->pr,b->nzmax,sizeof(double));
+      b->ir=persistentalloc(b->ir,b->nzmax,sizeof(mwIndex));
+    }
+    plhs[0]=mxCreateSparse(0,0,1,mxREAL);
+    mxFree(mxGetPr(plhs[0]));
+    mxFree(mxGetIr(plhs[0]));
+    mxFree(mxGetJc(plhs[0]));
+    mxSetM(plhs[0],b->m);
+    mxSetN(plhs[0],b->n);
+    mxSetPr(plhs[0],b->pr);
+    mxSetIr(plhs[0],b->ir);
+    mxSetJc(plhs[0],b->jc);
+    mxSetNzmax(plhs[0],b->nzmax);
+    memset(b,0,sizeof(builder));
+  }
+  else if (strcmp(cmd,"clear")==0){
+    if (nrhs>2) mexErrMsgTxt("Use sparsebuilder('clear',h)");
+    if (nrhs==1) freeall();
+    else{
+      b=findhandle(prhs[1]);
+      if (b!=NULL) freebuilder(b);
+    }
+  }
+  else
+    mexErrMsgTxt("The first input must be 'create', 'add', 'finish' or 'clear'");
+}
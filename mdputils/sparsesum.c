@@ -0,0 +1,169 @@
+#include "mex.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+/*
+% sparsesum Sum of a set of sparse matrices
+% USAGE
+%   S=sparsesum(A);
+% INPUTS
+%   A : cell array of m x n sparse double matrices
+% OUTPUT
+%   S : m x n sparse matrix equal to A{1}+A{2}+...+A{end}
+%
+% Adding the matrices one at a time (S=S+A{k}) creates a new matrix for
+% each addition so the work grows with the square of the number of
+% matrices. Here each column of S is formed once from the corresponding
+% columns of all of the A{k} and no intermediate sums are created.
+% Columns are processed in parallel when compiled with OpenMP (each
+% thread has its own work arrays of length m). Elements that sum to 0
+% are not stored.
+%
+% Coded as a MEX file
+*/
+
+// minimum number of non-zeros for multi-threading
+#define MINPARALLEL 100000
+
+static int comprow(const void *a, const void *b)
+{
+  mwIndex ia=*(const mwIndex *)a, ib=*(const mwIndex *)b;
+  return ia<ib ? -1 : (ia>ib ? 1 : 0);
+}
+
+/* sums column j of all the matrices (Ir, Jc and Pr hold the pointers of
+   each A{k}); returns the number of non-zero sums.
+   If ir is not NULL the rows (in order) and values are stored */
+static mwSize sumcol(mwIndex j, const mwIndex **Ir, const mwIndex **Jc,
+                     const double **Pr, mwSize na, mwSize m,
+                     double *acc, mwIndex *mark, mwIndex *list,
+                     mwIndex *ir, double *pr)
+{
+  mwSize k, nl=0, nnz=0;
+  mwIndex e, r, i;
+  for (k=0; k<na; k++){
+    const mwIndex *irk=Ir[k], *jck=Jc[k];
+    const double *prk=Pr[k];
+    for (e=jck[j]; e<jck[j+1]; e++){
+      r=irk[e];
+      if (mark[r]!=j+1){ mark[r]=j+1; acc[r]=0; list[nl++]=r; }
+      acc[r]+=prk[e];
+    }
+  }
+  if (ir==NULL){
+    for (i=0; i<nl; i++) if (acc[list[i]]!=0) nnz++;
+    return nnz;
+  }
+  // put the rows in order; scan the marks when the column is dense
+  if (nl>m/16){
+    for (r=0, nl=0; r<m; r++) if (mark[r]==j+1) list[nl++]=r;
+  }
+  else if (nl>16) qsort(list,nl,sizeof(mwIndex),comprow);
+  else{
+    mwIndex t, q;
+    for (i=1; i<nl; i++){
+      t=list[i];
+      for (q=i; q>0 && list[q-1]>t; q--) list[q]=list[q-1];
+      list[q]=t;
+    }
+  }
+  for (i=0; i<nl; i++){
+    r=list[i];
+    if (acc[r]!=0){ ir[nnz]=r; pr[nnz++]=acc[r]; }
+  }
+  return nnz;
+}
+
+void mexFunction(
+   int nlhs, mxArray *plhs[],
+   int nrhs, const mxArray *prhs[])
+{
+  const mxArray *A, *Ak;
+  mwSize na, m, n, k, j, nnz;
+  mwIndex *jc, *mark, *ir;
+  double *acc, *pr;
+  mwIndex *list;
+  const mwIndex **Ir, **Jc;
+  const double **Pr;
+  int nthreads=1;
+
+  if (nrhs<1) mexErrMsgTxt("Not enough input arguments.");
+  if (nrhs>1) mexErrMsgTxt("Too many input arguments.");
+  if (nlhs>1) mexErrMsgTxt("Too many output arguments.");
+  A=prhs[0];
+  if (!mxIsCell(A)) mexErrMsgTxt("A must be a cell array");
+  na=mxGetNumberOfElements(A);
+  if (na==0) mexErrMsgTxt("A must contain at least one matrix");
+  // the pointers of each A{k} are collected so the threads do not call the API
+  Ir=mxMalloc(na*sizeof(mwIndex *));
+  Jc=mxMalloc(na*sizeof(mwIndex *));
+  Pr=mxMalloc(na*sizeof(double *));
+  m=0; n=0; nnz=0;
+  for (k=0; k<na; k++){
+    Ak=mxGetCell(A,k);
+    if (Ak==NULL || !mxIsDouble(Ak) || !mxIsSparse(Ak) || mxIsComplex(Ak))
+      mexErrMsgTxt("The elements of A must be real sparse double matrices");
+    if (k==0){ m=mxGetM(Ak); n=mxGetN(Ak); }
+    if (mxGetM(Ak)!=m || mxGetN(Ak)!=n)
+      mexErrMsgTxt("The elements of A must be the same size");
+    Ir[k]=mxGetIr(Ak);
+    Jc[k]=mxGetJc(Ak);
+    Pr[k]=mxGetPr(Ak);
+    nnz+=Jc[k][n];
+  }
+
+#ifdef _OPENMP
+  if (nnz>MINPARALLEL) nthreads=omp_get_max_threads();
+#endif
+  acc=mxMalloc(nthreads*(m>0 ? m : 1)*sizeof(double));
+  mark=mxCalloc(2*nthreads*(m>0 ? m : 1),sizeof(mwIndex));
+  list=mark+nthreads*m;
+  jc=mxMalloc((n+1)*sizeof(mwIndex));
+
+  // count the non-zeros in each column
+  jc[0]=0;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+  {
+    int t=0;
+    mwSignedIndex jj;
+#ifdef _OPENMP
+    t=omp_get_thread_num();
+#pragma omp for schedule(static)
+#endif
+    for (jj=0; jj<(mwSignedIndex)n; jj++)
+      jc[jj+1]=sumcol(jj,Ir,Jc,Pr,na,m,acc+t*m,mark+t*m,list+t*m,NULL,NULL);
+  }
+  for (j=0; j<n; j++) jc[j+1]+=jc[j];
+
+  plhs[0]=mxCreateSparse(m,n,jc[n]>0 ? jc[n] : 1,mxREAL);
+  memcpy(mxGetJc(plhs[0]),jc,(n+1)*sizeof(mwIndex));
+  // the marks from the first pass are set to j+1 so they must be reset
+  memset(mark,0,nthreads*m*sizeof(mwIndex));
+  ir=mxGetIr(plhs[0]);
+  pr=mxGetPr(plhs[0]);
+
+  // fill each column in the space reserved for it
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+  {
+    int t=0;
+    mwSignedIndex jj;
+#ifdef _OPENMP
+    t=omp_get_thread_num();
+#pragma omp for schedule(static)
+#endif
+    for (jj=0; jj<(mwSignedIndex)n; jj++)
+      sumcol(jj,Ir,Jc,Pr,na,m,acc+t*m,mark+t*m,list+t*m,ir+jc[jj],pr+jc[jj]);
+  }
+  mxFree(jc);
+  mxFree(mark);
+  mxFree(acc);
+  mxFree(Pr);
+  mxFree(Jc);
+  mxFree(Ir);
+}
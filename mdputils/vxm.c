@@ -1,92 +1,147 @@
 #include "mex.h"
 #include <math.h>
+#include <string.h>
 /*
-% devecxmat Computes diag(a)*B
+% vxm Computes diag(a)*B (vector times matrix)
 % USAGE
-%   C=diagmult(a,B);
+%   C=vxm(a,B,overwrite);
 % INPUTS
-%   a : full m-vector (or scalar)
-%   B : mxn matrix (full or sparse)
+%   a         : full m-vector (or scalar)
+%   B         : mxn matrix (full or sparse)
+%   overwrite : 1 to compute the result in the memory used by B
+%                 [default: 0]
 % OUTPUT
-%   C   : mxn matrix 
+%   C   : mxn matrix
 %
-% Note: not implemented for complex matrices or matrices 
+% Note: not implemented for complex matrices or matrices
 % with data type other than double. a must be full but
 % B can be sparse or full.
+%
+% The overwrite option is only honored if the MEX file is compiled
+% with MDP_INPLACE defined and B is not shared with another MATLAB
+% variable; otherwise a new array is created. Use it in the form
+% B=vxm(a,B,1).
+%
+% Columns (non-zeros for sparse B) are processed in parallel when
+% compiled with OpenMP.
 
 % Copyright (c) 2010, Paul L. Fackler, NCSU
 % paul_fackler@ncsu.edu
 */
 
+#ifdef MDP_INPLACE
+// undocumented MATLAB API function
+extern bool mxIsSharedArray(const mxArray *pa);
+#define canoverwrite(A) (!mxIsSharedArray(A))
+#else
+#define canoverwrite(A) false
+#endif
+
+// minimum number of elements for multi-threading
+#define MINPARALLEL 100000
 
-/* diag(a) times B - full B */
-void daxbf(double *a, double *B, mwSize m, mwSize n)
+/* C = diag(a) times B - full B (C can be B) */
+void daxbf(const double *a, const double *B, double *C, mwSize m, mwSize n)
 {
-  double *aptr, *aend, *Bend;
-  aend=a+m;
-  Bend=B+m*n;
-  while (B<Bend){
-    aptr=a;
-    while (aptr<aend) *B++ *= *aptr++;
+  mwSignedIndex j;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(m*n>MINPARALLEL)
+#endif
+  for (j=0; j<(mwSignedIndex)n; j++){
+    const double *Bj=B+j*m;
+    double *Cj=C+j*m;
+    mwIndex i;
+    for (i=0; i<m; i++) Cj[i] = a[i]*Bj[i];
   }
 }
 
-/* diag(a) times B - sparse B */
-void daxbs(double *a, double *B, mwIndex *Bi, mwSize nnz)
+/* C = diag(a) times B - sparse B (C can be B) */
+void daxbs(const double *a, const double *B, const mwIndex *Bi, double *C,
+           mwSize nnz)
 {
-  double *Bend;
-  Bend=B+nnz;
-  while (B<Bend) *B++ *= a[*Bi++];
+  mwSignedIndex k;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(nnz>MINPARALLEL)
+#endif
+  for (k=0; k<(mwSignedIndex)nnz; k++) C[k] = a[Bi[k]]*B[k];
 }
 
+/* C = a times B - scalar a (C can be B) */
+void axbs(double a, const double *B, double *C, mwSize nnz)
+{
+  mwSignedIndex i;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(nnz>MINPARALLEL)
+#endif
+  for (i=0; i<(mwSignedIndex)nnz; i++) C[i] = a*B[i];
+}
 
+/* creates an output array with the same structure as B
+   (the values are not copied) or returns B itself if it can be
+   overwritten */
+mxArray *getoutput(const mxArray *B, bool overwrite)
+{
+  mxArray *C;
+  mwSize m, n, nnz;
+  if (overwrite && canoverwrite(B)) return((mxArray *)B);
+  m=mxGetM(B);
+  n=mxGetN(B);
+  if (mxIsSparse(B)){
+    nnz=mxGetJc(B)[n];
+    C=mxCreateSparse(m,n,nnz>0 ? nnz : 1,mxREAL);
+    memcpy(mxGetIr(C),mxGetIr(B),nnz*sizeof(mwIndex));
+    memcpy(mxGetJc(C),mxGetJc(B),(n+1)*sizeof(mwIndex));
+  }
+  else
+    C=mxCreateNumericArray(mxGetNumberOfDimensions(B),mxGetDimensions(B),
+                           mxDOUBLE_CLASS,mxREAL);
+  return(C);
+}
 
 
 void mexFunction(
     int nlhs, mxArray *plhs[],
     int nrhs, const mxArray *prhs[])
-{  double *A, *B, *Bend, a;
+{  double *A, *B, *C, a;
    mwSize m, n, na;
+   bool overwrite;
 
-   if (nrhs!=2)
+   if (nrhs<2)
       mexErrMsgTxt("Two parameters must be passed");
+   if (nrhs>3)
+      mexErrMsgTxt("At most three parameters can be passed");
    if (nlhs>1)
       mexErrMsgTxt("Only one output is created");
    if (!mxIsDouble(prhs[0]) ||  mxIsSparse(prhs[0]))
-      mexErrMsgTxt("First input must be a full vector"); 
-   if (!mxIsDouble(prhs[1]) &&  !mxIsSparse(prhs[1]))
-      mexErrMsgTxt("Second input must be numeric");
+      mexErrMsgTxt("First input must be a full vector");
+   if (!mxIsDouble(prhs[1]))
+      mexErrMsgTxt("Second input must be double");
    if (mxIsComplex(prhs[0]) || mxIsComplex(prhs[1]))
       mexErrMsgTxt("Inputs must be real");
 
-   m=mxGetM(prhs[1]); 
+   overwrite=false;
+   if (nrhs>2 && mxGetScalar(prhs[2])!=0)  overwrite=true;
+
+   m=mxGetM(prhs[1]);
    n=mxGetN(prhs[1]);
    na=mxGetNumberOfElements(prhs[0]);
+   B=mxGetPr(prhs[1]);
    if (na==1){  /* a is scalar */
        a=*mxGetPr(prhs[0]);
-       plhs[0]=mxDuplicateArray(prhs[1]);
-       B=mxGetPr(plhs[0]);
-       if (mxIsSparse(plhs[0])){
-         mwIndex *Bj;
-         Bj=mxGetJc(plhs[0]);
-         m=Bj[n];  /* number of non-zero elements */
-       }
-       else m *= n;
-       Bend=B+m;
-       while (B<Bend) *B++ *= a;   
+       plhs[0]=getoutput(prhs[1],overwrite);
+       C=mxGetPr(plhs[0]);
+       if (mxIsSparse(prhs[1])) m=mxGetJc(prhs[1])[n];
+       else                     m=mxGetNumberOfElements(prhs[1]);
+       axbs(a,B,C,m);
    }
    else if (na==m){ /* a has the right number of elements */
      A=mxGetPr(prhs[0]);
-     plhs[0]=mxDuplicateArray(prhs[1]);
-     B=mxGetPr(plhs[0]);
-     if (mxIsSparse(plhs[0])){ 
-       mwIndex *Bi, *Bj;
-       Bi=mxGetIr(plhs[0]);
-       Bj=mxGetJc(plhs[0]);
-       daxbs(A,B,Bi,Bj[n]);
-     }
+     plhs[0]=getoutput(prhs[1],overwrite);
+     C=mxGetPr(plhs[0]);
+     if (mxIsSparse(prhs[1]))
+       daxbs(A,B,mxGetIr(prhs[1]),C,mxGetJc(prhs[1])[n]);
      else
-       daxbf(A,B,m,n);
+       daxbf(A,B,C,m,n);
    }
    else
       mexErrMsgTxt("Inputs are not conformable");
@@ -4,8 +4,14 @@
 % INPUTS
 %   v : m-vector   (full double)
 %   M : mxn matrix (full or sparse double)
+%   overwrite : 1 to reuse the memory of M for the result [default: 0]
+%                 use in the form M=vxm(v,M,1)
 % OUTPUT
 %   B : mxn matrix
+%
+% The MEX version only overwrites M if it is compiled with MDP_INPLACE
+% defined and M is not shared with another variable. It runs 
+% multi-threaded when compiled with OpenMP.
 
 % MDPSOLVE: MATLAB tools for solving Markov Decision Problems
 % Copyright (c) 2011, Paul L. Fackler (paul_fackler@ncsu.edu)